@@ -20,6 +20,7 @@
 #include "main.h"
 
 #include "action.h"
+#include "action_spill.h"
 #include "settings.h"
 #include "map.h"
 #include "editor.h"
@@ -58,6 +59,22 @@ Change* Change::Create(Waypoint* wp, const Position& where)
 	return c;
 }
 
+Change* Change::Create(const TileSelection& selection)
+{
+	Change* c = newd Change();
+	c->type = CHANGE_SELECTION;
+	c->data = newd TileSelection(selection);
+	return c;
+}
+
+Change* Change::Create(TileMove* move)
+{
+	Change* c = newd Change();
+	c->type = CHANGE_MOVE;
+	c->data = move;
+	return c;
+}
+
 Change::~Change()
 {
 	clear();
@@ -79,6 +96,14 @@ void Change::clear()
 			ASSERT(data);
 			delete reinterpret_cast<std::pair<std::string, Position>* >(data);
 			break;
+		case CHANGE_SELECTION:
+			ASSERT(data);
+			delete reinterpret_cast<TileSelection*>(data);
+			break;
+		case CHANGE_MOVE:
+			ASSERT(data);
+			delete reinterpret_cast<TileMove*>(data);
+			break;
 		case CHANGE_NONE:
 			break;
 		default:
@@ -100,12 +125,144 @@ uint32_t Change::memsize() const
 			ASSERT(data);
 			mem += reinterpret_cast<Tile*>(data)->memsize();
 			break;
+		case CHANGE_SELECTION:
+			ASSERT(data);
+			mem += sizeof(TileSelection) + reinterpret_cast<TileSelection*>(data)->items.size() / 8;
+			break;
+		case CHANGE_MOVE:
+		{
+			ASSERT(data);
+			TileMove* move = reinterpret_cast<TileMove*>(data);
+			mem += sizeof(TileMove) + move->positions.size() * sizeof(Position);
+			for(Tile* tile : move->displaced)
+				mem += tile->memsize();
+			break;
+		}
 		default:
 			break;
 	}
 	return mem;
 }
 
+TileMove::~TileMove()
+{
+	for(Tile* tile : displaced)
+		delete tile;
+}
+
+TileSelection::TileSelection(const Tile* tile) :
+	position(tile->getPosition()),
+	flags(0),
+	items(tile->items.size())
+{
+	if(tile->ground && tile->ground->isSelected())
+		flags |= GROUND;
+	if(tile->spawn && tile->spawn->isSelected())
+		flags |= SPAWN;
+	if(tile->creature && tile->creature->isSelected())
+		flags |= CREATURE;
+
+	for(size_t i = 0; i < tile->items.size(); ++i)
+		items[i] = tile->items[i]->isSelected();
+}
+
+void TileSelection::setAll(const Tile* tile, bool selected)
+{
+	// Tile::select leaves empty tiles alone
+	if(selected && tile->size() == 0)
+		return;
+
+	flags = 0;
+	if(selected)
+	{
+		if(tile->ground)
+			flags |= GROUND;
+		if(tile->spawn)
+			flags |= SPAWN;
+		if(tile->creature)
+			flags |= CREATURE;
+	}
+	items.assign(items.size(), selected);
+}
+
+void TileSelection::setItem(const Tile* tile, const Item* item, bool selected)
+{
+	if(item == tile->ground)
+	{
+		if(selected)
+			flags |= GROUND;
+		else
+			flags &= ~GROUND;
+		return;
+	}
+
+	for(size_t i = 0; i < tile->items.size(); ++i)
+	{
+		if(tile->items[i] == item)
+		{
+			items[i] = selected;
+			return;
+		}
+	}
+}
+
+void TileSelection::setGround(const Tile* tile, bool selected)
+{
+	if(tile->ground)
+	{
+		if(selected)
+			flags |= GROUND;
+		else
+			flags &= ~GROUND;
+	}
+
+	for(size_t i = 0; i < tile->items.size() && tile->items[i]->isBorder(); ++i)
+		items[i] = selected;
+}
+
+bool TileSelection::fits(const Tile* tile) const
+{
+	return tile->getPosition() == position && tile->items.size() == items.size();
+}
+
+void TileSelection::apply(Tile* tile) const
+{
+	ASSERT(fits(tile));
+
+	if(tile->ground)
+	{
+		if(testFlags(flags, GROUND))
+			tile->ground->select();
+		else
+			tile->ground->deselect();
+	}
+	if(tile->spawn)
+	{
+		if(testFlags(flags, SPAWN))
+			tile->spawn->select();
+		else
+			tile->spawn->deselect();
+	}
+	if(tile->creature)
+	{
+		if(testFlags(flags, CREATURE))
+			tile->creature->select();
+		else
+			tile->creature->deselect();
+	}
+
+	for(size_t i = 0; i < items.size(); ++i)
+	{
+		if(items[i])
+			tile->items[i]->select();
+		else
+			tile->items[i]->deselect();
+	}
+
+	// Recomputes TILESTATE_SELECTED from the items
+	tile->update();
+}
+
 Action::Action(Editor& editor, ActionIdentifier ident) :
 	commited(false),
 	editor(editor),
@@ -144,6 +301,11 @@ size_t Action::memsize() const
 				ASSERT(c->data);
 				mem += reinterpret_cast<Tile*>(c->data)->memsize();
 			} break;
+			case CHANGE_SELECTION:
+			case CHANGE_MOVE:
+			{
+				mem += c->memsize();
+			} break;
 			default:
 				break;
 		}
@@ -188,6 +350,8 @@ void Action::commit(DirtyList* dirty_list)
 
 
 				newtile->update();
+				editor.statistics.removeTile(oldtile);
+				editor.statistics.addTile(newtile);
 
 				//std::cout << "\tSwitched tile at " << pos.x << ";" << pos.y << ";" << pos.z << " from " << (void*)oldtile << " to " << *data <<  std::endl;
 				if(newtile->isSelected())
@@ -206,6 +370,13 @@ void Action::commit(DirtyList* dirty_list)
 						if(house)
 							house->addTile(newtile);
 					}
+					else if(newtile->getHouseID() != 0)
+					{
+						// Same house, but its walls or doors may have changed
+						House* house = editor.map.houses.getHouse(newtile->getHouseID());
+						if(house)
+							house->updateTile(newtile);
+					}
 					if(oldtile->spawn)
 					{
 						if(newtile->spawn)
@@ -297,6 +468,31 @@ void Action::commit(DirtyList* dirty_list)
 					p->second = oldpos;
 				}
 			} break;
+			case CHANGE_SELECTION:
+			{
+				TileSelection* state = reinterpret_cast<TileSelection*>(c->data);
+				ASSERT(state);
+
+				Tile* tile = editor.map.getTile(state->position);
+				if(!tile || !state->fits(tile))
+					break;
+
+				// Swap the states, so the change undoes itself the next time
+				TileSelection previous(tile);
+				const bool was_selected = tile->isSelected();
+				state->apply(tile);
+				*state = previous;
+
+				if(tile->isSelected() && !was_selected)
+					editor.selection.addInternal(tile);
+				else if(!tile->isSelected() && was_selected)
+					editor.selection.removeInternal(tile);
+			} break;
+			case CHANGE_MOVE:
+			{
+				ASSERT(c->data);
+				applyMove(reinterpret_cast<TileMove*>(c->data), dirty_list);
+			} break;
 			default:
 				break;
 		}
@@ -339,6 +535,8 @@ void Action::undo(DirtyList* dirty_list)
 				}
 
 				Tile* newtile = editor.map.swapTile(pos, oldtile);
+				editor.statistics.removeTile(newtile);
+				editor.statistics.addTile(oldtile);
 
 				// Update server side change list (for broadcast)
 				if(editor.IsLiveServer() && dirty_list)
@@ -370,6 +568,12 @@ void Action::undo(DirtyList* dirty_list)
 						house->addTile(oldtile);
 					}
 				}
+				else if(oldtile->getHouseID() != 0)
+				{
+					House* house = editor.map.houses.getHouse(oldtile->getHouseID());
+					if(house)
+						house->updateTile(oldtile);
+				}
 				if(oldtile->spawn)
 				{
 					if(newtile->spawn)
@@ -436,6 +640,31 @@ void Action::undo(DirtyList* dirty_list)
 					p->second = oldpos;
 				}
 			} break;
+			case CHANGE_SELECTION:
+			{
+				TileSelection* state = reinterpret_cast<TileSelection*>(c->data);
+				ASSERT(state);
+
+				Tile* tile = editor.map.getTile(state->position);
+				if(!tile || !state->fits(tile))
+					break;
+
+				// Swap the states, so the change undoes itself the next time
+				TileSelection previous(tile);
+				const bool was_selected = tile->isSelected();
+				state->apply(tile);
+				*state = previous;
+
+				if(tile->isSelected() && !was_selected)
+					editor.selection.addInternal(tile);
+				else if(!tile->isSelected() && was_selected)
+					editor.selection.removeInternal(tile);
+			} break;
+			case CHANGE_MOVE:
+			{
+				ASSERT(c->data);
+				applyMove(reinterpret_cast<TileMove*>(c->data), dirty_list);
+			} break;
 			default:
 			break;
 		}
@@ -445,11 +674,122 @@ void Action::undo(DirtyList* dirty_list)
 	commited = false;
 }
 
+// Takes a tile out of its house, but leaves it the house id, removeTile
+// clears it and the tile has to be added back where it lands
+static void DetachHouseTile(Map& map, Tile* tile)
+{
+	if(House* house = map.houses.getHouse(tile->getHouseID()))
+	{
+		house->removeTile(tile);
+		tile->setHouse(house);
+	}
+}
+
+static void AttachHouseTile(Map& map, Tile* tile)
+{
+	if(House* house = map.houses.getHouse(tile->getHouseID()))
+	{
+		house->addTile(tile);
+		ASSERT(house->hasTile(tile->getPosition()) && tile->getHouseID() == house->id);
+	}
+}
+
+void Action::applyMove(TileMove* move, DirtyList* dirty_list)
+{
+	Map& map = editor.map;
+
+	// Everything is taken off the map first, so tiles that move onto each
+	// other's places don't collide
+	std::vector<Tile*> moving(move->positions.size(), nullptr);
+	for(size_t i = 0; i < move->positions.size(); ++i)
+	{
+		const Position& pos = move->positions[i];
+		Tile* tile = map.getTile(pos);
+		if(!tile)
+			continue;
+
+		if(tile->isSelected())
+			editor.selection.removeInternal(tile);
+		DetachHouseTile(map, tile);
+		map.removeSpawn(tile);
+
+		map.swapTile(pos, nullptr);
+		moving[i] = tile;
+
+		if(editor.IsLiveServer() && dirty_list)
+			dirty_list->AddPosition(pos.x, pos.y, pos.z);
+	}
+
+	std::vector<Tile*> displaced;
+	for(size_t i = 0; i < moving.size(); ++i)
+	{
+		Tile* tile = moving[i];
+		if(!tile)
+			continue;
+
+		const Position pos = move->positions[i] + move->offset;
+		tile->setLocation(map.createTileL(pos));
+
+		if(Tile* old = map.swapTile(pos, tile))
+		{
+			if(old->isSelected())
+				editor.selection.removeInternal(old);
+			DetachHouseTile(map, old);
+			map.removeSpawn(old);
+			editor.statistics.removeTile(old);
+			displaced.push_back(old);
+		}
+
+		AttachHouseTile(map, tile);
+		map.addSpawn(tile);
+		if(tile->isSelected())
+			editor.selection.addInternal(tile);
+		tile->modify();
+
+		move->positions[i] = pos;
+		if(editor.IsLiveServer() && dirty_list)
+			dirty_list->AddPosition(pos.x, pos.y, pos.z);
+	}
+
+	// What the previous application replaced goes back to its place
+	for(Tile* tile : move->displaced)
+	{
+		const Position pos = tile->getPosition();
+		if(Tile* old = map.swapTile(pos, tile))
+		{
+			// Only if the map changed under the move
+			if(old->isSelected())
+				editor.selection.removeInternal(old);
+			DetachHouseTile(map, old);
+			map.removeSpawn(old);
+			editor.statistics.removeTile(old);
+			displaced.push_back(old);
+		}
+
+		AttachHouseTile(map, tile);
+		map.addSpawn(tile);
+		editor.statistics.addTile(tile);
+		if(tile->isSelected())
+			editor.selection.addInternal(tile);
+
+		if(editor.IsLiveServer() && dirty_list)
+			dirty_list->AddPosition(pos.x, pos.y, pos.z);
+	}
+
+	// Turn it into its own reverse
+	move->displaced.swap(displaced);
+	move->offset = Position(0, 0, 0) - move->offset;
+}
+
 BatchAction::BatchAction(Editor& editor, ActionIdentifier ident) :
 	editor(editor),
     timestamp(0),
     memory_size(0),
-    type(ident)
+    type(ident),
+    spilled(false),
+    spill_offset(0),
+    spill_size(0),
+    spill_raw_size(0)
 {
     // ...
 }
@@ -557,7 +897,7 @@ void BatchAction::merge(BatchAction* other)
 }
 
 ActionQueue::ActionQueue(Editor& editor) :
-	current(0), memory_size(0), editor(editor)
+	current(0), memory_size(0), editor(editor), spill(newd ActionSpill())
 {
 	//
 }
@@ -567,6 +907,7 @@ ActionQueue::~ActionQueue()
 	for (auto it = actions.begin(); it != actions.end(); it = actions.erase(it)) {
 		delete *it;
 	}
+	delete spill;
 }
 
 Action* ActionQueue::createAction(ActionIdentifier ident)
@@ -618,10 +959,14 @@ void ActionQueue::addBatch(BatchAction* batch, int stacking_delay)
 		memory_size -= actions.back()->memsize();
 		BatchAction* todelete = actions.back();
 		actions.pop_back();
+		spill->release(todelete);
 		delete todelete;
 	}
 
-	while(memory_size > size_t(1024 * 1024 * settings.getInteger(Config::UNDO_MEM_SIZE)) && actions.empty() == false)
+	spillHistory();
+
+	// Only reached when spilling isn't possible, spilled batches are kept
+	while(memory_size > size_t(1024 * 1024 * settings.getInteger(Config::UNDO_MEM_SIZE)) && actions.empty() == false && !actions.front()->isSpilled())
 	{
 		memory_size -= actions.front()->memsize();
 		delete actions.front();
@@ -634,6 +979,7 @@ void ActionQueue::addBatch(BatchAction* batch, int stacking_delay)
 		memory_size -= actions.front()->memsize();
 		BatchAction* todelete = actions.front();
 		actions.pop_front();
+		spill->release(todelete);
 		delete todelete;
 		current--;
 	}
@@ -642,7 +988,7 @@ void ActionQueue::addBatch(BatchAction* batch, int stacking_delay)
 		if(actions.empty() == false)
 		{
 			BatchAction* lastAction = actions.back();
-			if(lastAction->type == batch->type && settings.getInteger(Config::GROUP_ACTIONS) && time(nullptr) - stacking_delay < lastAction->timestamp)
+			if(lastAction->type == batch->type && !lastAction->isSpilled() && settings.getInteger(Config::GROUP_ACTIONS) && time(nullptr) - stacking_delay < lastAction->timestamp)
 			{
 				lastAction->merge(batch);
 				lastAction->timestamp = time(nullptr);
@@ -676,8 +1022,11 @@ void ActionQueue::undo()
 {
 	if(current > 0)
 	{
+		BatchAction* batch = actions[current - 1];
+		if(!restore(batch))
+			return;
+
 		current--;
-		BatchAction* batch = actions[current];
 		batch->undo();
 	}
 }
@@ -687,6 +1036,9 @@ void ActionQueue::redo()
 	if(current < actions.size())
 	{
 		BatchAction* batch = actions[current];
+		if(!restore(batch))
+			return;
+
 		batch->redo();
 		current++;
 	}
@@ -701,6 +1053,48 @@ void ActionQueue::clear()
 		it = actions.erase(it);
 	}
 	current = 0;
+	memory_size = 0;
+	spill->clear();
+
+	// Whatever clears the history edits the map in place, behind the actions' back
+	editor.statistics.invalidate();
+}
+
+void ActionQueue::spillHistory()
+{
+	const size_t limit = size_t(1024 * 1024 * settings.getInteger(Config::UNDO_MEM_SIZE));
+
+	// The newest batch stays, new actions may still be merged into it
+	for(size_t i = 0; memory_size > limit && i + 1 < actions.size(); ++i)
+	{
+		BatchAction* batch = actions[i];
+		if(batch->isSpilled())
+			continue;
+
+		const size_t size = batch->memsize();
+		if(!spill->spill(batch))
+			break;
+
+		memory_size -= size;
+		memory_size += batch->memsize(true);
+	}
+}
+
+bool ActionQueue::restore(BatchAction* batch)
+{
+	if(!batch->isSpilled())
+		return true;
+
+	const size_t size = batch->memsize();
+	if(!spill->restore(*this, batch))
+	{
+		gui.SetStatusText(wxT("The undo history could not be read back from disk."));
+		return false;
+	}
+
+	memory_size -= size;
+	memory_size += batch->memsize(true);
+	return true;
 }
 
 
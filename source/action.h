@@ -26,18 +26,69 @@
 
 class Editor;
 class Tile;
+class Item;
 class House;
 class Waypoint;
 class Change;
 class Action;
 class BatchAction;
 class ActionQueue;
+class ActionSpill;
 
 enum ChangeType {
 	CHANGE_NONE,
 	CHANGE_TILE,
 	CHANGE_MOVE_HOUSE_EXIT,
 	CHANGE_MOVE_WAYPOINT,
+	CHANGE_SELECTION,
+	CHANGE_MOVE,
+};
+
+// Which parts of a tile are selected. Selecting only flips flags, so
+// selection changes store this instead of a complete copy of the tile.
+class TileSelection {
+public:
+	TileSelection() : flags(0) {}
+	explicit TileSelection(const Tile* tile);
+
+	enum {
+		GROUND = 1,
+		SPAWN = 2,
+		CREATURE = 4,
+	};
+
+	void setAll(const Tile* tile, bool selected);
+	void setItem(const Tile* tile, const Item* item, bool selected);
+	// Ground and the borders on top of it, like Tile::selectGround
+	void setGround(const Tile* tile, bool selected);
+
+	// False if the tile has other items than when the state was taken
+	bool fits(const Tile* tile) const;
+	void apply(Tile* tile) const;
+
+	bool operator==(const TileSelection& other) const {
+		return position == other.position && flags == other.flags && items == other.items;
+	}
+	bool operator!=(const TileSelection& other) const {return !(*this == other);}
+
+	Position position;
+	uint8_t flags;
+	std::vector<bool> items;
+};
+
+// Whole tiles moved by an offset. The tiles themselves are relinked to
+// their new locations, only what they replaced has to be kept. Applying
+// it turns it into its own reverse.
+class TileMove {
+public:
+	TileMove() {}
+	~TileMove();
+
+	Position offset;
+	// Where the moved tiles are now
+	PositionVector positions;
+	// The tiles the move replaced, they go back when it is reversed
+	std::vector<Tile*> displaced;
 };
 
 class Change {
@@ -50,6 +101,9 @@ public:
 	Change(Tile* tile);
 	static Change* Create(House* house, const Position& where);
 	static Change* Create(Waypoint* wp, const Position& where);
+	static Change* Create(const TileSelection& selection);
+	// Takes ownership of the move
+	static Change* Create(TileMove* move);
 	~Change();
 	void clear();
 	
@@ -60,6 +114,7 @@ public:
 	uint32_t memsize() const;
 
 	friend class Action;
+	friend class ActionSpill;
 };
 
 typedef std::vector<Change*> ChangeList;
@@ -113,6 +168,8 @@ enum ActionIdentifier {
 	ACTION_SWITCHDOOR,
 	ACTION_ROTATE_ITEM,
 	ACTION_CHANGE_PROPERTIES,
+	ACTION_APPLY_PATCH,
+	ACTION_REPLACE_ITEMS,
 };
 
 class Action {
@@ -134,16 +191,18 @@ public:
 	void undo(DirtyList* dirty_list);
 	void redo(DirtyList* dirty_list) {commit(dirty_list);}
 
-
 protected:
 	Action(Editor& editor, ActionIdentifier ident);
 
+	void applyMove(TileMove* move, DirtyList* dirty_list);
+
 	bool commited;
 	ChangeList changes;
 	Editor& editor;
 	ActionIdentifier type;
 
 	friend class ActionQueue;
+	friend class ActionSpill;
 };
 
 typedef std::vector<Action*> ActionVector;
@@ -158,6 +217,8 @@ public:
 	size_t memsize(bool resize = false) const;
 	size_t size() const {return batch.size();}
 	ActionIdentifier getType() const {return type;}
+	// The actions are on disk, see ActionSpill
+	bool isSpilled() const {return spilled;}
 
 	virtual void addAction(Action* action);
 	virtual void addAndCommitAction(Action* action);
@@ -178,7 +239,13 @@ protected:
 	ActionIdentifier type;
 	ActionVector batch;
 
+	bool spilled;
+	uint64_t spill_offset;
+	uint32_t spill_size;
+	uint32_t spill_raw_size;
+
 	friend class ActionQueue;
+	friend class ActionSpill;
 };
 
 class ActionQueue {
@@ -205,10 +272,15 @@ public:
 	bool canRedo() {return current < actions.size();}
 	
 protected:
+	// Moves the oldest batches to disk until the history fits UNDO_MEM_SIZE
+	void spillHistory();
+	bool restore(BatchAction* batch);
+
 	size_t current;
 	size_t memory_size;
 	Editor& editor;
 	ActionList actions;
+	ActionSpill* spill;
 };
 
 #endif
@@ -0,0 +1,454 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "action_spill.h"
+#include "action.h"
+#include "live_socket.h"
+#include "tile_record.h"
+#include "editor.h"
+#include "map.h"
+
+#include <wx/filename.h>
+
+template <typename T>
+static void spillWrite(std::vector<uint8_t>& out, T value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void spillWriteString(std::vector<uint8_t>& out, const std::string& value)
+{
+	spillWrite<uint32_t>(out, value.size());
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+static void spillWritePosition(std::vector<uint8_t>& out, const Position& position)
+{
+	spillWrite<int32_t>(out, position.x);
+	spillWrite<int32_t>(out, position.y);
+	spillWrite<int32_t>(out, position.z);
+}
+
+static void spillWriteSelection(std::vector<uint8_t>& out, const TileSelection& selection)
+{
+	spillWritePosition(out, selection.position);
+	spillWrite<uint8_t>(out, selection.flags);
+	spillWrite<uint32_t>(out, selection.items.size());
+	for(bool selected : selection.items)
+		spillWrite<uint8_t>(out, selected ? 1 : 0);
+}
+
+// Reads from a buffer that was written above, so it trusts the layout but
+// never reads past the end
+class SpillReader
+{
+public:
+	SpillReader(const std::vector<uint8_t>& data) : data(data), offset(0), ok(true) {}
+
+	template <typename T>
+	T read()
+	{
+		T value = T();
+		if(offset + sizeof(T) > data.size())
+		{
+			ok = false;
+			return value;
+		}
+		memcpy(&value, &data[offset], sizeof(T));
+		offset += sizeof(T);
+		return value;
+	}
+
+	std::string readString()
+	{
+		uint32_t size = read<uint32_t>();
+		if(!ok || offset + size > data.size())
+		{
+			ok = false;
+			return std::string();
+		}
+		std::string value(reinterpret_cast<const char*>(&data[offset]), size);
+		offset += size;
+		return value;
+	}
+
+	Position readPosition()
+	{
+		Position position;
+		position.x = read<int32_t>();
+		position.y = read<int32_t>();
+		position.z = read<int32_t>();
+		return position;
+	}
+
+	TileSelection readSelection()
+	{
+		TileSelection selection;
+		selection.position = readPosition();
+		selection.flags = read<uint8_t>();
+		uint32_t count = read<uint32_t>();
+		if(ok && offset + count <= data.size())
+		{
+			selection.items.resize(count);
+			for(uint32_t i = 0; i < count; ++i)
+				selection.items[i] = data[offset + i] != 0;
+			offset += count;
+		}
+		else
+		{
+			ok = false;
+		}
+		return selection;
+	}
+
+	const std::vector<uint8_t>& data;
+	size_t offset;
+	bool ok;
+};
+
+ActionSpill::ActionSpill() :
+	fileSize(0),
+	failed(false)
+{
+	//
+}
+
+ActionSpill::~ActionSpill()
+{
+	if(file.is_open())
+	{
+		file.close();
+		wxRemoveFile(wxstr(path));
+	}
+}
+
+bool ActionSpill::open()
+{
+	if(file.is_open())
+		return true;
+
+	// Only tried once, without a temporary directory history is dropped as before
+	if(failed)
+		return false;
+
+	wxString tempPath = wxFileName::CreateTempFileName(wxT("rme-undo"));
+	if(tempPath.empty())
+	{
+		failed = true;
+		return false;
+	}
+
+	path = nstr(tempPath);
+	file.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		wxRemoveFile(tempPath);
+		failed = true;
+		return false;
+	}
+
+	fileSize = 0;
+	return true;
+}
+
+void ActionSpill::writeTile(std::vector<uint8_t>& out, TileRecordWriter& writer, Tile* tile)
+{
+	spillWritePosition(out, tile->getPosition());
+	writer.write(out, tile);
+	spillWrite<uint32_t>(out, tile->house_id);
+	spillWrite<uint8_t>(out, tile->isModified() ? 1 : 0);
+	spillWriteSelection(out, TileSelection(tile));
+}
+
+Tile* ActionSpill::readTile(SpillReader& in, Map& map)
+{
+	Position position = in.readPosition();
+	if(!in.ok)
+		return nullptr;
+
+	Tile* tile = nullptr;
+	if(!records.read(in.data.data(), in.data.size(), in.offset, map, &map.houses, &position, tile))
+	{
+		in.ok = false;
+		return nullptr;
+	}
+	if(!tile)
+		tile = map.allocator(map.createTileL(position));
+
+	tile->house_id = in.read<uint32_t>();
+	if(in.read<uint8_t>() != 0)
+		tile->modify();
+
+	TileSelection selection = in.readSelection();
+	if(selection.fits(tile))
+		selection.apply(tile);
+	else
+		tile->update();
+	return tile;
+}
+
+uint64_t ActionSpill::allocate(uint64_t size)
+{
+	// First fit, batches of similar size tend to follow each other
+	for(std::map<uint64_t, uint64_t>::iterator it = freeRegions.begin(); it != freeRegions.end(); ++it)
+	{
+		if(it->second < size)
+			continue;
+
+		const uint64_t offset = it->first;
+		const uint64_t rest = it->second - size;
+		freeRegions.erase(it);
+		if(rest > 0)
+			freeRegions[offset + size] = rest;
+		return offset;
+	}
+
+	const uint64_t offset = fileSize;
+	fileSize += size;
+	return offset;
+}
+
+void ActionSpill::freeRegion(uint64_t offset, uint64_t size)
+{
+	std::map<uint64_t, uint64_t>::iterator next = freeRegions.lower_bound(offset);
+	if(next != freeRegions.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = freeRegions.erase(next);
+	}
+	if(next != freeRegions.begin())
+	{
+		std::map<uint64_t, uint64_t>::iterator previous = next;
+		--previous;
+		if(previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			freeRegions.erase(previous);
+		}
+	}
+
+	if(offset + size < fileSize)
+	{
+		freeRegions[offset] = size;
+		return;
+	}
+
+	// Nothing follows, the next batch is appended here instead
+	fileSize = offset;
+	if(fileSize == 0)
+		clear();
+}
+
+void ActionSpill::release(BatchAction* batch)
+{
+	if(!batch->spilled || !file.is_open())
+		return;
+
+	freeRegion(batch->spill_offset, batch->spill_size);
+	batch->spilled = false;
+}
+
+void ActionSpill::clear()
+{
+	freeRegions.clear();
+	fileSize = 0;
+	if(!file.is_open())
+		return;
+
+	// Gives the disk space back
+	file.close();
+	file.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+}
+
+bool ActionSpill::spill(BatchAction* batch)
+{
+	if(batch->spilled || !open())
+		return false;
+
+	std::vector<uint8_t> out;
+	TileRecordWriter writer;
+
+	spillWrite<uint32_t>(out, batch->batch.size());
+	for(Action* action : batch->batch)
+	{
+		spillWrite<uint8_t>(out, action->commited ? 1 : 0);
+		spillWrite<uint32_t>(out, action->changes.size());
+
+		for(Change* change : action->changes)
+		{
+			spillWrite<uint8_t>(out, change->type);
+			switch(change->type)
+			{
+				case CHANGE_TILE:
+					writeTile(out, writer, reinterpret_cast<Tile*>(change->data));
+					break;
+				case CHANGE_MOVE:
+				{
+					TileMove* move = reinterpret_cast<TileMove*>(change->data);
+					spillWritePosition(out, move->offset);
+					spillWrite<uint32_t>(out, move->positions.size());
+					for(const Position& position : move->positions)
+						spillWritePosition(out, position);
+					spillWrite<uint32_t>(out, move->displaced.size());
+					for(Tile* tile : move->displaced)
+						writeTile(out, writer, tile);
+					break;
+				}
+				case CHANGE_MOVE_HOUSE_EXIT:
+				{
+					std::pair<uint32_t, Position>* p = reinterpret_cast<std::pair<uint32_t, Position>* >(change->data);
+					spillWrite<uint32_t>(out, p->first);
+					spillWritePosition(out, p->second);
+					break;
+				}
+				case CHANGE_MOVE_WAYPOINT:
+				{
+					std::pair<std::string, Position>* p = reinterpret_cast<std::pair<std::string, Position>* >(change->data);
+					spillWriteString(out, p->first);
+					spillWritePosition(out, p->second);
+					break;
+				}
+				case CHANGE_SELECTION:
+					spillWriteSelection(out, *reinterpret_cast<TileSelection*>(change->data));
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	std::vector<uint8_t> compressed = LiveSocket::compressData(out.data(), out.size());
+
+	const uint64_t offset = allocate(compressed.size());
+	file.seekp(offset);
+	file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+	file.flush();
+	if(!file.good())
+	{
+		file.clear();
+		freeRegion(offset, compressed.size());
+		return false;
+	}
+
+	batch->spill_offset = offset;
+	batch->spill_size = compressed.size();
+	batch->spill_raw_size = out.size();
+	batch->spilled = true;
+
+	for(Action* action : batch->batch)
+		delete action;
+	batch->batch.clear();
+	return true;
+}
+
+bool ActionSpill::restore(ActionQueue& queue, BatchAction* batch)
+{
+	if(!batch->spilled || !file.is_open())
+		return false;
+
+	std::vector<uint8_t> compressed(batch->spill_size);
+	file.seekg(batch->spill_offset);
+	file.read(reinterpret_cast<char*>(compressed.data()), compressed.size());
+	if(!file.good())
+	{
+		file.clear();
+		return false;
+	}
+
+	std::vector<uint8_t> data(batch->spill_raw_size);
+	if(!LiveSocket::decompressData(compressed.data(), compressed.size(), data.data(), data.size()))
+		return false;
+
+	Editor& editor = batch->editor;
+	Map& map = editor.map;
+
+	SpillReader in(data);
+	ActionVector actions;
+
+	uint32_t actionCount = in.read<uint32_t>();
+	for(uint32_t a = 0; a < actionCount && in.ok; ++a)
+	{
+		Action* action = queue.createAction(batch->type);
+		action->commited = in.read<uint8_t>() != 0;
+		actions.push_back(action);
+
+		uint32_t changeCount = in.read<uint32_t>();
+		for(uint32_t c = 0; c < changeCount && in.ok; ++c)
+		{
+			ChangeType type = static_cast<ChangeType>(in.read<uint8_t>());
+			switch(type)
+			{
+				case CHANGE_TILE:
+				{
+					Tile* tile = readTile(in, map);
+					if(tile)
+						action->addChange(newd Change(tile));
+					break;
+				}
+				case CHANGE_MOVE:
+				{
+					TileMove* move = newd TileMove;
+					move->offset = in.readPosition();
+					uint32_t count = in.read<uint32_t>();
+					for(uint32_t i = 0; i < count && in.ok; ++i)
+						move->positions.push_back(in.readPosition());
+					count = in.read<uint32_t>();
+					for(uint32_t i = 0; i < count && in.ok; ++i)
+					{
+						if(Tile* tile = readTile(in, map))
+							move->displaced.push_back(tile);
+					}
+					action->addChange(Change::Create(move));
+					break;
+				}
+				case CHANGE_MOVE_HOUSE_EXIT:
+				{
+					Change* change = newd Change();
+					change->type = CHANGE_MOVE_HOUSE_EXIT;
+					std::pair<uint32_t, Position>* p = newd std::pair<uint32_t, Position>;
+					p->first = in.read<uint32_t>();
+					p->second = in.readPosition();
+					change->data = p;
+					action->addChange(change);
+					break;
+				}
+				case CHANGE_MOVE_WAYPOINT:
+				{
+					Change* change = newd Change();
+					change->type = CHANGE_MOVE_WAYPOINT;
+					std::pair<std::string, Position>* p = newd std::pair<std::string, Position>;
+					p->first = in.readString();
+					p->second = in.readPosition();
+					change->data = p;
+					action->addChange(change);
+					break;
+				}
+				case CHANGE_SELECTION:
+					action->addChange(Change::Create(in.readSelection()));
+					break;
+				default:
+					// Keeps the changes in their places
+					action->addChange(newd Change());
+					break;
+			}
+		}
+	}
+
+	if(!in.ok)
+	{
+		for(Action* action : actions)
+			delete action;
+		return false;
+	}
+
+	// Read back for good, the batch is written anew if it's spilled again
+	freeRegion(batch->spill_offset, batch->spill_size);
+	batch->batch = actions;
+	batch->spilled = false;
+	return true;
+}
@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_ACTION_SPILL_H_
+#define RME_ACTION_SPILL_H_
+
+#include "tile_record.h"
+
+#include <fstream>
+
+class BatchAction;
+class ActionQueue;
+class SpillReader;
+class Tile;
+class Map;
+
+// Moves old undo batches out of memory. A spilled batch is serialized
+// (tiles as OTBM nodes plus what OTBM doesn't cover, like spawns and
+// selection), compressed and written to a temporary file, its actions
+// are freed. Restoring reads it back into fresh actions. The space of
+// batches that were restored or dropped is reused by later ones.
+class ActionSpill
+{
+public:
+	ActionSpill();
+	~ActionSpill();
+
+	// False if the batch couldn't be written, it's left untouched then
+	bool spill(BatchAction* batch);
+	bool restore(ActionQueue& queue, BatchAction* batch);
+	// Frees the space of a spilled batch that is about to be deleted
+	void release(BatchAction* batch);
+
+	// Forgets everything that was spilled
+	void clear();
+
+protected:
+	bool open();
+	uint64_t allocate(uint64_t size);
+	void freeRegion(uint64_t offset, uint64_t size);
+
+	// A tile record plus what only undo needs, like the selection
+	void writeTile(std::vector<uint8_t>& out, TileRecordWriter& writer, Tile* tile);
+	Tile* readTile(SpillReader& in, Map& map);
+
+	std::string path;
+	std::fstream file;
+	// Where the next batch is appended if it fits in no free region
+	uint64_t fileSize;
+	// Regions no batch uses anymore, offset to size, never touching each other or the end
+	std::map<uint64_t, uint64_t> freeRegions;
+	bool failed;
+
+	TileRecordReader records;
+};
+
+#endif
@@ -30,6 +30,7 @@
 #include "about_window.h"
 #include "main_menubar.h"
 #include "updater.h"
+#include "headless.h"
 
 #include "materials.h"
 #include "map.h"
@@ -95,6 +96,7 @@ bool Application::OnInit()
 	std::cout << "This is free software: you are free to change and redistribute it." << std::endl;
 	std::cout << "There is NO WARRANTY, to the extent permitted by law." << std::endl;
 	std::cout << "Review COPYING in RME distribution for details." << std::endl;
+	headless = nullptr;
 	mt_seed(time(nullptr));
 	srand(time(nullptr));
 
@@ -110,6 +112,23 @@ bool Application::OnInit()
 	gui.LoadHotkeys();
 	ClientVersion::loadVersions();
 
+	// Command line modes never open the main window
+	wxArrayString arguments;
+	for(int i = 1; i < argc; ++i)
+		arguments.Add(argv[i]);
+
+	if(Headless::IsHeadlessCommand(arguments))
+	{
+#ifdef _USE_PROCESS_COM
+		proc_server = nullptr;
+#endif
+		gui.SetHeadless(true);
+		headless = newd Headless(arguments);
+		SetExitOnFrameDelete(false);
+		startup = false;
+		return true;
+	}
+
 #ifdef _USE_PROCESS_COM
 	proc_server = nullptr;
 	// Setup inter-process communice!
@@ -341,6 +360,20 @@ void Application::Unload()
 	gui.root = nullptr;
 }
 
+int Application::OnRun()
+{
+	if(!headless)
+		return wxApp::OnRun();
+
+	int exitCode = headless->Run();
+	delete headless;
+	headless = nullptr;
+
+	gui.UnloadVersion();
+	ClientVersion::unloadVersions();
+	return exitCode;
+}
+
 int Application::OnExit() {
 #ifdef _USE_PROCESS_COM
 	delete proc_server;
@@ -32,6 +32,7 @@ class Creature;
 
 class MainFrame;
 class MapWindow;
+class Headless;
 class wxEventLoopBase;
 
 class Application : public wxApp
@@ -39,6 +40,7 @@ class Application : public wxApp
 public:
 	~Application();
 	virtual bool OnInit();
+	virtual int OnRun();
 	virtual void OnEventLoopEnter(wxEventLoopBase* loop);
 	virtual int OnExit();
 	void Unload();
@@ -52,6 +54,9 @@ public:
 	RMEProcessServer* proc_server;
 #endif
 	bool startup;
+
+	// Set when started with one of the command line modes, see headless.h
+	Headless* headless;
 };
 
 class MainMenuBar;
@@ -58,6 +58,31 @@ void BaseMap::clearVisible(uint32_t mask)
 	root.clearVisible(mask);
 }
 
+void BaseMap::getLeaves(std::vector<QTreeNode*>& leaves)
+{
+	std::vector<QTreeNode*> stack(1, &root);
+	while(!stack.empty()) {
+		QTreeNode* node = stack.back();
+		stack.pop_back();
+
+		if(node->isLeaf) {
+			for(int z = 0; z < MAP_HEIGHT; ++z) {
+				if(node->array[z]) {
+					leaves.push_back(node);
+					break;
+				}
+			}
+			continue;
+		}
+
+		// Pushed backwards so they're visited in index order
+		for(int index = 15; index >= 0; --index) {
+			if(node->child[index])
+				stack.push_back(node->child[index]);
+		}
+	}
+}
+
 Tile* BaseMap::createTile(int x, int y, int z)
 {
 	ASSERT(z < MAP_HEIGHT);
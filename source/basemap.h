@@ -90,6 +90,8 @@ public:
 	// Get a Quad Tree Leaf from the map
 	QTreeNode* getLeaf(int x, int y) {return root.getLeaf(x, y);}
 	QTreeNode* createLeaf(int x, int y) {return root.getLeafForce(x, y);}
+	// Appends every leaf that holds at least one floor, in tree order
+	void getLeaves(std::vector<QTreeNode*>& leaves);
 
 	// Assigns a tile, it might seem pointless to provide position, but it is not, as the passed tile may be nullptr
 	void setTile(int _x, int _y, int _z, Tile* newtile, bool remove = false);
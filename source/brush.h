@@ -32,6 +32,7 @@ class BaseMap;
 class House;
 class Item;
 class Tile;
+class NeighbourWindow;
 typedef std::vector<Tile*> TileVector;
 class Brush;
 class GroundBrush;
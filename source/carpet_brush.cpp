@@ -7,6 +7,7 @@
 #include "carpet_brush.h"
 
 #include "basemap.h"
+#include "neighbour_window.h"
 #include "items.h"
 #include "pugicast.h"
 
@@ -166,8 +167,18 @@ void CarpetBrush::undraw(BaseMap* map, Tile* tile)
 
 void CarpetBrush::doCarpets(BaseMap* map, Tile* tile)
 {
-	static const auto hasMatchingCarpetBrushAtTile = [](BaseMap* map, CarpetBrush* carpetBrush, uint32_t x, uint32_t y, uint32_t z) -> bool {
-		Tile* tile = map->getTile(x, y, z);
+	ASSERT(tile);
+	if (!tile->hasCarpet()) {
+		return;
+	}
+
+	NeighbourWindow window(*map);
+	doCarpets(window, tile);
+}
+
+void CarpetBrush::doCarpets(const NeighbourWindow& window, Tile* tile)
+{
+	static const auto hasMatchingCarpetBrushAtTile = [](Tile* tile, CarpetBrush* carpetBrush) -> bool {
 		if (!tile) {
 			return false;
 		}
@@ -185,20 +196,9 @@ void CarpetBrush::doCarpets(BaseMap* map, Tile* tile)
 		return;
 	}
 
-	const Position& position = tile->getPosition();
-	uint32_t x = position.x;
-	uint32_t y = position.y;
-	uint32_t z = position.z;
-	/*
-	static const std::pair<int32_t, int32_t> positionOffset[8] = {
-		{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}
-	};
+	Tile* tiles[8];
+	window.getNeighbours(tile->getPosition(), tiles);
 
-	const auto& offset = positionOffset[i];
-	if (neighbours[i] && hasMatchingCarpetBrushAtTile(map, carpetBrush, x + offset.first, y + offset.second, z)) {
-		//
-	}
-	*/
 	for (Item* item : tile->items) {
 		ASSERT(item);
 
@@ -207,45 +207,9 @@ void CarpetBrush::doCarpets(BaseMap* map, Tile* tile)
 			continue;
 		}
 
-		bool neighbours[8] = { false };
-		if (x == 0) {
-			if (y == 0) {
-				neighbours[0] = false;
-				neighbours[1] = false;
-				neighbours[2] = false;
-				neighbours[3] = false;
-				neighbours[4] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y,     z);
-				neighbours[5] = false;
-				neighbours[6] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x,     y + 1, z);
-				neighbours[7] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y + 1, z);
-			} else {
-				neighbours[0] = false;
-				neighbours[1] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x,     y - 1, z);
-				neighbours[2] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y - 1, z);
-				neighbours[3] = false;
-				neighbours[4] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y,     z);
-				neighbours[5] = false;
-				neighbours[6] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x,     y + 1, z);
-				neighbours[7] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y + 1, z);
-			}
-		} else if (y == 0) {
-			neighbours[0] = false;
-			neighbours[1] = false;
-			neighbours[2] = false;
-			neighbours[3] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x - 1, y,     z);
-			neighbours[4] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y,     z);
-			neighbours[5] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x - 1, y + 1, z);
-			neighbours[6] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x,     y + 1, z);
-			neighbours[7] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y + 1, z);
-		} else {
-			neighbours[0] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x - 1, y - 1, z);
-			neighbours[1] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x,     y - 1, z);
-			neighbours[2] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y - 1, z);
-			neighbours[3] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x - 1, y,     z);
-			neighbours[4] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y,     z);
-			neighbours[5] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x - 1, y + 1, z);
-			neighbours[6] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x,     y + 1, z);
-			neighbours[7] = hasMatchingCarpetBrushAtTile(map, carpetBrush, x + 1, y + 1, z);
+		bool neighbours[8];
+		for (int32_t i = 0; i < 8; ++i) {
+			neighbours[i] = hasMatchingCarpetBrushAtTile(tiles[i], carpetBrush);
 		}
 
 		uint32_t tileData = 0;
@@ -22,6 +22,7 @@ class CarpetBrush : public Brush
 		virtual void undraw(BaseMap* map, Tile* tile);
 
 		static void doCarpets(BaseMap* map, Tile* tile);
+		static void doCarpets(const NeighbourWindow& window, Tile* tile);
 
 		virtual bool canDrag() const { return true; }
 		virtual bool needBorders() const { return true; }
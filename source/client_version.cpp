@@ -478,6 +478,10 @@ bool ClientVersion::loadValidPaths()
 {
 	while(hasValidPaths() == false)
 	{
+		// Nobody can browse for the folder, the paths have to be configured beforehand
+		if(gui.IsHeadless())
+			return false;
+
 		gui.PopupDialog(
 			wxT("Error"),
 			wxT("Could not locate Tibia.dat and/or Tibia.spr, please navigate to your Tibia ") +
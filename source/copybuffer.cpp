@@ -23,16 +23,52 @@
 #include "editor.h"
 #include "gui.h"
 #include "creature.h"
+#include "spawn.h"
+#include "live_socket.h"
+#include "tile_record.h"
+#include "neighbour_window.h"
+
+static const char clipboardIdentifier[] = "RMEC";
+static const uint32_t clipboardVersion = 1;
+
+static const wxDataFormat& GetClipboardFormat()
+{
+	static const wxDataFormat format(wxT("application/x-rme-copybuffer"));
+	return format;
+}
+
+template <typename T>
+static void bufferWrite(std::vector<uint8_t>& out, T value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool bufferRead(const uint8_t* data, size_t size, size_t& offset, T& value)
+{
+	if (offset + sizeof(T) > size) {
+		return false;
+	}
+	memcpy(&value, data + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
 
 CopyBuffer::CopyBuffer() :
-	tiles(newd BaseMap())
+	tiles(newd BaseMap()),
+	tileCount(0),
+	token((static_cast<uint64_t>(mt_randi()) << 32) | static_cast<uint32_t>(mt_randi())),
+	serial(0),
+	loadedToken(0),
+	loadedSerial(0)
 {
 	;
 }
 
 size_t CopyBuffer::GetTileCount()
 {
-	return tiles ? (size_t)tiles->size() : 0;
+	return tileCount;
 }
 
 BaseMap& CopyBuffer::getBufferMap()
@@ -44,6 +80,7 @@ BaseMap& CopyBuffer::getBufferMap()
 CopyBuffer::~CopyBuffer()
 {
 	clear();
+	delete tiles;
 }
 
 Position CopyBuffer::getPosition() const
@@ -53,8 +90,10 @@ Position CopyBuffer::getPosition() const
 }
 
 void CopyBuffer::clear() {
-	delete tiles;
-	tiles = nullptr;
+	tiles->clear();
+	serialized.clear();
+	chunks.clear();
+	tileCount = 0;
 }
 
 void CopyBuffer::copy(Editor& editor, int floor)
@@ -66,54 +105,66 @@ void CopyBuffer::copy(Editor& editor, int floor)
 	}
 
 	clear();
-	tiles = newd BaseMap();
 
 	int tile_count = 0;
 	int item_count = 0;
 	copyPos = Position(0xFFFF, 0xFFFF, floor);
 
-	for(TileVector::iterator it = editor.selection.begin(); it != editor.selection.end(); ++it)
+	ChunkedTiles grouped;
+	groupSelection(editor, grouped);
+
+	// Each copied tile is encoded right away, only one of them exists at a time
+	TileRecordWriter records;
+	std::vector<uint8_t> raw;
+	for(const auto& entry : grouped)
 	{
-		++tile_count;
+		raw.clear();
+		for(Tile* tile : entry.second)
+		{
+			++tile_count;
 
-		Tile* tile = *it;
-		TileLocation* newlocation = tiles->createTileL(tile->getPosition());
-		Tile* copied_tile = tiles->allocator(newlocation);
+			Tile* copied_tile = editor.map.allocator(tile->getLocation());
 
-		if(tile->ground && tile->ground->isSelected())
-		{
-			copied_tile->house_id = tile->house_id;
-			copied_tile->setMapFlags(tile->getMapFlags());
-		}
+			if(tile->ground && tile->ground->isSelected())
+			{
+				copied_tile->house_id = tile->house_id;
+				copied_tile->setMapFlags(tile->getMapFlags());
+			}
 
-		ItemVector tile_selection = tile->getSelectedItems();
-		for(ItemVector::iterator iit = tile_selection.begin();
-			iit != tile_selection.end();
-			++iit)
-		{
-			++item_count;
-			// Copy items to copybuffer
-			copied_tile->addItem((*iit)->deepCopy());
-		}
+			ItemVector tile_selection = tile->getSelectedItems();
+			for(ItemVector::iterator iit = tile_selection.begin();
+				iit != tile_selection.end();
+				++iit)
+			{
+				++item_count;
+				// Copy items to copybuffer
+				copied_tile->addItem((*iit)->deepCopy());
+			}
 
-		if(tile->creature && tile->creature->isSelected())
-		{
-			copied_tile->creature = tile->creature->deepCopy();
-		}
-		if(tile->spawn && tile->spawn->isSelected())
-		{
-			copied_tile->spawn = tile->spawn->deepCopy();
-		}
+			if(tile->creature && tile->creature->isSelected())
+			{
+				copied_tile->creature = tile->creature->deepCopy();
+			}
+			if(tile->spawn && tile->spawn->isSelected())
+			{
+				copied_tile->spawn = tile->spawn->deepCopy();
+			}
 
-		tiles->setTile(copied_tile);
+			const Position position = tile->getPosition();
+			records.write(raw, copied_tile, &position);
+			delete copied_tile;
 
-		if(copied_tile->getX() < copyPos.x)
-			copyPos.x = copied_tile->getX();
+			if(position.x < copyPos.x)
+				copyPos.x = position.x;
 
-		if(copied_tile->getY() < copyPos.y)
-			copyPos.y = copied_tile->getY();
+			if(position.y < copyPos.y)
+				copyPos.y = position.y;
+		}
+		addChunk(entry.first.first, entry.first.second, raw, entry.second.size());
 	}
 
+	publish();
+
 	std::ostringstream ss;
 	ss << "Copied " << tile_count << " tile" << (tile_count > 1 ? "s" : "") <<  " (" << item_count << " item" << (item_count > 1? "s" : "") << ")";
 	gui.SetStatusText(wxstr(ss.str()));
@@ -128,7 +179,6 @@ void CopyBuffer::cut(Editor& editor, int floor)
 	}
 
 	clear();
-	tiles = newd BaseMap();
 
 	int tile_count = 0;
 	int item_count = 0;
@@ -139,62 +189,74 @@ void CopyBuffer::cut(Editor& editor, int floor)
 
 	PositionList tilestoborder;
 
-	for(TileVector::iterator it = editor.selection.begin(); it != editor.selection.end(); ++it)
+	ChunkedTiles grouped;
+	groupSelection(editor, grouped);
+
+	// Same as copying, the cut parts are encoded as they are taken off
+	TileRecordWriter records;
+	std::vector<uint8_t> raw;
+	for(const auto& entry : grouped)
 	{
-		tile_count++;
+		raw.clear();
+		for(Tile* tile : entry.second)
+		{
+			tile_count++;
 
-		Tile* tile = *it;
-		Tile* newtile = tile->deepCopy(editor.map);
-		Tile* copied_tile = tiles->allocator(tile->getLocation());
+			Tile* newtile = tile->deepCopy(editor.map);
+			Tile* copied_tile = editor.map.allocator(tile->getLocation());
 
-		if(tile->ground && tile->ground->isSelected()) {
-			copied_tile->house_id = newtile->house_id;
-			newtile->house_id = 0;
-			copied_tile->setMapFlags(tile->getMapFlags());
-			newtile->setMapFlags(TILESTATE_NONE);
-		}
+			if(tile->ground && tile->ground->isSelected()) {
+				copied_tile->house_id = newtile->house_id;
+				newtile->house_id = 0;
+				copied_tile->setMapFlags(tile->getMapFlags());
+				newtile->setMapFlags(TILESTATE_NONE);
+			}
 
-		ItemVector tile_selection = newtile->popSelectedItems();
-		for(ItemVector::iterator iit = tile_selection.begin();
-			iit != tile_selection.end();
-			++iit)
-		{
-			item_count++;
-			// Add items to copybuffer
-			copied_tile->addItem(*iit);
-		}
+			ItemVector tile_selection = newtile->popSelectedItems();
+			for(ItemVector::iterator iit = tile_selection.begin();
+				iit != tile_selection.end();
+				++iit)
+			{
+				item_count++;
+				// Add items to copybuffer
+				copied_tile->addItem(*iit);
+			}
 
-		if(newtile->creature && newtile->creature->isSelected())
-		{
-			copied_tile->creature = newtile->creature;
-			newtile->creature = nullptr;
-		}
+			if(newtile->creature && newtile->creature->isSelected())
+			{
+				copied_tile->creature = newtile->creature;
+				newtile->creature = nullptr;
+			}
 
-		if(newtile->spawn && newtile->spawn->isSelected())
-		{
-			copied_tile->spawn = newtile->spawn;
-			newtile->spawn = nullptr;
-		}
+			if(newtile->spawn && newtile->spawn->isSelected())
+			{
+				copied_tile->spawn = newtile->spawn;
+				newtile->spawn = nullptr;
+			}
 
-		tiles->setTile(copied_tile->getPosition(), copied_tile);
+			const Position position = tile->getPosition();
+			records.write(raw, copied_tile, &position);
+			delete copied_tile;
 
-		if(copied_tile->getX() < copyPos.x)
-		{
-			copyPos.x = copied_tile->getX();
-		}
+			if(position.x < copyPos.x)
+			{
+				copyPos.x = position.x;
+			}
 
-		if(copied_tile->getY() < copyPos.y)
-		{
-			copyPos.y = copied_tile->getY();
-		}
+			if(position.y < copyPos.y)
+			{
+				copyPos.y = position.y;
+			}
 
-		if(settings.getInteger(Config::USE_AUTOMAGIC))
-		{
-			for(int y = -1; y <= 1; y++)
-				for(int x = -1; x <= 1; x++)
-					tilestoborder.push_back(Position(tile->getX() + x, tile->getY() + y, tile->getZ()));
+			if(settings.getInteger(Config::USE_AUTOMAGIC))
+			{
+				for(int y = -1; y <= 1; y++)
+					for(int x = -1; x <= 1; x++)
+						tilestoborder.push_back(Position(tile->getX() + x, tile->getY() + y, tile->getZ()));
+			}
+			action->addChange(newd Change(newtile));
 		}
-		action->addChange(newd Change(newtile));
+		addChunk(entry.first.first, entry.first.second, raw, entry.second.size());
 	}
 
 	batch->addAndCommitAction(action);
@@ -234,102 +296,202 @@ void CopyBuffer::cut(Editor& editor, int floor)
 		batch->addAndCommitAction(action);
 	}
 
+	publish();
+
 	editor.addBatch(batch);
 	std::stringstream ss;
 	ss << "Cut out " << tile_count << " tile" << (tile_count > 1 ? "s" : "") <<  " (" << item_count << " item" << (item_count > 1? "s" : "") << ")";
 	gui.SetStatusText(wxstr(ss.str()));
 }
 
+// Offsets of the eight neighbours, in the order NeighbourWindow returns them
+static const int neighbourOffsets[8][2] = {
+	{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}
+};
+
 void CopyBuffer::paste(Editor& editor, const Position& toPosition)
 {
-	if (!tiles) {
+	if (chunks.empty()) {
 		return;
 	}
 
+	// The preview may only have part of the buffer
+	decodeAll();
+
+	Map& map = editor.map;
+	const bool mergePaste = settings.getInteger(Config::MERGE_PASTE) != 0;
+	const bool doBorders = settings.getInteger(Config::USE_AUTOMAGIC) && settings.getInteger(Config::BORDERIZE_PASTE);
+	const Position offset = toPosition - copyPos;
+
+	// The buffer is pasted a group of leaves at a time, every group is its
+	// own action of the batch so it's on the map when the next one starts
+	std::vector<QTreeNode*> leaves;
+	tiles->getLeaves(leaves);
+
+	const bool showProgress = tileCount >= PASTE_PROGRESS_TILES;
+	const int32_t pasteProgress = doBorders ? 80 : 99;
+	if (showProgress) {
+		gui.CreateLoadBar(wxT("Pasting..."), true);
+	}
+
+	// Positions next to the paste that aren't pasted to themselves, and the
+	// pasted tiles next to them. Only these can need new borders.
+	PositionVector ring;
+	PositionVector edge;
+
 	BatchAction* batchAction = editor.actionQueue->createBatch(ACTION_PASTE_TILES);
-	Action* action = editor.actionQueue->createAction(batchAction);
-	for(MapIterator it = tiles->begin();
-			it != tiles->end();
-			++it)
-	{
-		Tile* buffer_tile = (*it)->get();
-		Position pos = buffer_tile->getPosition() - copyPos + toPosition;
+	bool cancelled = false;
+	size_t pastedLeaves = 0;
+	for (size_t chunk = 0; chunk < leaves.size() && !cancelled; chunk += PASTE_CHUNK_LEAVES) {
+		const size_t chunkEnd = std::min(leaves.size(), chunk + PASTE_CHUNK_LEAVES);
+
+		Action* action = editor.actionQueue->createAction(batchAction);
+		for (size_t leaf = chunk; leaf < chunkEnd; ++leaf) {
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaves[leaf]->getFloor(z);
+				if (!floor) {
+					continue;
+				}
 
-		if(pos.isValid() == false)
-			continue;
-		
-		TileLocation* location = editor.map.createTileL(pos);
-		Tile* copy_tile = buffer_tile->deepCopy(editor.map);
-		Tile* old_dest_tile = location->get();
-		Tile* new_dest_tile = nullptr;
-		copy_tile->setLocation(location);
-
-		if(settings.getInteger(Config::MERGE_PASTE) || !copy_tile->ground)
-		{
-			if(old_dest_tile)
-				new_dest_tile = old_dest_tile->deepCopy(editor.map);
-			else
-				new_dest_tile = editor.map.allocator(location);
-			new_dest_tile->merge(copy_tile);
-			delete copy_tile;
+				// The buffer around this floor of the leaf, tells where the paste ends
+				NeighbourWindow bufferWindow(*tiles, floor->locs[0].getPosition(), floor->locs[15].getPosition());
+
+				for (TileLocation& bufferLocation : floor->locs) {
+					Tile* buffer_tile = bufferLocation.get();
+					if (!buffer_tile) {
+						continue;
+					}
+
+					Position pos = buffer_tile->getPosition() + offset;
+					if (!pos.isValid()) {
+						continue;
+					}
+
+					TileLocation* location = map.createTileL(pos);
+					Tile* copy_tile = buffer_tile->deepCopy(map);
+					Tile* old_dest_tile = location->get();
+					Tile* new_dest_tile = nullptr;
+					copy_tile->setLocation(location);
+
+					if (mergePaste || !copy_tile->ground) {
+						if (old_dest_tile) {
+							new_dest_tile = old_dest_tile->deepCopy(map);
+						} else {
+							new_dest_tile = map.allocator(location);
+						}
+						new_dest_tile->merge(copy_tile);
+						delete copy_tile;
+					} else {
+						// If the copied tile has ground, replace target tile
+						new_dest_tile = copy_tile;
+					}
+					action->addChange(newd Change(new_dest_tile));
+
+					if (!doBorders) {
+						continue;
+					}
+
+					Tile* neighbours[8];
+					bufferWindow.getNeighbours(buffer_tile->getPosition(), neighbours);
+
+					bool atEdge = false;
+					for (int i = 0; i < 8; ++i) {
+						if (!neighbours[i]) {
+							ring.push_back(Position(pos.x + neighbourOffsets[i][0], pos.y + neighbourOffsets[i][1], pos.z));
+							atEdge = true;
+						}
+					}
+					if (atEdge) {
+						edge.push_back(pos);
+					}
+				}
+			}
 		}
-		else
-		{
-			// If the copied tile has ground, replace target tile
-			new_dest_tile = copy_tile;
+		batchAction->addAndCommitAction(action);
+		pastedLeaves = chunkEnd;
+
+		if (showProgress && !gui.SetLoadDone(static_cast<int32_t>(chunkEnd * pasteProgress / leaves.size()))) {
+			cancelled = true;
 		}
+	}
 
-		// Add all surrounding tiles to the map, so they get borders
-		editor.map.createTile(pos.x-1, pos.y-1, pos.z);
-		editor.map.createTile(pos.x  , pos.y-1, pos.z);
-		editor.map.createTile(pos.x+1, pos.y-1, pos.z);
-		editor.map.createTile(pos.x-1, pos.y  , pos.z);
-		editor.map.createTile(pos.x+1, pos.y  , pos.z);
-		editor.map.createTile(pos.x-1, pos.y+1, pos.z);
-		editor.map.createTile(pos.x  , pos.y+1, pos.z);
-		editor.map.createTile(pos.x+1, pos.y+1, pos.z);
+	if (doBorders && cancelled) {
+		// The ring above was worked out against the whole buffer, the
+		// neighbours in leaves that weren't pasted are outside the paste too
+		const std::set<QTreeNode*> pasted(leaves.begin(), leaves.begin() + pastedLeaves);
+		for (size_t leaf = 0; leaf < pastedLeaves; ++leaf) {
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaves[leaf]->getFloor(z);
+				if (!floor) {
+					continue;
+				}
 
-		action->addChange(newd Change(new_dest_tile));
+				for (TileLocation& bufferLocation : floor->locs) {
+					Tile* buffer_tile = bufferLocation.get();
+					if (!buffer_tile) {
+						continue;
+					}
+
+					const Position bufferPos = buffer_tile->getPosition();
+					const Position pos = bufferPos + offset;
+					if (!pos.isValid()) {
+						continue;
+					}
+
+					bool atEdge = false;
+					for (int i = 0; i < 8; ++i) {
+						const int x = bufferPos.x + neighbourOffsets[i][0];
+						const int y = bufferPos.y + neighbourOffsets[i][1];
+						// Neighbours missing from the buffer are in the ring already
+						if (!tiles->getTile(x, y, z) || pasted.count(tiles->getLeaf(x, y)) != 0) {
+							continue;
+						}
+						ring.push_back(Position(pos.x + neighbourOffsets[i][0], pos.y + neighbourOffsets[i][1], pos.z));
+						atEdge = true;
+					}
+					if (atEdge) {
+						edge.push_back(pos);
+					}
+				}
+			}
+		}
 	}
-	batchAction->addAndCommitAction(action);
 
-	if(settings.getInteger(Config::USE_AUTOMAGIC) && settings.getInteger(Config::BORDERIZE_PASTE))
-	{
-		action = editor.actionQueue->createAction(batchAction);
-		TileList borderize_tiles;
-		Map& map = editor.map;
-
-		// Go through all modified (selected) tiles (might be slow)
-		for(MapIterator it = tiles->begin();
-			it != tiles->end();
-			++it)
-		{
-			bool add_me = false; // If this tile is touched
-			Position pos = (*it)->getPosition() - copyPos + toPosition;
-			if(pos.z < 0 || pos.z >= MAP_HEIGHT) {
+	if (doBorders) {
+		// Neighbours shared by several pasted tiles are only visited once
+		std::sort(ring.begin(), ring.end());
+		ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+		std::sort(edge.begin(), edge.end());
+		edge.erase(std::unique(edge.begin(), edge.end()), edge.end());
+
+		std::vector<Tile*> borderize_tiles;
+		borderize_tiles.reserve(ring.size() + edge.size());
+		for (const Position& position : ring) {
+			if (!position.isValid()) {
 				continue;
 			}
-			// Go through all neighbours
-			Tile* t;
-			t = map.getTile(pos.x-1, pos.y-1, pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x  , pos.y-1, pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x+1, pos.y-1, pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x-1, pos.y  , pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x+1, pos.y  , pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x-1, pos.y+1, pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x  , pos.y+1, pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			t = map.getTile(pos.x+1, pos.y+1, pos.z); if(t && !t->isSelected()) {borderize_tiles.push_back(t); add_me = true;}
-			if(add_me) borderize_tiles.push_back(map.getTile(pos));
+
+			// Add the surrounding tiles to the map, so they get borders
+			Tile* tile = map.createTile(position.x, position.y, position.z);
+			if (!tile->isSelected()) {
+				borderize_tiles.push_back(tile);
+			}
 		}
-		// Remove duplicates
-		borderize_tiles.sort();
-		borderize_tiles.unique();
+		for (const Position& position : edge) {
+			if (Tile* tile = map.getTile(position)) {
+				borderize_tiles.push_back(tile);
+			}
+		}
+
+		for (size_t chunk = 0; chunk < borderize_tiles.size(); chunk += PASTE_CHUNK_TILES) {
+			const size_t chunkEnd = std::min(borderize_tiles.size(), chunk + PASTE_CHUNK_TILES);
 
-		for (Tile* tile : borderize_tiles) {
-			if (tile) {
-				Tile* newTile = tile->deepCopy(editor.map);
+			Action* action = editor.actionQueue->createAction(batchAction);
+			for (size_t i = chunk; i < chunkEnd; ++i) {
+				Tile* tile = borderize_tiles[i];
+				Tile* newTile = tile->deepCopy(map);
 				newTile->borderize(&map);
-				
+
 				if (tile->ground && tile->ground->isSelected()) {
 					newTile->selectGround();
 				}
@@ -337,17 +499,274 @@ void CopyBuffer::paste(Editor& editor, const Position& toPosition)
 				newTile->wallize(&map);
 				action->addChange(newd Change(newTile));
 			}
-		}
 
-		// Commit changes to map
-		batchAction->addAndCommitAction(action);
+			// Commit changes to map
+			batchAction->addAndCommitAction(action);
+
+			if (showProgress) {
+				gui.SetLoadDone(pasteProgress + static_cast<int32_t>(chunkEnd * (99 - pasteProgress) / borderize_tiles.size()));
+			}
+		}
 	}
 
 	editor.addBatch(batchAction);
+
+	if (showProgress) {
+		gui.DestroyLoadBar();
+	}
+	if (cancelled) {
+		gui.SetStatusText(wxT("Paste cancelled, the part already pasted can be undone."));
+	}
+
+	// Big buffers don't stay decoded, the preview brings back what it shows
+	if (tileCount > PREVIEW_CACHE_TILES) {
+		releaseDecoded();
+	}
 }
 
 bool CopyBuffer::canPaste() const
 {
-	return tiles && tiles->size() != 0;
+	if (!chunks.empty()) {
+		return true;
+	}
+
+	bool available = false;
+	if (wxTheClipboard->Open()) {
+		available = wxTheClipboard->IsSupported(GetClipboardFormat());
+		wxTheClipboard->Close();
+	}
+	return available;
+}
+
+void CopyBuffer::groupSelection(Editor& editor, ChunkedTiles& grouped) const
+{
+	for (Tile* tile : editor.selection) {
+		grouped[std::make_pair(tile->getX() / CHUNK_SIZE, tile->getY() / CHUNK_SIZE)].push_back(tile);
+	}
+}
+
+void CopyBuffer::addChunk(int32_t x, int32_t y, const std::vector<uint8_t>& raw, uint32_t count)
+{
+	std::vector<uint8_t> compressed = LiveSocket::compressData(raw.data(), raw.size());
+
+	// Decoded only once the preview or a paste needs it
+	Chunk chunk;
+	chunk.x = x;
+	chunk.y = y;
+	chunk.offset = serialized.size();
+	chunk.size = compressed.size();
+	chunk.rawSize = raw.size();
+	chunk.tileCount = count;
+	chunk.decoded = false;
+	chunks.push_back(chunk);
+
+	serialized.insert(serialized.end(), compressed.begin(), compressed.end());
+	tileCount += count;
+}
+
+void CopyBuffer::decodeChunk(Chunk& chunk)
+{
+	if (chunk.decoded) {
+		return;
+	}
+	chunk.decoded = true;
+
+	std::vector<uint8_t> raw(chunk.rawSize);
+	if (!LiveSocket::decompressData(&serialized[chunk.offset], chunk.size, raw.data(), raw.size())) {
+		return;
+	}
+
+	TileRecordReader records;
+	size_t offset = 0;
+	for (uint32_t i = 0; i < chunk.tileCount; ++i) {
+		// The records carry their positions
+		Tile* tile = nullptr;
+		if (!records.read(raw.data(), raw.size(), offset, *tiles, nullptr, nullptr, tile)) {
+			break;
+		}
+		if (!tile) {
+			continue;
+		}
+
+		// Only selected things are copied, pasted they're selected again
+		tile->select();
+		tile->update();
+		tiles->setTile(tile->getPosition(), tile);
+	}
+}
+
+void CopyBuffer::decodeAll()
+{
+	for (Chunk& chunk : chunks) {
+		decodeChunk(chunk);
+	}
+}
+
+void CopyBuffer::releaseDecoded()
+{
+	tiles->clear();
+	for (Chunk& chunk : chunks) {
+		chunk.decoded = false;
+	}
+}
+
+void CopyBuffer::prepareArea(int start_x, int start_y, int end_x, int end_y)
+{
+	if (end_x < 0 || end_y < 0) {
+		return;
+	}
+
+	const int chunk_start_x = std::max(start_x, 0) / CHUNK_SIZE;
+	const int chunk_start_y = std::max(start_y, 0) / CHUNK_SIZE;
+	const int chunk_end_x = end_x / CHUNK_SIZE;
+	const int chunk_end_y = end_y / CHUNK_SIZE;
+
+	std::vector<Chunk*> missing;
+	size_t needed = 0;
+	for (Chunk& chunk : chunks) {
+		if (chunk.decoded || chunk.x < chunk_start_x || chunk.x > chunk_end_x || chunk.y < chunk_start_y || chunk.y > chunk_end_y) {
+			continue;
+		}
+		missing.push_back(&chunk);
+		needed += chunk.tileCount;
+	}
+
+	if (missing.empty()) {
+		return;
+	}
+
+	// What was decoded for other parts of the screen goes first
+	if (tiles->size() + needed > PREVIEW_CACHE_TILES) {
+		releaseDecoded();
+	}
+
+	for (Chunk* chunk : missing) {
+		decodeChunk(*chunk);
+	}
+}
+
+void CopyBuffer::publish()
+{
+	++serial;
+
+	std::vector<uint8_t> payload;
+	payload.insert(payload.end(), clipboardIdentifier, clipboardIdentifier + 4);
+	bufferWrite<uint32_t>(payload, clipboardVersion);
+	bufferWrite<uint32_t>(payload, gui.GetCurrentVersionID());
+	bufferWrite<uint64_t>(payload, token);
+	bufferWrite<uint32_t>(payload, serial);
+	bufferWrite<int32_t>(payload, copyPos.x);
+	bufferWrite<int32_t>(payload, copyPos.y);
+	bufferWrite<int32_t>(payload, copyPos.z);
+	bufferWrite<uint32_t>(payload, tileCount);
+	bufferWrite<uint32_t>(payload, chunks.size());
+	for (const Chunk& chunk : chunks) {
+		bufferWrite<int32_t>(payload, chunk.x);
+		bufferWrite<int32_t>(payload, chunk.y);
+		bufferWrite<uint32_t>(payload, chunk.size);
+		bufferWrite<uint32_t>(payload, chunk.rawSize);
+		bufferWrite<uint32_t>(payload, chunk.tileCount);
+	}
+	payload.insert(payload.end(), serialized.begin(), serialized.end());
+
+	if (wxTheClipboard->Open()) {
+		wxCustomDataObject* object = newd wxCustomDataObject(GetClipboardFormat());
+		object->SetData(payload.size(), payload.data());
+		wxTheClipboard->SetData(object);
+		wxTheClipboard->Close();
+	}
+}
+
+void CopyBuffer::fetchClipboard()
+{
+	if (!wxTheClipboard->Open()) {
+		return;
+	}
+
+	wxCustomDataObject object(GetClipboardFormat());
+	const bool fetched = wxTheClipboard->IsSupported(GetClipboardFormat()) && wxTheClipboard->GetData(object);
+	wxTheClipboard->Close();
+
+	if (fetched) {
+		load(static_cast<const uint8_t*>(object.GetData()), object.GetSize());
+	}
 }
 
+bool CopyBuffer::load(const uint8_t* data, size_t size)
+{
+	if (size < 4 || memcmp(data, clipboardIdentifier, 4) != 0) {
+		return false;
+	}
+
+	size_t offset = 4;
+	uint32_t version = 0;
+	uint32_t clientVersion = 0;
+	uint64_t otherToken = 0;
+	uint32_t otherSerial = 0;
+	if (!bufferRead(data, size, offset, version) || version != clipboardVersion ||
+		!bufferRead(data, size, offset, clientVersion) ||
+		!bufferRead(data, size, offset, otherToken) ||
+		!bufferRead(data, size, offset, otherSerial)) {
+		return false;
+	}
+
+	// Our own copy, or one that was already taken over
+	if (otherToken == token || (otherToken == loadedToken && otherSerial == loadedSerial)) {
+		return true;
+	}
+
+	// Item ids only mean the same thing within one client version
+	if (clientVersion != static_cast<uint32_t>(gui.GetCurrentVersionID())) {
+		gui.SetStatusText(wxT("The tiles on the clipboard are from another client version."));
+		return false;
+	}
+
+	int32_t x = 0, y = 0, z = 0;
+	uint32_t count = 0;
+	uint32_t chunkCount = 0;
+	if (!bufferRead(data, size, offset, x) || !bufferRead(data, size, offset, y) || !bufferRead(data, size, offset, z) ||
+		!bufferRead(data, size, offset, count) || !bufferRead(data, size, offset, chunkCount)) {
+		return false;
+	}
+
+	const size_t chunkHeaderSize = 4 + 4 + 4 + 4 + 4;
+	if (chunkCount > (size - offset) / chunkHeaderSize) {
+		return false;
+	}
+
+	const int32_t maxChunk = 0xFFFF / CHUNK_SIZE;
+	const uint32_t maxChunkTiles = CHUNK_SIZE * CHUNK_SIZE * MAP_HEIGHT;
+
+	std::vector<Chunk> newChunks(chunkCount);
+	uint64_t dataSize = 0;
+	uint64_t chunkTiles = 0;
+	for (Chunk& chunk : newChunks) {
+		bufferRead(data, size, offset, chunk.x);
+		bufferRead(data, size, offset, chunk.y);
+		bufferRead(data, size, offset, chunk.size);
+		bufferRead(data, size, offset, chunk.rawSize);
+		bufferRead(data, size, offset, chunk.tileCount);
+		if (chunk.x < 0 || chunk.x > maxChunk || chunk.y < 0 || chunk.y > maxChunk ||
+			chunk.rawSize > CHUNK_MAX_RAW_SIZE || chunk.tileCount > maxChunkTiles) {
+			return false;
+		}
+		chunk.offset = dataSize;
+		chunk.decoded = false;
+		dataSize += chunk.size;
+		chunkTiles += chunk.tileCount;
+	}
+
+	if (offset + dataSize > size || chunkTiles != count) {
+		return false;
+	}
+
+	clear();
+	copyPos = Position(x, y, z);
+	chunks.swap(newChunks);
+	serialized.assign(data + offset, data + offset + dataSize);
+	tileCount = count;
+
+	loadedToken = otherToken;
+	loadedSerial = otherSerial;
+	return true;
+}
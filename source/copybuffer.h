@@ -24,9 +24,15 @@
 
 #include "position.h"
 #include "basemap.h"
+#include "iomap.h"
 
 class Editor;
 
+// Copied tiles are kept as compressed OTBM tile nodes, in chunks of
+// CHUNK_SIZE x CHUNK_SIZE tiles on all floors. A chunk is decoded into the
+// buffer map only when it's needed, by the paste preview for what is on
+// screen or when pasting. The same stream goes to the system clipboard, so
+// another instance of the editor can paste it.
 class CopyBuffer
 {
 public:
@@ -46,12 +52,62 @@ public:
 
 	size_t GetTileCount();
 
+	// Only the chunks that were prepared are in it
 	BaseMap& getBufferMap();
+	// Decodes the chunks that overlap the area (buffer coordinates, all floors)
+	void prepareArea(int start_x, int start_y, int end_x, int end_y);
+
+	// Takes over the tiles on the system clipboard if they were put there by
+	// another instance of the editor
+	void fetchClipboard();
+
 private:
+	struct Chunk
+	{
+		int32_t x, y;
+		uint32_t offset;
+		uint32_t size;
+		uint32_t rawSize;
+		uint32_t tileCount;
+		bool decoded;
+	};
+
+	// The selected tiles by chunk, in the order the chunks are kept
+	typedef std::map<std::pair<int32_t, int32_t>, std::vector<Tile*>> ChunkedTiles;
+	void groupSelection(Editor& editor, ChunkedTiles& grouped) const;
+	// Compresses the tile records of one chunk and appends it
+	void addChunk(int32_t x, int32_t y, const std::vector<uint8_t>& raw, uint32_t count);
+	void decodeChunk(Chunk& chunk);
+	void decodeAll();
+	// Drops the decoded tiles, the chunks stay
+	void releaseDecoded();
+
+	void publish();
+	bool load(const uint8_t* data, size_t size);
+
+	static const int CHUNK_SIZE = 32;
+	// Clipboard data comes from another process, larger chunks are refused
+	static const uint32_t CHUNK_MAX_RAW_SIZE = 64 * 1024 * 1024;
+	// Pastes are done this many buffer leaves (or border tiles) at a time
+	static const size_t PASTE_CHUNK_LEAVES = 256;
+	static const size_t PASTE_CHUNK_TILES = 4096;
+	// Pastes of at least this many tiles show a progress bar that can cancel them
+	static const size_t PASTE_PROGRESS_TILES = 16384;
+	// The preview keeps at most this many tiles decoded
+	static const size_t PREVIEW_CACHE_TILES = 1 << 18;
+
 	Position copyPos;
 	BaseMap* tiles;
-	unsigned char* serialized;
-	size_t serialized_size;
+	std::vector<uint8_t> serialized;
+	std::vector<Chunk> chunks;
+	size_t tileCount;
+	// Tells our own clipboard contents apart from another editor's, every
+	// copy or cut gets the next serial
+	uint64_t token;
+	uint32_t serial;
+	// The buffer of another editor that was last taken over
+	uint64_t loadedToken;
+	uint32_t loadedSerial;
 };
 
 #endif
@@ -9,6 +9,7 @@
 #include "tile.h"
 #include "creature.h"
 #include "basemap.h"
+#include "map.h"
 #include "spawn.h"
 
 //=============================================================================
@@ -36,11 +37,18 @@ std::string CreatureBrush::getName() const {
 	return "Creature Brush";
 }
 
+// Spawns are only known to the real map
+static bool IsInSpawn(BaseMap* map, const Position& position)
+{
+	Map* real_map = dynamic_cast<Map*>(map);
+	return real_map && real_map->spawns.countSpawns(position) != 0;
+}
+
 bool CreatureBrush::canDraw(BaseMap* map, const Position& position) const
 {
 	Tile* tile = map->getTile(position);
 	if (creature_type && tile && !tile->isBlocking()) {
-		if (tile->getLocation()->getSpawnCount() != 0 || settings.getInteger(Config::AUTO_CREATE_SPAWN)) {
+		if (IsInSpawn(map, position) || settings.getInteger(Config::AUTO_CREATE_SPAWN)) {
  		   if (tile->isPZ()) {
 				if (creature_type->isNpc) {
 					return true;
@@ -64,7 +72,7 @@ void CreatureBrush::draw(BaseMap* map, Tile* tile, void* parameter) {
 	if(canDraw(map, tile->getPosition())) {
 		undraw(map, tile);
 		if(creature_type) {
-			if (tile->spawn == nullptr && tile->getLocation()->getSpawnCount() == 0) {
+			if (tile->spawn == nullptr && !IsInSpawn(map, tile->getPosition())) {
 				// manually place spawn on location
 				tile->spawn = newd Spawn(1);
 			}
@@ -23,6 +23,11 @@
 #include "doodad_brush.h"
 #include "creature_brush.h"
 #include "spawn_brush.h"
+#include "neighbour_window.h"
+#include "threads.h"
+#include "reachability.h"
+#include "map_diff.h"
+#include "iomap_otbm.h"
 
 #include "live_server.h"
 #include "live_client.h"
@@ -34,7 +39,9 @@ Editor::Editor(CopyBuffer& copybuffer) :
 	actionQueue(newd ActionQueue(*this)),
 	selection(*this),
 	copybuffer(copybuffer),
-	replace_brush(nullptr)
+	replace_brush(nullptr),
+	reachability(nullptr),
+	diff(nullptr)
 {
 	wxString error;
 	wxArrayString warnings;
@@ -82,7 +89,9 @@ Editor::Editor(CopyBuffer& copybuffer, const FileName& fn) :
 	actionQueue(newd ActionQueue(*this)),
 	selection(*this),
 	copybuffer(copybuffer),
-	replace_brush(nullptr)
+	replace_brush(nullptr),
+	reachability(nullptr),
+	diff(nullptr)
 {
 	MapVersion ver;
 	if(!IOMapOTBM::getVersionInfo(fn, ver)) {
@@ -139,7 +148,9 @@ Editor::Editor(CopyBuffer& copybuffer, LiveClient* client) :
 	actionQueue(newd NetworkedActionQueue(*this)),
 	selection(*this),
 	copybuffer(copybuffer),
-	replace_brush(nullptr)
+	replace_brush(nullptr),
+	reachability(nullptr),
+	diff(nullptr)
 {
 	;
 }
@@ -152,6 +163,8 @@ Editor::~Editor() {
 	UnnamedRenderingLock();
 	selection.clear();
 	delete actionQueue;
+	delete reachability;
+	delete diff;
 }
 
 void Editor::addBatch(BatchAction* action, int stacking_delay) {
@@ -355,6 +368,10 @@ void Editor::saveMap(FileName filename, bool showdialog) {
 	}
 
 	map.clearChanges();
+
+	// Everything journaled so far is part of the saved map now
+	if(live_server)
+		live_server->truncateJournal();
 }
 
 bool Editor::importMiniMap(FileName filename, int import, int import_x_offset, int import_y_offset, int import_z_offset)
@@ -368,29 +385,142 @@ bool Editor::exportMiniMap(FileName filename, int floor /*= 7*/, bool displaydia
 }
 
 
+// Puts the tiles of an imported map straight into ours as they are read,
+// moved by the import offset
+class ImportTileSink : public OTBMTileSink
+{
+public:
+	ImportTileSink(Map& map, const Position& offset, ImportType house_import_type, std::map<uint32_t, uint32_t>& house_id_map) :
+		map(map), offset(offset), house_import_type(house_import_type), house_id_map(house_id_map),
+		resizemap(false), resize_asked(false),
+		newsize_x(map.getWidth()), newsize_y(map.getHeight()),
+		discarded_tiles(0)
+	{
+		//
+	}
+
+	virtual Tile* createTile(const Position& position)
+	{
+		Position new_pos = position + offset;
+		if(!new_pos.isValid()) {
+			++discarded_tiles;
+			return nullptr;
+		}
+
+		if(resizemap == false && (new_pos.x > map.getWidth() || new_pos.y > map.getHeight())) {
+			if(resize_asked) {
+				++discarded_tiles;
+				return nullptr;
+			} else {
+				resize_asked = true;
+				int ret = gui.PopupDialog(wxT("Collision"), wxT("The imported tiles are outside the current map scope. Do you want to resize the map? (Else additional tiles will be removed)"), wxYES | wxNO);
+
+				if(ret == wxID_YES) {
+					resizemap = true;
+				} else {
+					++discarded_tiles;
+					return nullptr;
+				}
+			}
+		}
+
+		if(new_pos.x > newsize_x) {
+			newsize_x = new_pos.x;
+		}
+		if(new_pos.y > newsize_y) {
+			newsize_y = new_pos.y;
+		}
+
+		return map.allocator(map.createTileL(new_pos));
+	}
+
+	virtual House* getHouse(uint32_t house_id)
+	{
+		if(house_import_type == IMPORT_DONT) {
+			return nullptr;
+		}
+
+		std::map<uint32_t, uint32_t>::iterator it = house_id_map.find(house_id);
+		if(it != house_id_map.end()) {
+			return map.houses.getHouse(it->second);
+		}
+
+		// A house that only its tiles know about
+		House* house = nullptr;
+		if(house_import_type != IMPORT_INSERT) {
+			house = map.houses.getHouse(house_id);
+		}
+		if(!house) {
+			house = newd House(map);
+			house->id = house_import_type == IMPORT_INSERT ? map.houses.getEmptyID() : house_id;
+			map.houses.addHouse(house);
+		}
+		house_id_map[house_id] = house->id;
+		return house;
+	}
+
+	virtual void addTile(Tile* tile, House* house)
+	{
+		if(house) {
+			house->addTile(tile);
+		}
+
+		if(offset != Position(0,0,0)) {
+			for(ItemVector::iterator iter = tile->items.begin();
+					iter != tile->items.end();
+					++iter)
+			{
+				Item* item = *iter;
+				if(Teleport* teleport = dynamic_cast<Teleport*>(item)) {
+					teleport->setDestination(teleport->getDestination() + offset);
+				}
+			}
+		}
+
+		Tile* old_tile = map.getTile(tile->getPosition());
+		if(old_tile) {
+			map.removeSpawn(old_tile);
+		}
+
+		map.setTile(tile->getPosition(), tile, true);
+	}
+
+	virtual void progress(size_t read, size_t size)
+	{
+		// A load bar at 100% is gone, the spawns are still to come
+		gui.SetLoadDone(std::min<int32_t>(99, static_cast<int32_t>(100.0 * read / size)));
+	}
+
+	Map& map;
+	Position offset;
+	ImportType house_import_type;
+	std::map<uint32_t, uint32_t>& house_id_map;
+
+	bool resizemap;
+	bool resize_asked;
+	int newsize_x, newsize_y;
+	int discarded_tiles;
+};
+
 bool Editor::importMap(FileName filename, int import_x_offset, int import_y_offset, ImportType house_import_type, ImportType spawn_import_type)
 {
 	selection.clear();
 	actionQueue->clear();
 
-	Map imported_map;
-	bool loaded = imported_map.open(nstr(filename.GetFullPath()));
+	// Only the towns, houses and waypoints of the imported map are loaded,
+	// its tiles are read straight into ours further down
+	gui.CreateLoadBar(wxT("Merging maps..."));
 
-	if(!loaded) {
-		gui.PopupDialog(wxT("Error"), wxT("Error loading map!\n") + imported_map.getError(), wxOK | wxICON_INFORMATION);
+	Map imported_map;
+	IOMapOTBM loader(imported_map.getVersion());
+	if(!loader.loadMapInfo(imported_map, filename)) {
+		gui.DestroyLoadBar();
+		gui.PopupDialog(wxT("Error"), wxT("Error loading map!\n") + loader.getError(), wxOK | wxICON_INFORMATION);
 		return false;
 	}
-	gui.ListDialog(wxT("Warning"), imported_map.getWarnings());
 
 	Position offset(import_x_offset, import_y_offset, 0);
 
-	bool resizemap = false;
-	bool resize_asked = false;
-	int newsize_x = map.getWidth(), newsize_y = map.getHeight();
-	int discarded_tiles = 0;
-
-	gui.CreateLoadBar(wxT("Merging maps..."));
-
 	std::map<uint32_t, uint32_t> town_id_map;
 	std::map<uint32_t, uint32_t> house_id_map;
 
@@ -541,50 +671,6 @@ bool Editor::importMap(FileName filename, int import_x_offset, int import_y_offs
 		}
 	}
 
-	std::map<Position, Spawn*> spawn_map;
-	if(spawn_import_type != IMPORT_DONT)
-	{
-		for(SpawnPositionList::iterator siter = imported_map.spawns.begin();
-				siter != imported_map.spawns.end();)
-		{
-			Position old_spawn_pos = *siter;
-			Position new_spawn_pos = *siter + offset;
-			switch(spawn_import_type)
-			{
-				case IMPORT_SMART_MERGE:
-				case IMPORT_INSERT:
-				case IMPORT_MERGE: 
-				{
-					Tile* imported_tile = imported_map.getTile(old_spawn_pos);
-					if(imported_tile)
-					{
-						ASSERT(imported_tile->spawn);
-						spawn_map[new_spawn_pos] = imported_tile->spawn;
-
-						SpawnPositionList::iterator next = siter;
-						bool cont = true;
-						Position next_spawn;
-
-						++next;
-						if(next == imported_map.spawns.end())
-							cont = false;
-						else
-							next_spawn = *next;
-						imported_map.spawns.erase(siter);
-						if(cont)
-							siter = imported_map.spawns.find(next_spawn);
-						else
-							siter = imported_map.spawns.end();
-					}
-				} break;
-				case IMPORT_DONT:
-				{
-					++siter;
-				} break;
-			}
-		}
-	}
-
 	// Plain merge of waypoints, very simple! :)
 	for(WaypointMap::iterator iter = imported_map.waypoints.begin();
 		iter != imported_map.waypoints.end();
@@ -597,110 +683,24 @@ bool Editor::importMap(FileName filename, int import_x_offset, int import_y_offs
 	imported_map.waypoints.waypoints.clear();
 
 
-	uint64_t tiles_merged = 0;
-	uint64_t tiles_to_import = imported_map.tilecount;
-	for(MapIterator mit = imported_map.begin();
-			mit != imported_map.end();
-			++mit)
-	{
-		if(tiles_merged % 8092 == 0) {
-			gui.SetLoadDone(int(100.0 * tiles_merged / tiles_to_import));
-		}
-		++tiles_merged;
-
-		Tile* import_tile = (*mit)->get();
-		Position new_pos = import_tile->getPosition() + offset;
-		if(!new_pos.isValid()) {
-			++discarded_tiles;
-			continue;
-		}
-
-		if(resizemap == false && (new_pos.x > map.getWidth() || new_pos.y > map.getHeight())) {
-			if(resize_asked) {
-				++discarded_tiles;
-				continue;
-			} else {
-				resize_asked = true;
-				int ret = gui.PopupDialog(wxT("Collision"), wxT("The imported tiles are outside the current map scope. Do you want to resize the map? (Else additional tiles will be removed)"), wxYES | wxNO);
+	ImportTileSink sink(map, offset, house_import_type, house_id_map);
+	bool streamed = loader.streamTiles(imported_map, filename, sink);
 
-				if(ret == wxID_YES) {
-					// ...
-					resizemap = true;
-				} else {
-					++discarded_tiles;
-					continue;
-				}
-			}
-		}
-
-		if(new_pos.x > newsize_x) {
-			newsize_x = new_pos.x;
-		}
-		if(new_pos.y > newsize_y) {
-			newsize_y = new_pos.y;
-		}
-
-		imported_map.setTile(import_tile->getPosition(), nullptr);
-		TileLocation* location = map.createTileL(new_pos);
-
-		
-		// Check if we should update any houses
-		int new_houseid = house_id_map[import_tile->getHouseID()];
-		House* house = map.houses.getHouse(new_houseid);
-		if(import_tile->isHouseTile() && house_import_type != IMPORT_DONT && house) {
-			// We need to notify houses of the tile moving
-			house->removeTile(import_tile);
-			import_tile->setLocation(location);
-			house->addTile(import_tile);
-		} else {
-			import_tile->setLocation(location);
-		}
-
-		if(offset != Position(0,0,0)) {
-			for(ItemVector::iterator iter = import_tile->items.begin();
-					iter != import_tile->items.end();
-					++iter)
-			{
-				Item* item = *iter;
-				if(Teleport* teleport = dynamic_cast<Teleport*>(item)) {
-					teleport->setDestination(teleport->getDestination() + offset);
-				}
-			}
-		}
-
-		Tile* old_tile = map.getTile(new_pos);
-		if(old_tile) {
-			map.removeSpawn(old_tile);
-		}
-		import_tile->spawn = nullptr;
-
-		map.setTile(new_pos, import_tile, true);
-	}
-
-	for(std::map<Position, Spawn*>::iterator spawn_iter = spawn_map.begin();
-			spawn_iter != spawn_map.end();
-			++spawn_iter)
-	{
-		Position pos = spawn_iter->first;
-		TileLocation* location = map.createTileL(pos);
-		Tile* tile = location->get();
-		if(!tile) {
-			tile = map.allocator(location);
-			map.setTile(pos, tile);
-		} else if(tile->spawn) {
-			map.removeSpawnInternal(tile);
-			delete tile->spawn;
-		}
-		tile->spawn = spawn_iter->second;
-
-		map.addSpawn(tile);
+	// Spawns need their tiles to be in place
+	if(streamed && spawn_import_type != IMPORT_DONT) {
+		loader.importSpawns(map, filename, imported_map.spawnfile, offset, sink);
 	}
 
 	gui.DestroyLoadBar();
+	gui.ListDialog(wxT("Warning"), loader.getWarnings());
 
-	map.setWidth(newsize_x);
-	map.setHeight(newsize_y);
-	gui.PopupDialog(wxT("Success"), wxT("Map imported successfully, ") + i2ws(discarded_tiles) + wxT(" tiles were discarded as invalid."), wxOK);
+	map.setWidth(sink.newsize_x);
+	map.setHeight(sink.newsize_y);
+	if(!streamed) {
+		gui.PopupDialog(wxT("Error"), wxT("Error loading map!\n") + loader.getError(), wxOK | wxICON_INFORMATION);
+	} else {
+		gui.PopupDialog(wxT("Success"), wxT("Map imported successfully, ") + i2ws(sink.discarded_tiles) + wxT(" tiles were discarded as invalid."), wxOK);
+	}
  
 	gui.RefreshPalettes();
 	gui.FitViewToMap();
@@ -724,23 +724,113 @@ void Editor::borderizeSelection()
 	addAction(action);
 }
 
-void Editor::borderizeMap(bool showdialog)
+// A leaf of the map tree and the corner of the 4x4 area it covers
+struct MapLeaf
 {
-	if (showdialog) {
-		gui.CreateLoadBar(wxT("Borderizing map..."));
+	QTreeNode* node;
+	int x, y;
+};
+
+// Sorts the leaves into four colours by the parity of their leaf
+// coordinates, two leaves of the same colour are never neighbours
+static size_t ColourLeaves(BaseMap& map, std::vector<MapLeaf> colours[4])
+{
+	std::vector<QTreeNode*> nodes;
+	map.getLeaves(nodes);
+
+	for (QTreeNode* node : nodes) {
+		for (int z = 0; z < MAP_HEIGHT; ++z) {
+			if (Floor* floor = node->getFloor(z)) {
+				const Position position = floor->locs[0].getPosition();
+				colours[((position.x >> 2) & 1) | (((position.y >> 2) & 1) << 1)].push_back({ node, position.x, position.y });
+				break;
+			}
+		}
 	}
+	return nodes.size();
+}
 
-	uint64_t tiles_done = 0;
-	for (TileLocation* tileLocation : map) {
-		if (showdialog && tiles_done % 4096 == 0) {
-			gui.SetLoadDone(static_cast<int32_t>(tiles_done / double(map.tilecount) * 100.0));
+static void BorderizeLeaf(BaseMap& map, const MapLeaf& leaf)
+{
+	// The leaf and its eight neighbours, [x][y]
+	QTreeNode* nodes[3][3];
+	for (int nx = 0; nx < 3; ++nx) {
+		for (int ny = 0; ny < 3; ++ny) {
+			const int x = leaf.x + (nx - 1) * 4;
+			const int y = leaf.y + (ny - 1) * 4;
+			if (x < 0 || y < 0 || x > 0xFFFF || y > 0xFFFF) {
+				nodes[nx][ny] = nullptr;
+			} else {
+				nodes[nx][ny] = map.getLeaf(x, y);
+			}
 		}
+	}
 
-		Tile* tile = tileLocation->get();
-		ASSERT(tile);
+	for (int z = 0; z < MAP_HEIGHT; ++z) {
+		Floor* floor = leaf.node->getFloor(z);
+		if (!floor) {
+			continue;
+		}
 
-		tile->borderize(&map);
-		++tiles_done;
+		// Ground brushes of the leaf and the ring of tiles around it,
+		// looked up once instead of eight tree walks per tile
+		GroundBrush* window[6][6];
+		for (int wx = 0; wx < 6; ++wx) {
+			for (int wy = 0; wy < 6; ++wy) {
+				const int x = leaf.x + wx - 1;
+				const int y = leaf.y + wy - 1;
+
+				Tile* tile = nullptr;
+				if (QTreeNode* node = nodes[(wx + 3) / 4][(wy + 3) / 4]) {
+					if (Floor* other = node->getFloor(z)) {
+						tile = other->locs[(x & 3) * 4 + (y & 3)].get();
+					}
+				}
+				window[wx][wy] = tile ? tile->getGroundBrush() : nullptr;
+			}
+		}
+
+		for (int lx = 0; lx < 4; ++lx) {
+			for (int ly = 0; ly < 4; ++ly) {
+				Tile* tile = floor->locs[lx * 4 + ly].get();
+				if (!tile) {
+					continue;
+				}
+
+				const int wx = lx + 1, wy = ly + 1;
+				GroundBrush* const neighbours[8] = {
+					window[wx - 1][wy - 1], window[wx][wy - 1], window[wx + 1][wy - 1],
+					window[wx - 1][wy],                         window[wx + 1][wy],
+					window[wx - 1][wy + 1], window[wx][wy + 1], window[wx + 1][wy + 1]
+				};
+				GroundBrush::doBorders(tile, neighbours);
+			}
+		}
+	}
+}
+
+void Editor::borderizeMap(bool showdialog)
+{
+	if (showdialog) {
+		gui.CreateLoadBar(wxT("Borderizing map..."));
+	}
+	// The tiles are changed in place, not through actions
+	statistics.invalidate();
+
+	// Borderizing a tile reads its neighbours, so the leaves are done one
+	// colour at a time and no leaf is written while a neighbour reads it
+	std::vector<MapLeaf> colours[4];
+	const size_t leafCount = ColourLeaves(map, colours);
+	const size_t threads = std::max(settings.getInteger(Config::WORKER_THREADS), 1);
+
+	StripeProgress progress(leafCount, showdialog);
+	for (const std::vector<MapLeaf>& leaves : colours) {
+		ParallelStripes(leaves.size(), threads, [&](size_t stripe, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				BorderizeLeaf(map, leaves[i]);
+				progress.advance(stripe);
+			}
+		});
 	}
 
 	if (showdialog) {
@@ -775,44 +865,73 @@ void Editor::randomizeSelection()
 	addAction(action);
 }
 
-void Editor::randomizeMap(bool showdialog)
+// Mixes the seed and a position into a roll, so a tile gets the same
+// ground for the same seed however the map is split between threads
+static uint32_t VariationRoll(uint32_t seed, const Position& position)
+{
+	uint64_t hash = (uint64_t(position.x & 0xFFFF) << 20) | (uint64_t(position.y & 0xFFFF) << 4) | uint64_t(position.z & 0xF);
+	hash ^= uint64_t(seed) * 0x9E3779B97F4A7C15ULL;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	return static_cast<uint32_t>(hash ^ (hash >> 31));
+}
+
+void Editor::randomizeMap(bool showdialog, uint32_t seed)
 {
 	if (showdialog) {
 		gui.CreateLoadBar(wxT("Randomizing map..."));
 	}
+	// The tiles are changed in place, not through actions
+	statistics.invalidate();
+
+	// A tile's new ground doesn't depend on its neighbours, any split works
+	std::vector<QTreeNode*> leaves;
+	map.getLeaves(leaves);
+	const size_t threads = std::max(settings.getInteger(Config::WORKER_THREADS), 1);
+
+	StripeProgress progress(leaves.size(), showdialog);
+	ParallelStripes(leaves.size(), threads, [&](size_t stripe, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaves[i]->getFloor(z);
+				if (!floor) {
+					continue;
+				}
 
-	uint64_t tiles_done = 0;
-	for (TileLocation* tileLocation : map) {
-		if (showdialog && tiles_done % 4096 == 0) {
-			gui.SetLoadDone(static_cast<int32_t>(tiles_done / double(map.tilecount) * 100.0));
-		}
+				for (TileLocation& location : floor->locs) {
+					Tile* tile = location.get();
+					if (!tile) {
+						continue;
+					}
 
-		Tile* tile = tileLocation->get();
-		ASSERT(tile);
+					GroundBrush* groundBrush = tile->getGroundBrush();
+					if (!groundBrush || groundBrush->getTotalChance() <= 0) {
+						continue;
+					}
 
-		GroundBrush* groundBrush = tile->getGroundBrush();
-		if (groundBrush) {
-			Item* oldGround = tile->ground;
+					Item* oldGround = tile->ground;
 
-			uint16_t actionId, uniqueId;
-			if (oldGround) {
-				actionId = oldGround->getActionID();
-				uniqueId = oldGround->getUniqueID();
-			} else {
-				actionId = 0;
-				uniqueId = 0;
-			}
-			groundBrush->draw(&map, tile, nullptr);
+					uint16_t actionId, uniqueId;
+					if (oldGround) {
+						actionId = oldGround->getActionID();
+						uniqueId = oldGround->getUniqueID();
+					} else {
+						actionId = 0;
+						uniqueId = 0;
+					}
+					groundBrush->drawVariation(tile, 1 + VariationRoll(seed, location.getPosition()) % groundBrush->getTotalChance());
 
-			Item* newGround = tile->ground;
-			if (newGround) {
-				newGround->setActionID(actionId);
-				newGround->setUniqueID(uniqueId);
+					Item* newGround = tile->ground;
+					if (newGround) {
+						newGround->setActionID(actionId);
+						newGround->setUniqueID(uniqueId);
+					}
+					tile->update();
+				}
 			}
-			tile->update();
+			progress.advance(stripe);
 		}
-		++tiles_done;
-	}
+	});
 
 	if (showdialog) {
 		gui.DestroyLoadBar();
@@ -901,8 +1020,146 @@ void Editor::clearModifiedTileState(bool showdialog) {
 	}
 }
 
+// True if nothing on the tile is left behind when its selection is moved
+static bool IsWholeTileSelected(const Tile* tile)
+{
+	if(tile->ground && !tile->ground->isSelected())
+		return false;
+	if(tile->creature && !tile->creature->isSelected())
+		return false;
+	if(tile->spawn && !tile->spawn->isSelected())
+		return false;
+
+	for(const Item* item : tile->items)
+	{
+		if(!item->isSelected())
+			return false;
+	}
+	return true;
+}
+
+bool Editor::relinkSelection(const Position& offset)
+{
+	// Live clients send their changes as tiles
+	if(IsLiveClient() || selection.size() == 0)
+		return false;
+
+	const bool merge = settings.getInteger(Config::MERGE_MOVE) != 0;
+	bool doborders = false;
+
+	TileMove* move = newd TileMove;
+	move->offset = Position(0, 0, 0) - offset;
+	move->positions.reserve(selection.size());
+
+	for(Tile* tile : selection)
+	{
+		const Position pos = tile->getPosition();
+		const Position new_pos = pos + move->offset;
+		if(!new_pos.isValid() || !IsWholeTileSelected(tile))
+		{
+			delete move;
+			return false;
+		}
+
+		// Tiles that stay are only replaced, merging needs the copies
+		Tile* dest = map.getTile(new_pos);
+		if(dest && !dest->isSelected() && dest->size() != 0 && (merge || !tile->ground))
+		{
+			delete move;
+			return false;
+		}
+
+		if(tile->ground)
+			doborders = true;
+		move->positions.push_back(pos);
+	}
+
+	BatchAction* batchAction = actionQueue->createBatch(ACTION_MOVE);
+	Action* action = actionQueue->createAction(batchAction);
+	action->addChange(Change::Create(move));
+	batchAction->addAndCommitAction(action);
+
+	if(settings.getInteger(Config::USE_AUTOMAGIC) &&
+			settings.getInteger(Config::BORDERIZE_DRAG) &&
+			selection.size() < size_t(settings.getInteger(Config::BORDERIZE_DRAG_THRESHOLD)))
+	{
+		// Only the tiles around the holes left behind and the moved tiles at
+		// the edge of the selection can need other borders
+		PositionVector perimeter;
+		// Places the move left without a tile, borders may reach into them
+		PositionVector vacated;
+		// The move has turned into its reverse by now
+		for(const Position& pos : move->positions)
+		{
+			const Position old_pos = pos + move->offset;
+			if(doborders && !map.getTile(old_pos))
+				vacated.push_back(old_pos);
+
+			bool edge = false;
+			for(int y = -1; y <= 1; ++y)
+			{
+				for(int x = -1; x <= 1; ++x)
+				{
+					Tile* t = map.getTile(old_pos.x + x, old_pos.y + y, old_pos.z);
+					if(t && !t->isSelected())
+						perimeter.push_back(t->getPosition());
+
+					t = map.getTile(pos.x + x, pos.y + y, pos.z);
+					if(t && !t->isSelected())
+					{
+						perimeter.push_back(t->getPosition());
+						edge = true;
+					}
+				}
+			}
+			if(edge)
+				perimeter.push_back(pos);
+		}
+
+		// Remove duplicates
+		std::sort(perimeter.begin(), perimeter.end());
+		perimeter.erase(std::unique(perimeter.begin(), perimeter.end()), perimeter.end());
+
+		action = actionQueue->createAction(batchAction);
+		for(const Position& pos : perimeter)
+		{
+			Tile* tile = map.getTile(pos);
+			Tile* new_tile = tile->deepCopy(map);
+			if(doborders)
+				new_tile->borderize(&map);
+			new_tile->wallize(&map);
+			new_tile->tableize(&map);
+			new_tile->carpetize(&map);
+			if(tile->ground && tile->ground->isSelected())
+				new_tile->selectGround();
+			action->addChange(newd Change(new_tile));
+		}
+		for(const Position& pos : vacated)
+		{
+			// Like the emptied tiles the copying move leaves behind, but
+			// only kept if a border went into it
+			Tile* new_tile = map.allocator(map.createTileL(pos));
+			new_tile->borderize(&map);
+			if(new_tile->size() == 0)
+			{
+				delete new_tile;
+				continue;
+			}
+			action->addChange(newd Change(new_tile));
+		}
+		batchAction->addAndCommitAction(action);
+	}
+
+	addBatch(batchAction);
+	selection.updateSelectionCount();
+	return true;
+}
+
 void Editor::moveSelection(Position offset)
 {
+	if(relinkSelection(offset))
+		return;
+
 	BatchAction* batchAction = actionQueue->createBatch(ACTION_MOVE); // Our saved action batch, for undo!
 	Action* action;
 
@@ -1418,6 +1675,7 @@ void Editor::drawInternal(const PositionVector& tilestodraw, bool alt, bool dodr
 
 	if(gravel_brush) {
 		// We actually need to do borders, but on the same tiles we draw to
+		NeighbourWindow window(map, tilestodraw);
 		for(PositionVector::const_iterator it = tilestodraw.begin(); it != tilestodraw.end(); ++it) {
 			Position pos = *it;
 			TileLocation* location = map.createTileL(pos);
@@ -1427,18 +1685,18 @@ void Editor::drawInternal(const PositionVector& tilestodraw, bool alt, bool dodr
 				if(dodraw) {
 					Tile* new_tile = tile->deepCopy(map);
 					brush->draw(&map, new_tile);
-					new_tile->borderize(&map);
+					new_tile->borderize(window);
 					action->addChange(newd Change(new_tile));
 				} else if(dodraw == false && tile->hasOptionalBorder()) {
 					Tile* new_tile = tile->deepCopy(map);
 					brush->undraw(&map, new_tile);
-					new_tile->borderize(&map);
+					new_tile->borderize(window);
 					action->addChange(newd Change(new_tile));
 				}
 			} else if(dodraw) {
 				Tile* new_tile = map.allocator(location);
 				brush->draw(&map, new_tile);
-				new_tile->borderize(&map);
+				new_tile->borderize(window);
 				if(new_tile->size() == 0) {
 					delete new_tile;
 					continue;
@@ -1540,6 +1798,8 @@ void Editor::drawInternal(const PositionVector& tilestodraw, PositionVector& til
 		if(settings.getInteger(Config::USE_AUTOMAGIC)) {
 			// Do borders!
 			action = actionQueue->createAction(batch);
+			// Every tile of the ring is looked up once, the map doesn't change until the action is committed
+			NeighbourWindow window(map, tilestoborder);
 			for(PositionVector::const_iterator it = tilestoborder.begin(); it != tilestoborder.end(); ++it) {
 				Position pos = *it;
 				TileLocation* location = map.createTileL(pos);
@@ -1548,11 +1808,11 @@ void Editor::drawInternal(const PositionVector& tilestodraw, PositionVector& til
 				if(tile) {
 					Tile* new_tile = tile->deepCopy(map);
 					if(eraser) {
-						new_tile->wallize(&map);
-						new_tile->tableize(&map);
-						new_tile->carpetize(&map);
+						new_tile->wallize(window);
+						new_tile->tableize(window);
+						new_tile->carpetize(window);
 					}
-					new_tile->borderize(&map);
+					new_tile->borderize(window);
 					action->addChange(newd Change(new_tile));
 				} else {
 					Tile* new_tile = map.allocator(location);
@@ -1562,7 +1822,7 @@ void Editor::drawInternal(const PositionVector& tilestodraw, PositionVector& til
 						//new_tile->tableize(map);
 						//new_tile->carpetize(map);
 					}
-					new_tile->borderize(&map);
+					new_tile->borderize(window);
 					if(new_tile->size() > 0) {
 						action->addChange(newd Change(new_tile));
 					} else {
@@ -1602,19 +1862,20 @@ void Editor::drawInternal(const PositionVector& tilestodraw, PositionVector& til
 
 		// Do borders!
 		action = actionQueue->createAction(batch);
+		NeighbourWindow window(map, tilestoborder);
 		for(PositionVector::const_iterator it = tilestoborder.begin(); it != tilestoborder.end(); ++it) {
 			Position pos = *it;
 			Tile* tile = map.getTile(pos);
 			if(table_brush) {
 				if(tile && tile->hasTable()) {
 					Tile* new_tile = tile->deepCopy(map);
-					new_tile->tableize(&map);
+					new_tile->tableize(window);
 					action->addChange(newd Change(new_tile));
 				}
 			} else if(carpet_brush) {
 				if(tile && tile->hasCarpet()) {
 					Tile* new_tile = tile->deepCopy(map);
-					new_tile->carpetize(&map);
+					new_tile->carpetize(window);
 					action->addChange(newd Change(new_tile));
 				}
 			}
@@ -1688,13 +1949,14 @@ void Editor::drawInternal(const PositionVector& tilestodraw, PositionVector& til
 			if(settings.getInteger(Config::USE_AUTOMAGIC)) {
 				// Do borders!
 				action = actionQueue->createAction(batch);
+				NeighbourWindow window(map, tilestoborder);
 				for(PositionVector::const_iterator it = tilestoborder.begin(); it != tilestoborder.end(); ++it) {
 					Position pos = *it;
 					Tile* tile = map.getTile(pos);
 
 					if(tile) {
 						Tile* new_tile = tile->deepCopy(map);
-						new_tile->wallize(&map);
+						new_tile->wallize(window);
 						//if(*tile == *new_tile) delete new_tile;
 						action->addChange(newd Change(new_tile));
 					}
@@ -1736,13 +1998,14 @@ void Editor::drawInternal(const PositionVector& tilestodraw, PositionVector& til
 		if(settings.getInteger(Config::USE_AUTOMAGIC)) {
 			// Do borders!
 			action = actionQueue->createAction(batch);
+			NeighbourWindow window(map, tilestoborder);
 			for(PositionVector::const_iterator it = tilestoborder.begin(); it != tilestoborder.end(); ++it) {
 				Position pos = *it;
 				Tile* tile = map.getTile(pos);
 
 				if(tile) {
 					Tile* new_tile = tile->deepCopy(map);
-					new_tile->wallize(&map);
+					new_tile->wallize(window);
 					//if(*tile == *new_tile) delete new_tile;
 					action->addChange(newd Change(new_tile));
 				}
@@ -1872,3 +2135,9 @@ void Editor::SendNodeRequests()
 	}
 }
 
+void Editor::UpdateViewport(int start_x, int start_y, int end_x, int end_y, int top_z, int bottom_z)
+{
+	ASSERT(live_client);
+	live_client->updateViewport(start_x, start_y, end_x, end_y, top_z, bottom_z);
+}
+
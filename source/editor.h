@@ -12,12 +12,15 @@
 
 #include "action.h"
 #include "selection.h"
+#include "map_statistics.h"
 
 class BaseMap;
 class CopyBuffer;
 class LiveClient;
 class LiveServer;
 class LiveSocket;
+class Reachability;
+class MapDiff;
 
 class Editor {
 public:
@@ -38,6 +41,12 @@ public:
 	CopyBuffer& copybuffer;
 	GroundBrush* replace_brush;
 	Map map; // The map that is being edited
+	// The last reachability analysis, nullptr until one has been run
+	Reachability* reachability;
+	// The last comparison with another map, nullptr until one has been made
+	MapDiff* diff;
+	// Kept current by the actions, see MapStatistics
+	MapStatistics statistics;
 
 public: // Functions
 	// Live Server handling
@@ -58,6 +67,7 @@ public: // Functions
 	// Client side
 	void QueryNode(int ndx, int ndy, bool underground);
 	void SendNodeRequests();
+	void UpdateViewport(int start_x, int start_y, int end_x, int end_y, int top_z, int bottom_z);
 
 
 	// Map handling
@@ -87,7 +97,8 @@ public: // Functions
 	// action queue is flushed when these functions are called
 	// showdialog is whether a progress bar should be shown
 	void borderizeMap(bool showdialog);
-	void randomizeMap(bool showdialog);
+	// The same seed gives the same grounds, whatever the number of threads
+	void randomizeMap(bool showdialog, uint32_t seed);
 	void clearInvalidHouseTiles(bool showdialog);
 	void clearModifiedTileState(bool showdialog);
 
@@ -101,6 +112,10 @@ public: // Functions
 	void undraw(const PositionVector& todraw, PositionVector& toborder, bool alt);
 
 protected:
+	// Moves the selection by relinking the tiles, when it only holds whole
+	// tiles that can take over their destinations. False if it doesn't.
+	bool relinkSelection(const Position& offset);
+
 	void drawInternal(const Position offset, bool alt, bool dodraw);
 	void drawInternal(const PositionVector& posvec, bool alt, bool dodraw);
 	void drawInternal(const PositionVector& todraw, PositionVector& toborder, bool alt, bool dodraw);
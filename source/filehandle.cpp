@@ -464,11 +464,11 @@ void BinaryNode::load() {
 //=============================================================================
 // node file binary write handle
 
-FileWriteHandle::FileWriteHandle(const std::string& name) {
+FileWriteHandle::FileWriteHandle(const std::string& name, bool append) {
 #if defined __VISUALC__ && defined _UNICODE
-	file = _wfopen(string2wstring(name).c_str(), L"wb");
+	file = _wfopen(string2wstring(name).c_str(), append ? L"ab" : L"wb");
 #else
-	file = fopen(name.c_str(), "wb");
+	file = fopen(name.c_str(), append ? "ab" : "wb");
 #endif
 	if(file == nullptr || ferror(file)) {
 		error_code = FILE_COULD_NOT_OPEN;
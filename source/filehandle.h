@@ -223,9 +223,11 @@ protected:
 class FileWriteHandle : public FileHandle
 {
 public:
-	explicit FileWriteHandle(const std::string& name);
+	explicit FileWriteHandle(const std::string& name, bool append = false);
 	virtual ~FileWriteHandle();
 
+	void flush() {if(file) fflush(file);}
+
 	FORCEINLINE bool addU8(uint8_t u8) {return addType(u8);}
 	FORCEINLINE bool addByte(uint8_t u8) {return addType(u8);}
 	FORCEINLINE bool addU16(uint16_t u16) {return addType(u16);}
@@ -3,6 +3,7 @@
 #include "ground_brush.h"
 #include "items.h"
 #include "basemap.h"
+#include "neighbour_window.h"
 #include "pugicast.h"
 
 uint32_t GroundBrush::border_types[256];
@@ -541,7 +542,14 @@ void GroundBrush::draw(BaseMap* map, Tile* tile, void* parameter)
 			return;
 		}
 	}
-	int chance = random(1, total_chance);
+	drawVariation(tile, random(1, total_chance));
+}
+
+void GroundBrush::drawVariation(Tile* tile, int chance)
+{
+	ASSERT(tile);
+	if(border_items.empty()) return;
+
 	uint16_t id = 0;
 	for(std::vector<ItemChanceBlock>::const_iterator it = border_items.begin(); it != border_items.end(); ++it) {
 		if(chance < it->chance) {
@@ -626,14 +634,27 @@ const GroundBrush::BorderBlock* GroundBrush::getBrushTo(GroundBrush* first, Grou
 
 void GroundBrush::doBorders(BaseMap* map, Tile* tile)
 {
-	static const auto extractGroundBrushFromTile = [](BaseMap* map, uint32_t x, uint32_t y, uint32_t z) -> GroundBrush* {
-		Tile* tile = map->getTile(x, y, z);
-		if (tile) {
-			return tile->getGroundBrush();
-		}
-		return nullptr;
-	};
+	ASSERT(tile);
+	NeighbourWindow window(*map);
+	doBorders(window, tile);
+}
 
+void GroundBrush::doBorders(const NeighbourWindow& window, Tile* tile)
+{
+	ASSERT(tile);
+
+	Tile* tiles[8];
+	window.getNeighbours(tile->getPosition(), tiles);
+
+	GroundBrush* neighbours[8];
+	for (int32_t i = 0; i < 8; ++i) {
+		neighbours[i] = tiles[i] ? tiles[i]->getGroundBrush() : nullptr;
+	}
+	doBorders(tile, neighbours);
+}
+
+void GroundBrush::doBorders(Tile* tile, GroundBrush* const neighbourBrushes[8])
+{
 	ASSERT(tile);
 
 	GroundBrush* borderBrush;
@@ -643,56 +664,14 @@ void GroundBrush::doBorders(BaseMap* map, Tile* tile)
 		borderBrush = nullptr;
 	}
 
-	const Position& position = tile->getPosition();
-
-	uint32_t x = position.x;
-	uint32_t y = position.y;
-	uint32_t z = position.z;
-
 	// Pair of visited / what border type
 	std::pair<bool, GroundBrush*> neighbours[8];
-	if (x == 0) {
-		if (y == 0) {
-			neighbours[0] = { false, nullptr };
-			neighbours[1] = { false, nullptr };
-			neighbours[2] = { false, nullptr };
-			neighbours[3] = { false, nullptr };
-			neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y,     z) };
-			neighbours[5] = { false, nullptr };
-			neighbours[6] = { false, extractGroundBrushFromTile(map, x,     y + 1, z) };
-			neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
-		} else {
-			neighbours[0] = { false, nullptr };
-			neighbours[1] = { false, extractGroundBrushFromTile(map, x,     y - 1, z) };
-			neighbours[2] = { false, extractGroundBrushFromTile(map, x + 1, y - 1, z) };
-			neighbours[3] = { false, nullptr };
-			neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y,     z) };
-			neighbours[5] = { false, nullptr };
-			neighbours[6] = { false, extractGroundBrushFromTile(map, x,     y + 1, z) };
-			neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
-		}
-	} else if (y == 0) {
-		neighbours[0] = { false, nullptr };
-		neighbours[1] = { false, nullptr };
-		neighbours[2] = { false, nullptr };
-		neighbours[3] = { false, extractGroundBrushFromTile(map, x - 1, y,     z) };
-		neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y,     z) };
-		neighbours[5] = { false, extractGroundBrushFromTile(map, x - 1, y + 1, z) };
-		neighbours[6] = { false, extractGroundBrushFromTile(map, x,     y + 1, z) };
-		neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
-	} else {
-		neighbours[0] = { false, extractGroundBrushFromTile(map, x - 1, y - 1, z) };
-		neighbours[1] = { false, extractGroundBrushFromTile(map, x,     y - 1, z) };
-		neighbours[2] = { false, extractGroundBrushFromTile(map, x + 1, y - 1, z) };
-		neighbours[3] = { false, extractGroundBrushFromTile(map, x - 1, y,     z) };
-		neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y,     z) };
-		neighbours[5] = { false, extractGroundBrushFromTile(map, x - 1, y + 1, z) };
-		neighbours[6] = { false, extractGroundBrushFromTile(map, x,     y + 1, z) };
-		neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
+	for (int32_t i = 0; i < 8; ++i) {
+		neighbours[i] = { false, neighbourBrushes[i] };
 	}
 
-	static std::vector<const BorderBlock*> specificList;
-	specificList.clear();
+	// Not static, borders may be computed on several threads at once
+	std::vector<const BorderBlock*> specificList;
 
 	std::vector<BorderCluster> borderList;
 	for(int32_t i = 0; i < 8; ++i) {
@@ -18,7 +18,15 @@ public:
 
 	virtual void draw(BaseMap* map, Tile* tile, void* parameter);
 	virtual void undraw(BaseMap* map, Tile* tile);
+	// Places the ground variation that chance (1 to getTotalChance()) falls on
+	void drawVariation(Tile* tile, int chance);
+	int getTotalChance() const {return total_chance;}
+
 	static void doBorders(BaseMap* map, Tile* tile);
+	static void doBorders(const NeighbourWindow& window, Tile* tile);
+	// Same, with the brushes of the eight neighbours already looked up
+	// (north-west, north, north-east, west, east, south-west, south, south-east)
+	static void doBorders(Tile* tile, GroundBrush* const neighbours[8]);
 	static const BorderBlock* getBrushTo(GroundBrush* first, GroundBrush* second);
 
 	virtual int32_t getZ() const {return z_order;}
@@ -27,6 +27,9 @@
 #include "live_tab.h"
 #include "live_server.h"
 
+#include <atomic>
+#include <functional>
+
 #ifdef __WXOSX__
 #include <AGL/agl.h>
 #endif
@@ -75,7 +78,8 @@ GUI::GUI() :
 	use_custom_thickness(false),
 	custom_thickness_mod(0.0),
 	progressBar(nullptr),
-	disabled_counter(0)
+	disabled_counter(0),
+	headless(false)
 {
 	doodad_buffer_map = newd BaseMap();
 }
@@ -360,44 +364,91 @@ bool GUI::LoadDataFiles(wxString& error, wxArrayString& warnings)
 	}
 	
 	FileName spr_path = wxString(client_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("Tibia.spr"));
+	FileName otb_path = wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("items.otb"));
+	FileName items_xml_path = wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("items.xml"));
+	FileName items_cache_path = getLoadedVersion()->getLocalDataPath();
+	items_cache_path.SetFullName(wxT("items.cache"));
+	FileName creatures_path = wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("creatures.xml"));
+	FileName user_creatures_path = getLoadedVersion()->getLocalDataPath();
+	user_creatures_path.SetFullName(wxT("creatures.xml"));
+
+	// Everything below only needs Tibia.dat, and each step writes to
+	// something none of the others touch: the sprites get their pixels,
+	// the items look up their sprites and the creatures their outfits.
+	// Each runs on its own thread with its own error and warnings.
+	struct LoadStep
+	{
+		LoadStep() : ok(true) {}
+
+		bool ok;
+		wxString error;
+		wxArrayString warnings;
+	};
+	LoadStep sprites, items, creatures;
+
+	std::vector<std::function<void()> > steps;
+	steps.push_back([&]() {
+		sprites.ok = gui.gfx.loadSpriteData(spr_path.GetFullPath(), sprites.error, sprites.warnings);
+	});
+	steps.push_back([&]() {
+		// The item files are only parsed when they changed since the cache was written
+		const uint64_t items_cache_key = ItemDatabase::CacheKey(otb_path, items_xml_path);
+		if(item_db.loadFromCache(items_cache_path, items_cache_key))
+			return;
 
-	gui.SetLoadDone(10, wxT("Loading Tibia.spr ..."));
-	if(!gui.gfx.loadSpriteData(spr_path.GetFullPath(), error, warnings))
-	{
-		error = wxT("Couldn't load tibia.spr: ") + error;
-		gui.DestroyLoadBar();
-		UnloadVersion();
-		return false;
-	}
+		items.ok = item_db.loadFromOtb(otb_path, items.error, items.warnings);
+		if(!items.ok)
+			return;
 
-	gui.SetLoadDone(20, wxT("Loading items.otb ..."));
-	if(!item_db.loadFromOtb(wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("items.otb")), error, warnings))
-	{
-		error = wxT("Couldn't load items.otb: ") + error;
-		gui.DestroyLoadBar();
-		UnloadVersion();
-		return false;
-	}
+		wxString xml_error;
+		if(item_db.loadFromGameXml(items_xml_path, xml_error, items.warnings))
+			item_db.saveToCache(items_cache_path, items_cache_key);
+		else
+			items.warnings.push_back(wxT("Couldn't load items.xml: ") + xml_error);
+	});
+	steps.push_back([&]() {
+		if(!creature_db.loadFromXML(creatures_path, true, creatures.error, creatures.warnings))
+			creatures.warnings.push_back(wxT("Couldn't load creatures.xml: ") + creatures.error);
 
-	gui.SetLoadDone(30, wxT("Loading items.xml ..."));
-	if(!item_db.loadFromGameXml(wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("items.xml")), error, warnings))
-	{
-		warnings.push_back(wxT("Couldn't load items.xml: ") + error);
-	}
+		wxString nerr;
+		wxArrayString nwarn;
+		creature_db.loadFromXML(user_creatures_path, false, nerr, nwarn);
+	});
+
+	gui.SetLoadDone(10, wxT("Loading Tibia.spr, items and creatures ..."));
+	std::atomic<size_t> steps_done(0);
+	const size_t threads = settings.getInteger(Config::WORKER_THREADS) > 1 ? steps.size() + 1 : 1;
+	ParallelStripes(steps.size() + 1, threads, [&](size_t stripe, size_t begin, size_t end) {
+		for(size_t i = std::max<size_t>(begin, 1); i < end; ++i)
+		{
+			steps[i - 1]();
+			++steps_done;
+		}
+
+		// Stripe 0 runs on the calling thread, it keeps the load bar going
+		// while the others work, with a single thread it has done them all
+		if(stripe == 0)
+		{
+			while(steps_done < steps.size())
+			{
+				gui.SetLoadDone(10 + static_cast<int32_t>(40 * steps_done / steps.size()));
+				wxMilliSleep(20);
+			}
+		}
+	});
 
-	gui.SetLoadDone(45, wxT("Loading creatures.xml ..."));
-	if(!creature_db.loadFromXML(wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + wxT("creatures.xml")), true, error, warnings))
+	for(const LoadStep* step : {&sprites, &items, &creatures})
 	{
-		warnings.push_back(wxT("Couldn't load creatures.xml: ") + error);
+		for(const wxString& warning : step->warnings)
+			warnings.push_back(warning);
 	}
 
-	gui.SetLoadDone(45, wxT("Loading user creatures.xml ..."));
+	if(!sprites.ok || !items.ok)
 	{
-		FileName cdb = getLoadedVersion()->getLocalDataPath();
-		cdb.SetFullName(wxT("creatures.xml"));
-		wxString nerr;
-		wxArrayString nwarn;
-		creature_db.loadFromXML(cdb, false, nerr, nwarn);
+		error = sprites.ok ? wxT("Couldn't load items.otb: ") + items.error : wxT("Couldn't load tibia.spr: ") + sprites.error;
+		gui.DestroyLoadBar();
+		UnloadVersion();
+		return false;
 	}
 
 	gui.SetLoadDone(50, wxT("Loading materials.xml ..."));
@@ -569,16 +620,22 @@ Editor* GUI::GetCurrentEditor()
 }
 
 EditorTab* GUI::GetTab(int idx) {
+	if(!tabbook)
+		return nullptr;
 	return tabbook->GetTab(idx);
 }
 
 int GUI::GetTabCount() const {
+	if(!tabbook)
+		return 0;
 	return tabbook->GetTabCount();
 }
 
 
 EditorTab* GUI::GetCurrentTab()
 {
+	if(!tabbook)
+		return nullptr;
 	return tabbook->GetCurrentTab();
 }
 
@@ -674,6 +731,9 @@ bool GUI::CloseLiveEditors(LiveSocket* sock)
 
 bool GUI::CloseAllEditors()
 {
+	if(!tabbook)
+		return true;
+
 	for(int i = 0; i < tabbook->GetTabCount(); ++i)
 	{
 		MapTab* mt = dynamic_cast<MapTab*>(tabbook->GetTab(i));
@@ -721,6 +781,9 @@ void GUI::NewMapView()
 
 void GUI::LoadPerspective()
 {
+	if(IsHeadless())
+		return;
+
 	if (!IsVersionLoaded()) {
 		if (settings.getInteger(Config::WINDOW_MAXIMIZED)) {
 			root->Maximize();
@@ -812,6 +875,9 @@ void GUI::LoadPerspective()
 
 void GUI::SavePerspective()
 {
+	if(IsHeadless())
+		return;
+
 	settings.setInteger(Config::WINDOW_MAXIMIZED, root->IsMaximized());
 	settings.setInteger(Config::WINDOW_WIDTH, root->GetSize().GetWidth());
 	settings.setInteger(Config::WINDOW_HEIGHT, root->GetSize().GetHeight());
@@ -932,7 +998,8 @@ void GUI::DestroyPalettes()
 		palette = nullptr;
 	}
 	palettes.clear();
-	aui_manager->Update();
+	if(aui_manager)
+		aui_manager->Update();
 }
 
 void GUI::RebuildPalettes()
@@ -1053,6 +1120,10 @@ bool GUI::IsMinimapVisible() const
 
 void GUI::RefreshView()
 {
+	if (!tabbook) {
+		return;
+	}
+
 	EditorTab* editorTab = GetCurrentTab();
 	if (!editorTab) {
 		return;
@@ -1084,6 +1155,12 @@ void GUI::CreateLoadBar(wxString message, bool canCancel /* = false */ )
 	progressTo = 100;
 	currentProgress = -1;
 
+	if(IsHeadless())
+	{
+		std::cout << nstr(progressText) << std::endl;
+		return;
+	}
+
 	progressBar = newd wxGenericProgressDialog(wxT("Loading"), progressText + wxT(" (0%)"), 100, root,
 		wxPD_APP_MODAL | wxPD_SMOOTH | (canCancel ? wxPD_CAN_ABORT : 0)
 	);
@@ -1121,16 +1198,21 @@ bool GUI::SetLoadDone(int32_t done, const wxString& newMessage)
 	int32_t newProgress = progressFrom + static_cast<int32_t>((done / 100.f) * (progressTo - progressFrom));
 	newProgress = std::max<int32_t>(0, std::min<int32_t>(100, newProgress));
 	
-	bool skip = false;
+	// Update() is false once a bar created with canCancel was aborted
+	bool keepGoing = true;
 	if (progressBar) {
-		progressBar->Update(
+		keepGoing = progressBar->Update(
 			newProgress,
-			wxString::Format(wxT("%s (%d%%)"), progressText, newProgress),
-			&skip
+			wxString::Format(wxT("%s (%d%%)"), progressText, newProgress)
 		);
 		currentProgress = newProgress;
 	}
 
+	if (!tabbook) {
+		currentProgress = newProgress;
+		return keepGoing;
+	}
+
 	for (int32_t index = 0; index < tabbook->GetTabCount(); ++index) {
 		MapTab* mapTab = dynamic_cast<MapTab*>(tabbook->GetTab(index));
 		if (mapTab && mapTab->GetEditor()) {
@@ -1141,7 +1223,7 @@ bool GUI::SetLoadDone(int32_t done, const wxString& newMessage)
 		}
 	}
 
-	return skip;
+	return keepGoing;
 }
 
 void GUI::DestroyLoadBar()
@@ -1183,6 +1265,7 @@ void GUI::StartPasting()
 {
 	if(GetCurrentEditor())
 	{
+		copybuffer.fetchClipboard();
 		pasting = true;
 		secondary_map = &copybuffer.getBufferMap();
 	}
@@ -1220,6 +1303,9 @@ void GUI::ChangeFloor(int new_floor)
 
 void GUI::SetStatusText(wxString text)
 {
+	if(gui.root == nullptr)
+		return;
+
 	gui.root->SetStatusText(text, 0);
 }
 
@@ -1264,6 +1350,9 @@ void GUI::SetTitle(wxString title)
 
 void GUI::UpdateTitle()
 {
+	if(!tabbook)
+		return;
+
 	if(tabbook->GetTabCount() > 0)
 	{
 		SetTitle(tabbook->GetCurrentTab()->GetTitle());
@@ -1281,6 +1370,9 @@ void GUI::UpdateTitle()
 
 void GUI::UpdateMenus()
 {
+	if(gui.root == nullptr)
+		return;
+
 	wxCommandEvent evt(EVT_UPDATE_MENUS);
 	gui.root->AddPendingEvent(evt);
 }
@@ -1778,6 +1870,13 @@ long GUI::PopupDialog(wxWindow* parent, wxString title, wxString text, long styl
 	if(text.empty())
 		return wxID_ANY;
 
+	if(IsHeadless())
+	{
+		// Nobody to answer, log it and take the default choice
+		std::cout << nstr(title) << ": " << nstr(text) << std::endl;
+		return (style & wxYES_NO) ? wxID_YES : wxID_OK;
+	}
+
 	wxMessageDialog dlg(parent, text, title, style);
 	return dlg.ShowModal();
 }
@@ -1792,6 +1891,14 @@ void GUI::ListDialog(wxWindow* parent, wxString title, const wxArrayString& para
 	if(param_items.empty())
 		return;
 
+	if(IsHeadless())
+	{
+		std::cout << nstr(title) << ":" << std::endl;
+		for(size_t i = 0; i != param_items.GetCount(); ++i)
+			std::cout << "\t" << nstr(param_items[i]) << std::endl;
+		return;
+	}
+
 	wxArrayString list_items(param_items);
 
 	// Create the window
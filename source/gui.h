@@ -153,6 +153,13 @@ public:
 
 	bool IsRenderingEnabled() const {return disabled_counter == 0;}
 
+	/**
+	 * Headless mode runs the editor from the command line without a main
+	 * window, dialogs and the loading bar are written to stdout instead.
+	 */
+	void SetHeadless(bool value) {headless = value;}
+	bool IsHeadless() const {return headless;}
+
 	void EnableHotkeys();
 	void DisableHotkeys();
 	bool AreHotkeysEnabled() const;
@@ -411,6 +418,7 @@ protected:
 
 	wxWindowDisabler* winDisabler;
 	int disabled_counter;
+	bool headless;
 
 	friend class RenderingLock;
 	friend MapTab::MapTab(MapTabbook*, Editor*);
@@ -0,0 +1,481 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "headless.h"
+#include "gui.h"
+#include "settings.h"
+#include "editor.h"
+#include "live_server.h"
+#include "live_loadtest.h"
+#include "live_journal.h"
+#include "map_diff.h"
+#include "map_validator.h"
+#include "item_replacer.h"
+
+#include <csignal>
+
+#ifdef __WINDOWS__
+#  include <wx/msw/wrapwin.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void OnStopSignal(int)
+{
+	stop_requested = 1;
+}
+
+// Seconds of CPU time the whole process used so far, all threads included
+static double GetProcessCpuTime()
+{
+#ifdef __WINDOWS__
+	FILETIME creation, exit, kernel, user;
+	if(!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+
+	ULARGE_INTEGER kernelTime, userTime;
+	kernelTime.LowPart = kernel.dwLowDateTime;
+	kernelTime.HighPart = kernel.dwHighDateTime;
+	userTime.LowPart = user.dwLowDateTime;
+	userTime.HighPart = user.dwHighDateTime;
+	return (kernelTime.QuadPart + userTime.QuadPart) / 10000000.0;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#endif
+}
+
+Headless::Headless(const wxArrayString& arguments) :
+	arguments(arguments),
+	editor(nullptr),
+	timer(this),
+	statsInterval(0),
+	lastCpuTime(0.0),
+	lastWallTime(0)
+{
+	Bind(wxEVT_TIMER, &Headless::OnTimer, this);
+}
+
+Headless::~Headless()
+{
+	timer.Stop();
+	delete editor;
+}
+
+bool Headless::IsHeadlessCommand(const wxArrayString& arguments)
+{
+	if(arguments.IsEmpty())
+		return false;
+
+	return arguments[0] == wxT("--live-server") || arguments[0] == wxT("--live-loadtest") || arguments[0] == wxT("--live-replay") ||
+		arguments[0] == wxT("--statistics") || arguments[0] == wxT("--diff") || arguments[0] == wxT("--patch") ||
+		arguments[0] == wxT("--validate") || arguments[0] == wxT("--replace");
+}
+
+int Headless::Run()
+{
+	if(arguments[0] == wxT("--live-server"))
+		return RunLiveServer();
+	else if(arguments[0] == wxT("--live-loadtest"))
+		return RunLiveLoadTest();
+	else if(arguments[0] == wxT("--live-replay"))
+		return RunLiveReplay();
+	else if(arguments[0] == wxT("--statistics"))
+		return RunStatistics();
+	else if(arguments[0] == wxT("--diff"))
+		return RunDiff();
+	else if(arguments[0] == wxT("--patch"))
+		return RunPatch();
+	else if(arguments[0] == wxT("--validate"))
+		return RunValidate();
+	else if(arguments[0] == wxT("--replace"))
+		return RunReplace();
+	return 1;
+}
+
+wxString Headless::GetOption(const wxString& name, const wxString& defaultValue) const
+{
+	for(size_t i = 1; i + 1 < arguments.GetCount(); ++i)
+	{
+		if(arguments[i] == name)
+			return arguments[i + 1];
+	}
+	return defaultValue;
+}
+
+long Headless::GetNumber(const wxString& name, long defaultValue) const
+{
+	long value;
+	if(GetOption(name).ToLong(&value))
+		return value;
+	return defaultValue;
+}
+
+bool Headless::LoadMap(const FileName& filename)
+{
+	try
+	{
+		editor = newd Editor(gui.copybuffer, filename);
+	}
+	catch(std::runtime_error& e)
+	{
+		std::cout << e.what() << std::endl;
+		return false;
+	}
+
+	if(!gui.IsVersionLoaded())
+	{
+		std::cout << "Could not load the client data for " << nstr(filename.GetFullName()) << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int Headless::RunLiveServer()
+{
+	if(arguments.GetCount() < 2 || arguments[1].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --live-server <map.otbm> [--port N] [--password P] [--name S] [--stats seconds] [--journal file]" << std::endl;
+		return 1;
+	}
+
+	FileName filename(arguments[1]);
+	if(!LoadMap(filename))
+		return 1;
+
+	LiveServer* server = editor->StartLiveServer();
+	if(!server->setName(GetOption(wxT("--name"), wxT("RME Live Server"))) ||
+		!server->setPassword(GetOption(wxT("--password"))) ||
+		!server->setPort(GetNumber(wxT("--port"), 31313)))
+	{
+		std::cout << nstr(server->getLastError()) << std::endl;
+		return 1;
+	}
+
+	wxString journal = GetOption(wxT("--journal"));
+	if(!journal.IsEmpty())
+	{
+		if(!server->startJournal(nstr(journal)))
+		{
+			std::cout << nstr(journal) << ": " << nstr(server->getLastError()) << std::endl;
+			return 1;
+		}
+		std::cout << "Recording changes to " << nstr(journal) << "." << std::endl;
+	}
+
+	try
+	{
+		if(!server->bind())
+		{
+			std::cout << nstr(server->getLastError()) << std::endl;
+			return 1;
+		}
+	}
+	catch(std::exception& e)
+	{
+		std::cout << "Could not listen on port " << server->getPort() << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "Hosting " << editor->map.getName() << " on " << server->getHostName() << ", press Ctrl+C to stop." << std::endl;
+
+	std::signal(SIGINT, OnStopSignal);
+	std::signal(SIGTERM, OnStopSignal);
+
+	statsInterval = GetNumber(wxT("--stats"), 10);
+	lastCpuTime = GetProcessCpuTime();
+	lastWallTime = wxGetLocalTimeMillis();
+	timer.Start(250);
+
+	// Packets are parsed on the main thread, keep its event loop running
+	wxTheApp->MainLoop();
+	timer.Stop();
+
+	std::cout << "Shutting down..." << std::endl;
+	if(editor->map.hasChanged())
+	{
+		std::cout << "Saving " << nstr(filename.GetFullPath()) << "..." << std::endl;
+		editor->saveMap(FileName(), false);
+	}
+	return 0;
+}
+
+int Headless::RunLiveLoadTest()
+{
+	if(arguments.GetCount() < 2 || arguments[1].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --live-loadtest <host> [--port N] [--password P] [--clients N] [--duration seconds]" << std::endl;
+		std::cout << "       [--stroke-item id] [--stroke-interval ms] [--pan-interval ms]" << std::endl;
+		std::cout << "The simulated clients paint on the map, run it against a copy." << std::endl;
+		return 1;
+	}
+
+	LiveLoadTestOptions options;
+	options.host = nstr(arguments[1]);
+	options.port = GetNumber(wxT("--port"), options.port);
+	options.password = nstr(GetOption(wxT("--password")));
+	options.clients = std::max<long>(1, GetNumber(wxT("--clients"), options.clients));
+	options.duration = std::max<long>(1, GetNumber(wxT("--duration"), options.duration));
+	options.strokeItem = GetNumber(wxT("--stroke-item"), options.strokeItem);
+	options.strokeInterval = std::max<long>(1, GetNumber(wxT("--stroke-interval"), options.strokeInterval));
+	options.panInterval = std::max<long>(1, GetNumber(wxT("--pan-interval"), options.panInterval));
+
+	LiveLoadTest test(options);
+	bool joined = test.run();
+	test.printReport(std::cout);
+	return joined ? 0 : 1;
+}
+
+int Headless::RunLiveReplay()
+{
+	if(arguments.GetCount() < 3 || arguments[1].StartsWith(wxT("--")) || arguments[2].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --live-replay <map.otbm> <journal> [--output map.otbm]" << std::endl;
+		std::cout << "Replay on top of the map the journal was started with, which is the last saved one." << std::endl;
+		return 1;
+	}
+
+	if(!LoadMap(FileName(arguments[1])))
+		return 1;
+
+	LiveJournalReplay result;
+	wxString error;
+	if(!LiveJournal::replay(nstr(arguments[2]), *editor, result, error))
+	{
+		std::cout << nstr(arguments[2]) << ": " << nstr(error) << std::endl;
+		return 1;
+	}
+
+	std::cout << "Replayed " << result.records << " records, " << result.tiles << " tiles in "
+		<< std::fixed << std::setprecision(3) << result.seconds << " s";
+	if(result.seconds > 0)
+		std::cout << " (" << std::setprecision(0) << result.tiles / result.seconds << " tiles/s)";
+	std::cout << "." << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+
+	if(result.truncated)
+		std::cout << "The last record is incomplete and was skipped." << std::endl;
+
+	wxString output = GetOption(wxT("--output"));
+	if(!output.IsEmpty())
+	{
+		std::cout << "Saving " << nstr(output) << "..." << std::endl;
+		editor->saveMap(FileName(output), false);
+	}
+	return 0;
+}
+
+int Headless::RunStatistics()
+{
+	if(arguments.GetCount() < 2 || arguments[1].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --statistics <map.otbm> [--format text|json|csv] [--output file]" << std::endl;
+		return 1;
+	}
+
+	MapStatistics::Format format;
+	wxString formatName = GetOption(wxT("--format"), wxT("text"));
+	if(formatName == wxT("text"))
+		format = MapStatistics::FORMAT_TEXT;
+	else if(formatName == wxT("json"))
+		format = MapStatistics::FORMAT_JSON;
+	else if(formatName == wxT("csv"))
+		format = MapStatistics::FORMAT_CSV;
+	else
+	{
+		std::cout << "Unknown format " << nstr(formatName) << ", use text, json or csv." << std::endl;
+		return 1;
+	}
+
+	if(!LoadMap(FileName(arguments[1])))
+		return 1;
+
+	MapStatistics& statistics = editor->statistics;
+	statistics.get(editor->map, std::max(settings.getInteger(Config::WORKER_THREADS), 1), false);
+
+	wxString output = GetOption(wxT("--output"));
+	if(output.IsEmpty())
+	{
+		std::cout << statistics.getReport(editor->map, format);
+		return 0;
+	}
+
+	if(!statistics.saveReport(editor->map, format, nstr(output)))
+	{
+		std::cout << "Could not write " << nstr(output) << "." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int Headless::RunDiff()
+{
+	wxString output = GetOption(wxT("--output"));
+	if(arguments.GetCount() < 3 || arguments[1].StartsWith(wxT("--")) || arguments[2].StartsWith(wxT("--")) || output.IsEmpty())
+	{
+		std::cout << "Usage: rme --diff <old.otbm> <new.otbm> --output patch" << std::endl;
+		return 1;
+	}
+
+	// Only the old map is loaded, the new one is compared as it is read
+	if(!LoadMap(FileName(arguments[1])))
+		return 1;
+
+	MapDiff diff;
+	wxString error;
+	if(!diff.compareFile(editor->map, nstr(arguments[2]), false, error))
+	{
+		std::cout << nstr(arguments[2]) << ": " << nstr(error) << std::endl;
+		return 1;
+	}
+
+	std::cout << diff.getChanges().size() << " tiles in " << diff.getChangedLeafCount() << " of "
+		<< diff.getLeafCount() << " areas differ." << std::endl;
+
+	if(!diff.savePatch(nstr(output)))
+	{
+		std::cout << "Could not write " << nstr(output) << "." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int Headless::RunPatch()
+{
+	if(arguments.GetCount() < 3 || arguments[1].StartsWith(wxT("--")) || arguments[2].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --patch <map.otbm> <patch> [--output map.otbm]" << std::endl;
+		return 1;
+	}
+
+	if(!LoadMap(FileName(arguments[1])))
+		return 1;
+
+	size_t applied = 0;
+	wxString error;
+	bool ok = MapDiff::ApplyPatch(nstr(arguments[2]), *editor, applied, error);
+	if(!ok)
+		std::cout << nstr(error) << std::endl;
+	std::cout << "Replaced " << applied << " tiles." << std::endl;
+
+	wxString output = GetOption(wxT("--output"));
+	if(ok && !output.IsEmpty())
+	{
+		std::cout << "Saving " << nstr(output) << "..." << std::endl;
+		editor->saveMap(FileName(output), false);
+	}
+	return ok ? 0 : 1;
+}
+
+int Headless::RunValidate()
+{
+	if(arguments.GetCount() < 2 || arguments[1].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --validate <map.otbm> [--rules name,name]" << std::endl;
+		return 1;
+	}
+
+	MapValidator validator;
+	wxString ruleNames = GetOption(wxT("--rules"));
+	if(!ruleNames.IsEmpty())
+	{
+		std::vector<std::string> names;
+		std::istringstream list(nstr(ruleNames));
+		std::string name;
+		while(std::getline(list, name, ','))
+		{
+			if(!name.empty())
+				names.push_back(name);
+		}
+
+		if(!validator.selectRules(names))
+		{
+			std::cout << "Unknown rule, the rules are:" << std::endl;
+			for(const MapValidator::Rule* rule : validator.getRules())
+				std::cout << "  " << rule->getName() << " - " << rule->getDescription() << std::endl;
+			return 1;
+		}
+	}
+
+	if(!LoadMap(FileName(arguments[1])))
+		return 1;
+
+	std::vector<MapValidator::Problem> problems = validator.validate(editor->map, std::max(settings.getInteger(Config::WORKER_THREADS), 1), false);
+	for(const MapValidator::Problem& problem : problems)
+	{
+		std::cout << problem.position.x << ":" << problem.position.y << ":" << problem.position.z << " "
+			<< problem.rule << ": " << problem.description << std::endl;
+	}
+
+	std::cout << problems.size() << " problems found." << std::endl;
+	return problems.empty() ? 0 : 2;
+}
+
+int Headless::RunReplace()
+{
+	if(arguments.GetCount() < 3 || arguments[1].StartsWith(wxT("--")) || arguments[2].StartsWith(wxT("--")))
+	{
+		std::cout << "Usage: rme --replace <map.otbm> <rules> [--output map.otbm]" << std::endl;
+		return 1;
+	}
+
+	// The rules name item ids, which are only known once the map's client data is loaded
+	if(!LoadMap(FileName(arguments[1])))
+		return 1;
+
+	ItemReplacer replacer;
+	wxString error;
+	if(!replacer.loadRules(nstr(arguments[2]), error))
+	{
+		std::cout << nstr(error) << std::endl;
+		return 1;
+	}
+
+	size_t replaced = replacer.apply(*editor, std::max(settings.getInteger(Config::WORKER_THREADS), 1), false);
+	std::cout << "Replaced " << replaced << " items by " << replacer.getRuleCount() << " rules." << std::endl;
+
+	wxString output = GetOption(wxT("--output"));
+	if(!output.IsEmpty())
+	{
+		std::cout << "Saving " << nstr(output) << "..." << std::endl;
+		editor->saveMap(FileName(output), false);
+	}
+	return 0;
+}
+
+void Headless::OnTimer(wxTimerEvent& WXUNUSED(event))
+{
+	if(stop_requested)
+	{
+		timer.Stop();
+		wxTheApp->ExitMainLoop();
+		return;
+	}
+
+	if(statsInterval <= 0 || !editor || !editor->IsLiveServer())
+		return;
+
+	wxLongLong wallTime = wxGetLocalTimeMillis();
+	double elapsed = (wallTime - lastWallTime).ToDouble() / 1000.0;
+	if(elapsed < statsInterval)
+		return;
+
+	// 100% is one core fully busy
+	double cpuTime = GetProcessCpuTime();
+	double usage = (cpuTime - lastCpuTime) / elapsed * 100.0;
+	lastCpuTime = cpuTime;
+	lastWallTime = wallTime;
+
+	std::cout << "Clients: " << editor->GetLiveServer()->getClientCount()
+		<< ", CPU: " << std::fixed << std::setprecision(1) << usage << "%" << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_HEADLESS_H_
+#define RME_HEADLESS_H_
+
+class Editor;
+
+/**
+ * Runs the editor from the command line without opening the main window.
+ *
+ *   rme --live-server <map.otbm> [--port N] [--password P] [--name S] [--stats seconds] [--journal file]
+ *       Hosts a live session until interrupted, the map is saved on exit if it changed.
+ *       With a journal every change is recorded until the map is saved.
+ *
+ *   rme --live-loadtest <host> [--port N] [--password P] [--clients N] [--duration seconds]
+ *       [--stroke-item id] [--pan-interval ms] [--stroke-interval ms]
+ *       Connects simulated clients to a live server and reports latency and bandwidth.
+ *
+ *   rme --live-replay <map.otbm> <journal> [--output map.otbm]
+ *       Applies a journal to the map and reports how fast the tiles were applied,
+ *       with an output file the result is saved there to recover a crashed session.
+ *
+ *   rme --statistics <map.otbm> [--format text|json|csv] [--output file]
+ *       Counts what is on the map and prints the report, or writes it to the output file.
+ *
+ *   rme --diff <old.otbm> <new.otbm> --output patch
+ *       Writes the tiles of the new map that differ from the old one as a patch.
+ *
+ *   rme --patch <map.otbm> <patch> [--output map.otbm]
+ *       Applies a patch to the map, with an output file the result is saved there.
+ *
+ *   rme --validate <map.otbm> [--rules name,name]
+ *       Checks the map against all rules, or the listed ones, and prints every problem.
+ *       Exits with 2 if there were any, for use in continuous integration.
+ *
+ *   rme --replace <map.otbm> <rules> [--output map.otbm]
+ *       Replaces items by a table of rules, see ItemReplacer::loadRules, with an output
+ *       file the result is saved there.
+ */
+class Headless : public wxEvtHandler
+{
+public:
+	Headless(const wxArrayString& arguments);
+	~Headless();
+
+	// Returns true if the arguments ask for one of the modes above
+	static bool IsHeadlessCommand(const wxArrayString& arguments);
+
+	// Runs the requested mode to completion, returns the process exit code
+	int Run();
+
+protected:
+	int RunLiveServer();
+	int RunLiveLoadTest();
+	int RunLiveReplay();
+	int RunStatistics();
+	int RunDiff();
+	int RunPatch();
+	int RunValidate();
+	int RunReplace();
+
+	bool LoadMap(const FileName& filename);
+
+	wxString GetOption(const wxString& name, const wxString& defaultValue = wxEmptyString) const;
+	long GetNumber(const wxString& name, long defaultValue) const;
+
+	// Watches for Ctrl+C and prints the server statistics
+	void OnTimer(wxTimerEvent& event);
+
+	wxArrayString arguments;
+	Editor* editor;
+
+	wxTimer timer;
+	long statsInterval;
+	double lastCpuTime;
+	wxLongLong lastWallTime;
+};
+
+#endif
@@ -86,6 +86,9 @@ House::House(Map& map) :
 	townid(0),
 	guildhall(false),
 	map(&map),
+	sqm(0),
+	doors(0),
+	bounds_dirty(false),
 	exit(0,0,0)
 {
 }
@@ -97,11 +100,11 @@ House::~House()
 
 void House::clean()
 {
-	for(PositionList::const_iterator pos_iter = tiles.begin();
-			pos_iter != tiles.end();
-			++pos_iter)
+	for(std::vector<HouseTile>::const_iterator tile_iter = tiles.begin();
+			tile_iter != tiles.end();
+			++tile_iter)
 	{
-		Tile* tile = map->getTile(*pos_iter);
+		Tile* tile = map->getTile(tile_iter->pos);
 		if(tile)
 			tile->setHouse(nullptr);
 	}
@@ -111,51 +114,145 @@ void House::clean()
 		tile->removeHouseExit(this);
 }
 
-size_t House::size() const
+void House::readTile(const Tile* tile, HouseTile& entry)
 {
-	size_t count = 0;
-	for(PositionList::const_iterator pos_iter = tiles.begin();
-			pos_iter != tiles.end();
-			++pos_iter)
+	entry.walkable = !tile->isBlocking();
+	entry.doors = 0;
+	for(ItemVector::const_iterator item_iter = tile->items.begin();
+			item_iter != tile->items.end();
+			++item_iter)
 	{
-		Tile* tile = map->getTile(*pos_iter);
-		if(tile && !tile->isBlocking())
-			++count;
+		if(dynamic_cast<const Door*>(*item_iter))
+			++entry.doors;
 	}
-	return count;
 }
 
 void House::addTile(Tile* tile)
 {
 	ASSERT(tile);
 	tile->setHouse(this);
-	tiles.push_back(tile->getPosition());
+
+	const Position pos = tile->getPosition();
+	if(tile_index.find(tileKey(pos)) != tile_index.end())
+	{
+		updateTile(tile);
+		return;
+	}
+
+	HouseTile entry;
+	entry.pos = pos;
+	readTile(tile, entry);
+
+	tile_index[tileKey(pos)] = tiles.size();
+	tiles.push_back(entry);
+	if(entry.walkable)
+		++sqm;
+	doors += entry.doors;
+
+	if(tiles.size() == 1)
+	{
+		bounds_start = pos;
+		bounds_end = pos;
+	}
+	else if(!bounds_dirty)
+	{
+		bounds_start = Position(std::min(bounds_start.x, pos.x), std::min(bounds_start.y, pos.y), std::min(bounds_start.z, pos.z));
+		bounds_end = Position(std::max(bounds_end.x, pos.x), std::max(bounds_end.y, pos.y), std::max(bounds_end.z, pos.z));
+	}
 }
 
 void House::removeTile(Tile* tile)
 {
 	ASSERT(tile);
-	for(PositionList::iterator tile_iter = tiles.begin();
+	const Position pos = tile->getPosition();
+	std::unordered_map<uint64_t, size_t>::iterator found = tile_index.find(tileKey(pos));
+	if(found == tile_index.end())
+		return;
+
+	const size_t index = found->second;
+	tile_index.erase(found);
+
+	const HouseTile& entry = tiles[index];
+	if(entry.walkable)
+		--sqm;
+	doors -= entry.doors;
+
+	if(pos.x == bounds_start.x || pos.y == bounds_start.y || pos.z == bounds_start.z ||
+			pos.x == bounds_end.x || pos.y == bounds_end.y || pos.z == bounds_end.z)
+		bounds_dirty = true;
+
+	if(index + 1 != tiles.size())
+	{
+		tiles[index] = tiles.back();
+		tile_index[tileKey(tiles[index].pos)] = index;
+	}
+	tiles.pop_back();
+
+	tile->setHouse(nullptr);
+}
+
+void House::updateTile(Tile* tile)
+{
+	ASSERT(tile);
+	std::unordered_map<uint64_t, size_t>::const_iterator found = tile_index.find(tileKey(tile->getPosition()));
+	if(found == tile_index.end())
+	{
+		addTile(tile);
+		return;
+	}
+
+	HouseTile& entry = tiles[found->second];
+	if(entry.walkable)
+		--sqm;
+	doors -= entry.doors;
+
+	readTile(tile, entry);
+	if(entry.walkable)
+		++sqm;
+	doors += entry.doors;
+}
+
+void House::recalculateBounds() const
+{
+	bounds_dirty = false;
+	if(tiles.empty())
+		return;
+
+	bounds_start = bounds_end = tiles.front().pos;
+	for(std::vector<HouseTile>::const_iterator tile_iter = tiles.begin();
 			tile_iter != tiles.end();
 			++tile_iter)
 	{
-		if(*tile_iter == tile->getPosition())
-		{
-			tiles.erase(tile_iter);
-			tile->setHouse(nullptr);
-			return;
-		}
+		const Position& pos = tile_iter->pos;
+		bounds_start = Position(std::min(bounds_start.x, pos.x), std::min(bounds_start.y, pos.y), std::min(bounds_start.z, pos.z));
+		bounds_end = Position(std::max(bounds_end.x, pos.x), std::max(bounds_end.y, pos.y), std::max(bounds_end.z, pos.z));
 	}
 }
 
+bool House::getBounds(Position& start, Position& end) const
+{
+	if(tiles.empty())
+		return false;
+
+	if(bounds_dirty)
+		recalculateBounds();
+
+	start = bounds_start;
+	end = bounds_end;
+	return true;
+}
+
 uint8_t House::getEmptyDoorID() const
 {
 	std::set<uint8_t> taken;
-	for(PositionList::const_iterator tile_iter = tiles.begin();
+	for(std::vector<HouseTile>::const_iterator tile_iter = tiles.begin();
 			tile_iter != tiles.end();
 			++tile_iter)
 	{
-		if(const Tile* tile = map->getTile(*tile_iter))
+		if(tile_iter->doors == 0)
+			continue;
+
+		if(const Tile* tile = map->getTile(tile_iter->pos))
 		{
 			for(ItemVector::const_iterator item_iter = tile->items.begin();
 					item_iter != tile->items.end();
@@ -180,11 +277,14 @@ uint8_t House::getEmptyDoorID() const
 
 Position House::getDoorPositionByID(uint8_t id) const
 {
-	for(PositionList::const_iterator tile_iter = tiles.begin();
+	for(std::vector<HouseTile>::const_iterator tile_iter = tiles.begin();
 			tile_iter != tiles.end();
 			++tile_iter)
 	{
-		if(const Tile* tile = map->getTile(*tile_iter))
+		if(tile_iter->doors == 0)
+			continue;
+
+		if(const Tile* tile = map->getTile(tile_iter->pos))
 		{
 			for(ItemVector::const_iterator item_iter = tile->items.begin();
 					item_iter != tile->items.end();
@@ -194,7 +294,7 @@ Position House::getDoorPositionByID(uint8_t id) const
 				{
 					if(door->getDoorID() == id)
 					{
-						return *tile_iter;
+						return tile_iter->pos;
 					}
 				}
 			}
@@ -24,6 +24,8 @@
 
 #include "position.h"
 
+#include <unordered_map>
+
 class Map;
 class Tile;
 class Door;
@@ -38,7 +40,16 @@ public:
 	void clean();
 	void addTile(Tile* tile);
 	void removeTile(Tile* tile);
-	size_t size() const;
+	// The tile changed but stays in the house, its sqm and doors are read again
+	void updateTile(Tile* tile);
+	bool hasTile(const Position& pos) const {return tile_index.find(tileKey(pos)) != tile_index.end();}
+
+	// Walkable tiles, the house size the server sees
+	size_t size() const {return sqm;}
+	size_t getTileCount() const {return tiles.size();}
+	size_t getDoorCount() const {return doors;}
+	// False if the house has no tiles
+	bool getBounds(Position& start, Position& end) const;
 	std::string getDescription();
 
 	uint32_t id;
@@ -54,8 +65,25 @@ public:
 	uint8_t getEmptyDoorID() const;
 	Position getDoorPositionByID(uint8_t id) const;
 protected:
+	struct HouseTile {
+		Position pos;
+		bool walkable;
+		uint16_t doors;
+	};
+
+	static uint64_t tileKey(const Position& pos) {return (uint64_t(pos.z & 0xFF) << 32) | (uint64_t(pos.y & 0xFFFF) << 16) | uint64_t(pos.x & 0xFFFF);}
+	static void readTile(const Tile* tile, HouseTile& entry);
+	void recalculateBounds() const;
+
 	Map* map;
-	PositionList tiles;
+	// In no particular order, removing swaps the last tile into the gap
+	std::vector<HouseTile> tiles;
+	std::unordered_map<uint64_t, size_t> tile_index;
+	size_t sqm;
+	size_t doors;
+	// Only grows as tiles are added, worked out again after a tile on its edge is removed
+	mutable Position bounds_start, bounds_end;
+	mutable bool bounds_dirty;
 	Position exit;
 
 	friend class Houses;
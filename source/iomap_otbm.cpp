@@ -647,7 +647,196 @@ bool IOMapOTBM::loadMap(Map& map, const FileName& filename)
 	}
 }
 
+bool IOMapOTBM::readArchiveEntry(const FileName& filename, const std::string& entryName, std::vector<uint8_t>& buffer)
+{
+	std::shared_ptr<struct archive> a(archive_read_new(), archive_read_free);
+	archive_read_support_filter_all(a.get());
+	archive_read_support_format_all(a.get());
+	if (archive_read_open_filename(a.get(), nstr(filename.GetFullPath()).c_str(), 10240) != ARCHIVE_OK)
+		return false;
+
+	struct archive_entry* entry;
+	while (archive_read_next_header(a.get(), &entry) == ARCHIVE_OK)
+	{
+		if (entryName != archive_entry_pathname(entry))
+			continue;
+
+		buffer.resize(archive_entry_size(entry));
+		if (buffer.empty())
+			return false;
+
+		size_t read_bytes = archive_read_data(a.get(), buffer.data(), buffer.size());
+		return read_bytes == buffer.size();
+	}
+	return false;
+}
+
+bool IOMapOTBM::readXML(const FileName& filename, const std::string& file, const std::string& entryName, pugi::xml_document& doc)
+{
+	if (filename.GetExt() == wxT("otgz"))
+	{
+		std::vector<uint8_t> buffer;
+		if (!readArchiveEntry(filename, entryName, buffer))
+			return false;
+		pugi::xml_parse_result result = doc.load_buffer(buffer.data(), buffer.size());
+		if (!result)
+			return false;
+		return true;
+	}
+
+	std::string fn = (const char*)(filename.GetPath(wxPATH_GET_SEPARATOR | wxPATH_GET_VOLUME).mb_str(wxConvUTF8));
+	fn += file;
+	if (FileName(wxstr(fn)).FileExists() == false)
+		return false;
+	pugi::xml_parse_result result = doc.load_file(fn.c_str());
+	if (!result)
+		return false;
+	return true;
+}
+
+bool IOMapOTBM::loadMapInfo(Map& map, const FileName& filename)
+{
+	if (filename.GetExt() == wxT("otgz"))
+	{
+		// The map file is decompressed into memory, it's only read for the
+		// small nodes at its end
+		std::vector<uint8_t> otbm_buffer;
+		if (!readArchiveEntry(filename, "world/map.otbm", otbm_buffer) || otbm_buffer.size() < 4)
+		{
+			error(wxT("OTBM file not found inside archive."));
+			return false;
+		}
+
+		MemoryNodeFileReadHandle f(otbm_buffer.data() + 4, otbm_buffer.size() - 4);
+		if (!readMap(map, f, nullptr, true))
+			return false;
+	}
+	else
+	{
+		DiskNodeFileReadHandle f(nstr(filename.GetFullPath()), StringVector(1, "OTBM"));
+		if (f.isOk() == false)
+		{
+			error((wxT("Couldn't open file for reading\nThe error reported was: ") + wxstr(f.getErrorMessage())).wc_str());
+			return false;
+		}
+
+		if (!readMap(map, f, nullptr, true))
+			return false;
+	}
+
+	// Houses are normally created by their tiles, which aren't read here
+	pugi::xml_document doc;
+	if (!readXML(filename, map.housefile, "world/houses.xml", doc))
+	{
+		warning(wxT("Failed to load houses."));
+		return true;
+	}
+
+	pugi::xml_node node = doc.child("houses");
+	for (pugi::xml_node houseNode = node.first_child(); houseNode; houseNode = houseNode.next_sibling())
+	{
+		uint32_t house_id = pugi::cast<uint32_t>(houseNode.attribute("houseid").value());
+		if (house_id && !map.houses.getHouse(house_id))
+		{
+			House* house = newd House(map);
+			house->id = house_id;
+			map.houses.addHouse(house);
+		}
+	}
+
+	if (!loadHouses(map, doc))
+		warning(wxT("Failed to load houses."));
+	return true;
+}
+
+bool IOMapOTBM::streamTiles(Map& map, const FileName& filename, OTBMTileSink& sink)
+{
+	if (filename.GetExt() == wxT("otgz"))
+	{
+		std::vector<uint8_t> otbm_buffer;
+		if (!readArchiveEntry(filename, "world/map.otbm", otbm_buffer) || otbm_buffer.size() < 4)
+		{
+			error(wxT("OTBM file not found inside archive."));
+			return false;
+		}
+
+		MemoryNodeFileReadHandle f(otbm_buffer.data() + 4, otbm_buffer.size() - 4);
+		return readMap(map, f, &sink, false);
+	}
+
+	DiskNodeFileReadHandle f(nstr(filename.GetFullPath()), StringVector(1, "OTBM"));
+	if (f.isOk() == false)
+	{
+		error((wxT("Couldn't open file for reading\nThe error reported was: ") + wxstr(f.getErrorMessage())).wc_str());
+		return false;
+	}
+	return readMap(map, f, &sink, false);
+}
+
+bool IOMapOTBM::importSpawns(Map& map, const FileName& filename, const std::string& spawnfile, const Position& offset, OTBMTileSink& sink)
+{
+	pugi::xml_document doc;
+	if (!readXML(filename, spawnfile, "world/spawns.xml", doc))
+	{
+		warning(wxT("Failed to load spawns."));
+		return false;
+	}
+	return loadSpawns(map, doc, offset, &sink);
+}
+
+// Loading a map, every tile goes where it was
+class IOMapOTBM::MapSink : public OTBMTileSink
+{
+public:
+	MapSink(IOMapOTBM& loader, Map& map) : loader(loader), map(map) {}
+
+	virtual Tile* createTile(const Position& position)
+	{
+		if(map.getTile(position))
+		{
+			loader.warning(wxT("Duplicate tile at %d:%d:%d, discarding duplicate"), position.x, position.y, position.z);
+			return nullptr;
+		}
+		return map.allocator(map.createTileL(position));
+	}
+
+	virtual House* getHouse(uint32_t house_id)
+	{
+		House* house = map.houses.getHouse(house_id);
+		if(!house)
+		{
+			house = newd House(map);
+			house->id = house_id;
+			map.houses.addHouse(house);
+		}
+		return house;
+	}
+
+	virtual void addTile(Tile* tile, House* house)
+	{
+		if(house)
+			house->addTile(tile);
+
+		map.setTile(tile->getPosition(), tile);
+	}
+
+	virtual void progress(size_t offset, size_t size)
+	{
+		gui.SetLoadDone(static_cast<int32_t>(100.0 * offset / size));
+	}
+
+protected:
+	IOMapOTBM& loader;
+	Map& map;
+};
+
 bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
+{
+	MapSink sink(*this, map);
+	return readMap(map, f, &sink, true);
+}
+
+bool IOMapOTBM::readMap(Map& map, NodeFileReadHandle& f, OTBMTileSink* sink, bool readInfo)
 {
 	BinaryNode* root = f.getRootNode();
 	if(!root)
@@ -666,7 +855,8 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 
 	version.otbm = (MapVersionID) u32;
 
-	if(version.otbm > MAP_OTBM_4)
+	// The questions were asked when the info was read
+	if(version.otbm > MAP_OTBM_4 && readInfo)
 	{
 		// Failed to read version
 		if(gui.PopupDialog(wxT("Map error"), 
@@ -691,7 +881,7 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 
 	map.height = u16;
 
-	if(!root->getU32(u32) || u32 > (unsigned long)item_db.MajorVersion) // OTB major version
+	if(!root->getU32(u32) || (readInfo && u32 > (unsigned long)item_db.MajorVersion)) // OTB major version
 	{ 
 		if(gui.PopupDialog(wxT("Map error"), 
 			wxT("The loaded map appears to be a items.otb format that deviates from the ")
@@ -706,7 +896,7 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 		}
 	}
 
-	if(!root->getU32(u32) || u32 > (unsigned long)item_db.MinorVersion) // OTB minor version
+	if(!root->getU32(u32) || (readInfo && u32 > (unsigned long)item_db.MinorVersion)) // OTB minor version
 	{
 		warning(wxT("This editor needs an updated items.otb version"));
 	}
@@ -759,8 +949,8 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 	for(BinaryNode* mapNode = mapHeaderNode->getChild(); mapNode != nullptr; mapNode = mapNode->advance())
 	{
 		++nodes_loaded;
-		if (nodes_loaded % 15 == 0) {
-			gui.SetLoadDone(static_cast<int32_t>(100.0 * f.tell() / f.size()));
+		if (sink && nodes_loaded % 15 == 0) {
+			sink->progress(f.tell(), f.size());
 		}
 		
 		uint8_t node_type;
@@ -771,143 +961,10 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 		}
 		if(node_type == OTBM_TILE_AREA)
 		{
-			uint16_t base_x, base_y;
-			uint8_t base_z;
-			if(!mapNode->getU16(base_x) ||
-					!mapNode->getU16(base_y) ||
-					!mapNode->getU8(base_z))
-			{
-				warning(wxT("Invalid map node, no base coordinate"));
-				continue;
-			}
-
-			for(BinaryNode* tileNode = mapNode->getChild(); tileNode != nullptr; tileNode = tileNode->advance())
-			{
-				Tile* tile = nullptr;
-				uint8_t tile_type;
-				if(!tileNode->getByte(tile_type))
-				{
-					warning(wxT("Invalid tile type"));
-					continue;
-				}
-				if(tile_type == OTBM_TILE || tile_type == OTBM_HOUSETILE)
-				{
-					//printf("Start\n");
-					uint8_t x_offset, y_offset;
-					if(!tileNode->getU8(x_offset) || !tileNode->getU8(y_offset))
-					{
-						warning(wxT("Could not read position of tile"));
-						continue;
-					}
-					const Position pos(base_x + x_offset, base_y + y_offset, base_z);
-					
-					if(map.getTile(pos))
-					{
-						warning(wxT("Duplicate tile at %d:%d:%d, discarding duplicate"), pos.x, pos.y, pos.z);
-						continue;
-					}
-					
-					tile = map.allocator(map.createTileL(pos));
-					House* house = nullptr;
-					if(tile_type == OTBM_HOUSETILE)
-					{
-						uint32_t house_id;
-						if(!tileNode->getU32(house_id))
-						{
-							warning(wxT("House tile without house data, discarding tile"));
-							continue;
-						}
-						if(house_id)
-						{
-							house = map.houses.getHouse(house_id);
-							if(!house)
-							{
-								house = newd House(map);
-								house->id = house_id;
-								map.houses.addHouse(house);
-							}
-						}
-						else
-						{
-							warning(wxT("Invalid house id from tile %d:%d:%d"), pos.x, pos.y, pos.z);
-						}
-					}
-
-					//printf("So far so good\n");
-
-					uint8_t attribute;
-					while(tileNode->getU8(attribute))
-					{
-						switch(attribute)
-						{
-							case OTBM_ATTR_TILE_FLAGS:
-							{
-								uint32_t flags = 0;
-								if(!tileNode->getU32(flags)) {
-									warning(wxT("Invalid tile flags of tile on %d:%d:%d"), pos.x, pos.y, pos.z);
-								}
-								tile->setMapFlags(flags);
-							} break;
-							case OTBM_ATTR_ITEM:
-							{
-								Item* item = Item::Create_OTBM(*this, tileNode);
-								if(item == nullptr)
-								{
-									warning(wxT("Invalid item at tile %d:%d:%d"), pos.x, pos.y, pos.z);
-								}
-								tile->addItem(item);
-							} break;
-							default:
-							{
-								warning(wxT("Unknown tile attribute at %d:%d:%d"), pos.x, pos.y, pos.z);
-							} break;
-						}
-					}
-
-					//printf("Didn't die in loop\n");
-
-					
-					for(BinaryNode* itemNode = tileNode->getChild(); itemNode != nullptr; itemNode = itemNode->advance())
-					{
-						Item* item = nullptr;
-						uint8_t item_type;
-						if(!itemNode->getByte(item_type))
-						{
-							warning(wxT("Unknown item type %d:%d:%d"), pos.x, pos.y, pos.z);
-							continue;
-						}
-						if(item_type == OTBM_ITEM)
-						{
-							item = Item::Create_OTBM(*this, itemNode);
-							if(item)
-							{
-								if(item->unserializeItemNode_OTBM(*this, itemNode) == false)
-								{
-									warning(wxT("Couldn't unserialize item attributes at %d:%d:%d"), pos.x, pos.y, pos.z);
-								}
-								//reform(&map, tile, item);
-								tile->addItem(item);
-							}
-						}
-						else
-						{
-							warning(wxT("Unknown type of tile child node"));
-						}
-					}
-
-					tile->update();
-					if(house)
-						house->addTile(tile);
-
-					map.setTile(pos.x, pos.y, pos.z, tile);
-				}
-				else
-				{
-					warning(wxT("Unknown type of tile node"));
-				}
-			}
+			if(sink)
+				readTileArea(mapNode, *sink);
 		}
-		else if(node_type == OTBM_TOWNS)
+		else if(node_type == OTBM_TOWNS && readInfo)
 		{
 			for(BinaryNode* townNode = mapNode->getChild(); townNode != nullptr; townNode = townNode->advance())
 			{
@@ -969,7 +1026,7 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 				town->setTemplePosition(pos);
 			}
 		}
-		else if(node_type == OTBM_WAYPOINTS)
+		else if(node_type == OTBM_WAYPOINTS && readInfo)
 		{
 			for(BinaryNode* waypointNode = mapNode->getChild(); waypointNode != nullptr; waypointNode = waypointNode->advance())
 			{
@@ -1016,6 +1073,134 @@ bool IOMapOTBM::loadMap(Map& map, NodeFileReadHandle& f)
 	return true;
 }
 
+void IOMapOTBM::readTileArea(BinaryNode* mapNode, OTBMTileSink& sink)
+{
+	uint16_t base_x, base_y;
+	uint8_t base_z;
+	if(!mapNode->getU16(base_x) ||
+			!mapNode->getU16(base_y) ||
+			!mapNode->getU8(base_z))
+	{
+		warning(wxT("Invalid map node, no base coordinate"));
+		return;
+	}
+
+	for(BinaryNode* tileNode = mapNode->getChild(); tileNode != nullptr; tileNode = tileNode->advance())
+	{
+		Tile* tile = nullptr;
+		uint8_t tile_type;
+		if(!tileNode->getByte(tile_type))
+		{
+			warning(wxT("Invalid tile type"));
+			continue;
+		}
+		if(tile_type == OTBM_TILE || tile_type == OTBM_HOUSETILE)
+		{
+			//printf("Start\n");
+			uint8_t x_offset, y_offset;
+			if(!tileNode->getU8(x_offset) || !tileNode->getU8(y_offset))
+			{
+				warning(wxT("Could not read position of tile"));
+				continue;
+			}
+			const Position pos(base_x + x_offset, base_y + y_offset, base_z);
+
+			tile = sink.createTile(pos);
+			if(!tile)
+				continue;
+
+			House* house = nullptr;
+			if(tile_type == OTBM_HOUSETILE)
+			{
+				uint32_t house_id;
+				if(!tileNode->getU32(house_id))
+				{
+					warning(wxT("House tile without house data, discarding tile"));
+					delete tile;
+					continue;
+				}
+				if(house_id)
+				{
+					house = sink.getHouse(house_id);
+				}
+				else
+				{
+					warning(wxT("Invalid house id from tile %d:%d:%d"), pos.x, pos.y, pos.z);
+				}
+			}
+
+			//printf("So far so good\n");
+
+			uint8_t attribute;
+			while(tileNode->getU8(attribute))
+			{
+				switch(attribute)
+				{
+					case OTBM_ATTR_TILE_FLAGS:
+					{
+						uint32_t flags = 0;
+						if(!tileNode->getU32(flags)) {
+							warning(wxT("Invalid tile flags of tile on %d:%d:%d"), pos.x, pos.y, pos.z);
+						}
+						tile->setMapFlags(flags);
+					} break;
+					case OTBM_ATTR_ITEM:
+					{
+						Item* item = Item::Create_OTBM(*this, tileNode);
+						if(item == nullptr)
+						{
+							warning(wxT("Invalid item at tile %d:%d:%d"), pos.x, pos.y, pos.z);
+						}
+						tile->addItem(item);
+					} break;
+					default:
+					{
+						warning(wxT("Unknown tile attribute at %d:%d:%d"), pos.x, pos.y, pos.z);
+					} break;
+				}
+			}
+
+			//printf("Didn't die in loop\n");
+
+			
+			for(BinaryNode* itemNode = tileNode->getChild(); itemNode != nullptr; itemNode = itemNode->advance())
+			{
+				Item* item = nullptr;
+				uint8_t item_type;
+				if(!itemNode->getByte(item_type))
+				{
+					warning(wxT("Unknown item type %d:%d:%d"), pos.x, pos.y, pos.z);
+					continue;
+				}
+				if(item_type == OTBM_ITEM)
+				{
+					item = Item::Create_OTBM(*this, itemNode);
+					if(item)
+					{
+						if(item->unserializeItemNode_OTBM(*this, itemNode) == false)
+						{
+							warning(wxT("Couldn't unserialize item attributes at %d:%d:%d"), pos.x, pos.y, pos.z);
+						}
+						//reform(&map, tile, item);
+						tile->addItem(item);
+					}
+				}
+				else
+				{
+					warning(wxT("Unknown type of tile child node"));
+				}
+			}
+
+			tile->update();
+			sink.addTile(tile, house);
+		}
+		else
+		{
+			warning(wxT("Unknown type of tile node"));
+		}
+	}
+}
+
 bool IOMapOTBM::loadSpawns(Map& map, const FileName& dir)
 {
 	std::string fn = (const char*)(dir.GetPath(wxPATH_GET_SEPARATOR | wxPATH_GET_VOLUME).mb_str(wxConvUTF8));
@@ -1033,7 +1218,7 @@ bool IOMapOTBM::loadSpawns(Map& map, const FileName& dir)
 	return loadSpawns(map, doc);
 }
 
-bool IOMapOTBM::loadSpawns(Map& map, pugi::xml_document& doc)
+bool IOMapOTBM::loadSpawns(Map& map, pugi::xml_document& doc, const Position& offset, OTBMTileSink* sink)
 {
 	pugi::xml_node node = doc.child("spawns");
 	if (!node) {
@@ -1056,6 +1241,14 @@ bool IOMapOTBM::loadSpawns(Map& map, pugi::xml_document& doc)
 			continue;
 		}
 
+		// Imported spawns move with their tiles
+		const Position filePosition = spawnPosition;
+		spawnPosition += offset;
+		if (!spawnPosition.isValid()) {
+			warning(wxT("Bad position data on one spawn, discarding..."));
+			continue;
+		}
+
 		int32_t radius = pugi::cast<int32_t>(spawnNode.attribute("radius").value());
 		if (radius < 1) {
 			warning(wxT("Couldn't read radius of spawn.. discarding spawn..."));
@@ -1068,13 +1261,19 @@ bool IOMapOTBM::loadSpawns(Map& map, pugi::xml_document& doc)
 			continue;
 		}
 
-		Spawn* spawn = newd Spawn(radius);
-		if (!tile) {
+		if (!tile && sink) {
+			tile = sink->createTile(filePosition);
+			if (!tile) {
+				warning(wxT("Spawn on position %d:%d:%d is outside the map, discarding..."), spawnPosition.x, spawnPosition.y, spawnPosition.z);
+				continue;
+			}
+			sink->addTile(tile, nullptr);
+		} else if (!tile) {
 			tile = map.allocator(map.createTileL(spawnPosition));
 			map.setTile(spawnPosition, tile);
 		}
 
-		tile->spawn = spawn;
+		tile->spawn = newd Spawn(radius);
 		map.addSpawn(tile);
 
 		for (pugi::xml_node creatureNode = spawnNode.first_child(); creatureNode; creatureNode = creatureNode.next_sibling()) {
@@ -1128,6 +1327,12 @@ bool IOMapOTBM::loadSpawns(Map& map, pugi::xml_document& doc)
 				creatureTile = tile;
 			} else {
 				creatureTile = map.getTile(creaturePosition);
+				if (!creatureTile && sink && creaturePosition.isValid()) {
+					creatureTile = sink->createCreatureTile(creaturePosition - offset);
+					if (creatureTile) {
+						sink->addTile(creatureTile, nullptr);
+					}
+				}
 			}
 
 			if (!creatureTile) {
@@ -1156,7 +1361,7 @@ bool IOMapOTBM::loadSpawns(Map& map, pugi::xml_document& doc)
 			creature->setSpawnTime(spawntime);
 			creatureTile->creature = creature;
 
-			if (creatureTile->getLocation()->getSpawnCount() == 0) {
+			if (map.spawns.countSpawns(creatureTile->getPosition()) == 0) {
 				// No spawn, create a newd one
 				ASSERT(creatureTile->spawn == nullptr);
 				Spawn* spawn = newd Spawn(5);
@@ -118,6 +118,31 @@ struct OTBM_HouseTile_coords
 
 #pragma pack()
 
+class Tile;
+class House;
+
+// Takes the tiles of a map file as they are read. Loading a map puts them
+// where they were, an import moves them into another map, see
+// IOMapOTBM::streamTiles.
+class OTBMTileSink
+{
+public:
+	virtual ~OTBMTileSink() {}
+
+	// The tile that is read at the position, nullptr skips it
+	virtual Tile* createTile(const Position& position) = 0;
+	// The house for a house id of the file, nullptr if the tile shouldn't be in one
+	virtual House* getHouse(uint32_t house_id) = 0;
+	// Every created tile, once it's read completely
+	virtual void addTile(Tile* tile, House* house) = 0;
+	// Every few tile areas, how far into the map file the reader is
+	virtual void progress(size_t, size_t) {}
+	// A tile for a spawned creature where the map has none, with a sink the
+	// map may not hold the tiles of the file. nullptr discards the creature,
+	// as loading the map does.
+	virtual Tile* createCreatureTile(const Position&) { return nullptr; }
+};
+
 class IOMapOTBM : public IOMap
 {
 public:
@@ -129,12 +154,33 @@ public:
 	virtual bool loadMap(Map& map, const FileName& identifier);
 	virtual bool saveMap(Map& map, const FileName& identifier);
 
+	// Reads everything of a map file except its tiles and spawns, that is the
+	// header, towns, waypoints and houses. Tile areas are skipped unread.
+	bool loadMapInfo(Map& map, const FileName& identifier);
+	// Reads the tiles of a map file into the sink one at a time, none are
+	// kept by the map, which only gets the header
+	bool streamTiles(Map& map, const FileName& identifier, OTBMTileSink& sink);
+	// Adds the spawns of a map file to the map, moved by offset. The tiles
+	// that spawns need are made by the sink, as if they were in the map file.
+	bool importSpawns(Map& map, const FileName& identifier, const std::string& spawnfile, const Position& offset, OTBMTileSink& sink);
+
 protected:
+	class MapSink;
+
 	static bool getVersionInfo(NodeFileReadHandle* f,  MapVersion& out_ver);
 
 	virtual bool loadMap(Map& map, NodeFileReadHandle& handle);
+	// Tile areas go to the sink or are skipped without one, towns and
+	// waypoints are only read with readInfo
+	bool readMap(Map& map, NodeFileReadHandle& handle, OTBMTileSink* sink, bool readInfo);
+	void readTileArea(BinaryNode* mapNode, OTBMTileSink& sink);
+	// Reads one file of a .otgz archive
+	bool readArchiveEntry(const FileName& filename, const std::string& entryName, std::vector<uint8_t>& buffer);
+	// houses.xml or spawns.xml next to the map file, or in its archive
+	bool readXML(const FileName& filename, const std::string& file, const std::string& entryName, pugi::xml_document& doc);
+
 	bool loadSpawns(Map& map, const FileName& dir);
-	bool loadSpawns(Map& map, pugi::xml_document& doc);
+	bool loadSpawns(Map& map, pugi::xml_document& doc, const Position& offset = Position(), OTBMTileSink* sink = nullptr);
 	bool loadHouses(Map& map, const FileName& dir);
 	bool loadHouses(Map& map, pugi::xml_document& doc);
 
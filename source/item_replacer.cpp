@@ -0,0 +1,242 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "item_replacer.h"
+#include "editor.h"
+#include "action.h"
+#include "map.h"
+#include "complexitem.h"
+#include "gui.h"
+
+#include <fstream>
+
+ItemReplacer::Rule::Rule() :
+	from(0),
+	to(0),
+	subtype(-1),
+	newSubtype(-1),
+	actionId(0)
+{
+	//
+}
+
+ItemReplacer::ItemReplacer()
+{
+	//
+}
+
+void ItemReplacer::addRule(const Rule& rule)
+{
+	rules.push_back(rule);
+	first.clear();
+}
+
+bool ItemReplacer::loadRules(const std::string& filename, wxString& error)
+{
+	std::ifstream file(filename.c_str());
+	if (!file) {
+		error = wxT("Could not open ") + wxstr(filename) + wxT(".");
+		return false;
+	}
+
+	std::string line;
+	for (int number = 1; std::getline(file, line); ++number) {
+		const size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.erase(comment);
+		}
+
+		std::istringstream fields(line);
+		long from, to;
+		if (!(fields >> from)) {
+			// Blank or only a comment
+			continue;
+		}
+
+		const wxString where = wxstr(filename) + wxString::Format(wxT(", line %d: "), number);
+		if (!(fields >> to)) {
+			error = where + wxT("expected the id to replace with.");
+			return false;
+		}
+		if (from <= 0 || from > 0xFFFF || to <= 0 || to > 0xFFFF || !item_db.typeExists(to)) {
+			error = where + wxT("unknown item id.");
+			return false;
+		}
+
+		Rule rule;
+		rule.from = uint16_t(from);
+		rule.to = uint16_t(to);
+
+		std::string option;
+		while (fields >> option) {
+			const size_t equals = option.find('=');
+			const std::string name = option.substr(0, equals);
+			long value = -1;
+			if (equals != std::string::npos) {
+				std::istringstream(option.substr(equals + 1)) >> value;
+			}
+
+			if (name == "subtype" && value >= 0 && value <= 0xFFFF) {
+				rule.subtype = value;
+			} else if (name == "newsubtype" && value >= 0 && value <= 0xFFFF) {
+				rule.newSubtype = value;
+			} else if (name == "aid" && value > 0 && value <= 0xFFFF) {
+				rule.actionId = uint16_t(value);
+			} else {
+				error = where + wxT("invalid option ") + wxstr(option) + wxT(".");
+				return false;
+			}
+		}
+		addRule(rule);
+	}
+	return true;
+}
+
+void ItemReplacer::compile()
+{
+	// Grouped by id, the order within an id is kept
+	std::stable_sort(rules.begin(), rules.end(), [](const Rule& a, const Rule& b) {
+		return a.from < b.from;
+	});
+
+	first.assign(0x10000 + 1, 0);
+	for (const Rule& rule : rules) {
+		++first[rule.from + 1];
+	}
+	for (size_t id = 1; id < first.size(); ++id) {
+		first[id] += first[id - 1];
+	}
+}
+
+const ItemReplacer::Rule* ItemReplacer::match(const Item* item) const
+{
+	const uint16_t id = item->getID();
+	for (uint32_t i = first[id]; i < first[id + 1]; ++i) {
+		const Rule& rule = rules[i];
+		if (rule.subtype >= 0 && item->getSubtype() != rule.subtype) {
+			continue;
+		}
+		if (rule.actionId != 0 && item->getActionID() != rule.actionId) {
+			continue;
+		}
+		return &rule;
+	}
+	return nullptr;
+}
+
+bool ItemReplacer::needsReplace(const Item* item) const
+{
+	if (match(item)) {
+		return true;
+	}
+
+	if (const Container* container = dynamic_cast<const Container*>(item)) {
+		for (size_t i = 0; i < container->getItemCount(); ++i) {
+			if (needsReplace(container->getItem(i))) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+size_t ItemReplacer::replaceItem(Item*& item) const
+{
+	size_t replaced = 0;
+
+	// The contents first, a container that is replaced takes them along
+	if (Container* container = dynamic_cast<Container*>(item)) {
+		for (Item*& content : container->getVector()) {
+			replaced += replaceItem(content);
+		}
+	}
+
+	const Rule* rule = match(item);
+	if (!rule) {
+		return replaced;
+	}
+
+	Item* old = item;
+	item = transformItem(old, rule->to);
+	delete old;
+	if (rule->newSubtype >= 0) {
+		item->setSubtype(uint16_t(rule->newSubtype));
+	}
+	return replaced + 1;
+}
+
+size_t ItemReplacer::replaceTile(Tile* tile) const
+{
+	size_t replaced = 0;
+	if (tile->ground) {
+		replaced += replaceItem(tile->ground);
+	}
+	for (Item*& item : tile->items) {
+		replaced += replaceItem(item);
+	}
+	return replaced;
+}
+
+size_t ItemReplacer::apply(Editor& editor, size_t threads, bool showdialog)
+{
+	threads = std::max<size_t>(threads, 1);
+	if (rules.empty()) {
+		return 0;
+	}
+	compile();
+
+	Map& map = editor.map;
+	std::vector<QTreeNode*> leaves;
+	map.getLeaves(leaves);
+
+	// The map isn't touched during the pass, each thread collects replaced
+	// copies of its tiles and they become one action afterwards
+	std::vector<std::vector<Tile*>> changed(threads);
+	std::vector<size_t> replaced(threads, 0);
+	StripeProgress progress(leaves.size(), showdialog);
+
+	ParallelStripes(leaves.size(), threads, [&](size_t stripe, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaves[i]->getFloor(z);
+				if (!floor) {
+					continue;
+				}
+
+				for (TileLocation& location : floor->locs) {
+					Tile* tile = location.get();
+					if (!tile) {
+						continue;
+					}
+
+					bool replace = tile->ground && needsReplace(tile->ground);
+					for (auto it = tile->items.begin(); !replace && it != tile->items.end(); ++it) {
+						replace = needsReplace(*it);
+					}
+					if (!replace) {
+						continue;
+					}
+
+					Tile* newTile = tile->deepCopy(map);
+					replaced[stripe] += replaceTile(newTile);
+					changed[stripe].push_back(newTile);
+				}
+			}
+			progress.advance(stripe);
+		}
+	});
+
+	size_t total = 0;
+	Action* action = editor.actionQueue->createAction(ACTION_REPLACE_ITEMS);
+	for (size_t stripe = 0; stripe < threads; ++stripe) {
+		for (Tile* tile : changed[stripe]) {
+			action->addChange(newd Change(tile));
+		}
+		total += replaced[stripe];
+	}
+	editor.addAction(action);
+	return total;
+}
@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_ITEM_REPLACER_H_
+#define RME_ITEM_REPLACER_H_
+
+class Editor;
+class Tile;
+class Item;
+
+// Replaces items on the whole map by a table of rules in one pass. The
+// rules are indexed by the id they replace in a flat table, so an item
+// costs one lookup however many rules there are. Each item is replaced at
+// most once, a rule from 100 to 200 and one from 200 to 300 swap both
+// kinds instead of turning 100 into 300. The leaves are split between
+// threads and the changed tiles are committed as a single undoable action.
+class ItemReplacer
+{
+public:
+	struct Rule
+	{
+		Rule();
+
+		uint16_t from;
+		uint16_t to;
+		// -1 matches any subtype
+		int32_t subtype;
+		// -1 keeps the subtype
+		int32_t newSubtype;
+		// 0 matches any action id
+		uint16_t actionId;
+	};
+
+	ItemReplacer();
+
+	// Rules for the same id are tried in the order they were added
+	void addRule(const Rule& rule);
+	size_t getRuleCount() const { return rules.size(); }
+
+	// One rule per line, "from to [subtype=N] [newsubtype=N] [aid=N]",
+	// anything after a # is a comment
+	bool loadRules(const std::string& filename, wxString& error);
+
+	// Returns the number of items replaced
+	size_t apply(Editor& editor, size_t threads, bool showdialog);
+
+protected:
+	void compile();
+	const Rule* match(const Item* item) const;
+	bool needsReplace(const Item* item) const;
+	size_t replaceItem(Item*& item) const;
+	size_t replaceTile(Tile* tile) const;
+
+	std::vector<Rule> rules;
+	// The rules of id n are rules[first[n]] up to rules[first[n + 1]]
+	std::vector<uint32_t> first;
+};
+
+#endif
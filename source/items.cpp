@@ -967,6 +967,197 @@ bool ItemDatabase::loadMetaItem(pugi::xml_node node)
 	return true;
 }
 
+namespace {
+	// Bumped whenever ItemType or the layout below changes
+	const uint32_t ITEM_CACHE_VERSION = 1;
+	const char ITEM_CACHE_MAGIC[4] = {'R', 'M', 'E', 'I'};
+
+	uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		// FNV-1a
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	uint64_t HashFile(uint64_t hash, const FileName& filename)
+	{
+		FileReadHandle file(nstr(filename.GetFullPath()));
+		std::string contents;
+		if (!file.isOk() || !file.getRAW(contents, file.size())) {
+			// A missing file is part of the key too
+			return HashBytes(hash, "missing", 7);
+		}
+		return HashBytes(hash, contents.data(), contents.size());
+	}
+
+	struct CacheWriter
+	{
+		template<class T>
+		bool operator()(const T& value) {
+			data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+			return true;
+		}
+
+		bool operator()(const std::string& value) {
+			(*this)(uint32_t(value.size()));
+			data.append(value);
+			return true;
+		}
+
+		std::string data;
+	};
+
+	struct CacheReader
+	{
+		explicit CacheReader(const std::string& data) : data(data), offset(0) {}
+
+		template<class T>
+		bool operator()(T& value) {
+			if (offset + sizeof(value) > data.size()) {
+				return false;
+			}
+			memcpy(&value, data.data() + offset, sizeof(value));
+			offset += sizeof(value);
+			return true;
+		}
+
+		bool operator()(std::string& value) {
+			uint32_t size;
+			if (!(*this)(size) || offset + size > data.size()) {
+				return false;
+			}
+			value.assign(data, offset, size);
+			offset += size;
+			return true;
+		}
+
+		const std::string& data;
+		size_t offset;
+	};
+
+	// Everything but the sprite and brush pointers, the same list both ways
+	template<class Archive>
+	bool TransferItemType(Archive& ar, ItemType& t)
+	{
+		return ar(t.id) && ar(t.clientID) && ar(t.is_metaitem) && ar(t.has_raw) && ar(t.in_other_tileset) &&
+			ar(t.group) && ar(t.type) && ar(t.volume) && ar(t.maxTextLen) && ar(t.ground_equivalent) &&
+			ar(t.border_group) && ar(t.has_equivalent) && ar(t.wall_hate_me) &&
+			ar(t.name) && ar(t.editorsuffix) && ar(t.description) &&
+			ar(t.weight) && ar(t.attack) && ar(t.defense) && ar(t.armor) && ar(t.charges) &&
+			ar(t.client_chargeable) && ar(t.extra_chargeable) &&
+			ar(t.isVertical) && ar(t.isHorizontal) && ar(t.isHangable) && ar(t.canReadText) &&
+			ar(t.canWriteText) && ar(t.allowDistRead) && ar(t.replaceable) && ar(t.decays) &&
+			ar(t.stackable) && ar(t.moveable) && ar(t.alwaysOnBottom) && ar(t.pickupable) &&
+			ar(t.rotable) && ar(t.isBorder) && ar(t.isOptionalBorder) && ar(t.isWall) &&
+			ar(t.isBrushDoor) && ar(t.isOpen) && ar(t.isTable) && ar(t.isCarpet) &&
+			ar(t.floorChangeDown) && ar(t.floorChangeNorth) && ar(t.floorChangeSouth) &&
+			ar(t.floorChangeEast) && ar(t.floorChangeWest) &&
+			ar(t.blockSolid) && ar(t.blockPickupable) && ar(t.blockProjectile) && ar(t.blockPathFind) &&
+			ar(t.alwaysOnTopOrder) && ar(t.rotateTo) && ar(t.border_alignment);
+	}
+}
+
+uint64_t ItemDatabase::CacheKey(const FileName& otbfile, const FileName& xmlfile)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = HashBytes(hash, &ITEM_CACHE_VERSION, sizeof(ITEM_CACHE_VERSION));
+
+	// items.xml skips a range of ids for older clients, items.otb is
+	// checked against the client when signatures are checked
+	const int32_t version = gui.GetCurrentVersionID();
+	const int32_t signatures = settings.getInteger(Config::CHECK_SIGNATURES);
+	hash = HashBytes(hash, &version, sizeof(version));
+	hash = HashBytes(hash, &signatures, sizeof(signatures));
+
+	hash = HashFile(hash, otbfile);
+	return HashFile(hash, xmlfile);
+}
+
+bool ItemDatabase::loadFromCache(const FileName& cachefile, uint64_t key)
+{
+	FileReadHandle file(nstr(cachefile.GetFullPath()));
+	std::string data;
+	if (!file.isOk() || !file.getRAW(data, file.size())) {
+		return false;
+	}
+
+	CacheReader reader(data);
+	char magic[4];
+	uint32_t version;
+	uint64_t storedKey;
+	uint32_t count;
+	if (!reader(magic) || memcmp(magic, ITEM_CACHE_MAGIC, 4) != 0 ||
+		!reader(version) || version != ITEM_CACHE_VERSION ||
+		!reader(storedKey) || storedKey != key) {
+		return false;
+	}
+
+	uint32_t major, minor, build;
+	uint16_t maxId;
+	if (!reader(major) || !reader(minor) || !reader(build) || !reader(maxId) || !reader(count)) {
+		return false;
+	}
+
+	std::vector<ItemType*> loaded;
+	loaded.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		ItemType* t = newd ItemType();
+		loaded.push_back(t);
+		if (!TransferItemType(reader, *t)) {
+			break;
+		}
+	}
+
+	if (loaded.size() != count || reader.offset != data.size()) {
+		for (ItemType* t : loaded) {
+			delete t;
+		}
+		return false;
+	}
+
+	MajorVersion = major;
+	MinorVersion = minor;
+	BuildNumber = build;
+	max_item_id = maxId;
+	for (ItemType* t : loaded) {
+		t->sprite = static_cast<GameSprite*>(gui.gfx.getSprite(t->clientID));
+		delete items[t->id];
+		items.set(t->id, t);
+	}
+	return true;
+}
+
+bool ItemDatabase::saveToCache(const FileName& cachefile, uint64_t key)
+{
+	uint32_t count = 0;
+	for (size_t id = 0; id < items.size(); ++id) {
+		if (items[id]) {
+			++count;
+		}
+	}
+
+	CacheWriter writer;
+	writer(ITEM_CACHE_MAGIC);
+	writer(ITEM_CACHE_VERSION);
+	writer(key);
+	writer(MajorVersion);
+	writer(MinorVersion);
+	writer(BuildNumber);
+	writer(max_item_id);
+	writer(count);
+	for (size_t id = 0; id < items.size(); ++id) {
+		if (items[id]) {
+			TransferItemType(writer, *items[id]);
+		}
+	}
+
+	FileWriteHandle file(nstr(cachefile.GetFullPath()));
+	return file.isOk() && file.addRAW(writer.data) && file.isOk();
+}
+
 ItemType& ItemDatabase::getItemType(int id)
 {
 	ItemType* it = items[id];
@@ -352,6 +352,14 @@ public:
 	bool loadItemFromGameXml(pugi::xml_node itemNode, int id);
 	bool loadMetaItem(pugi::xml_node node);
 
+	// A binary copy of what items.otb and items.xml load into, saved after
+	// parsing them. The key covers the contents of both files, the client
+	// version and the settings that change the result, so any change to
+	// them makes the cache miss and the files are parsed again.
+	static uint64_t CacheKey(const FileName& otbfile, const FileName& xmlfile);
+	bool loadFromCache(const FileName& cachefile, uint64_t key);
+	bool saveToCache(const FileName& cachefile, uint64_t key);
+
 	//typedef std::map<int32_t, ItemType*> ItemMap;
 	typedef contigous_vector<ItemType*> ItemMap;
 	typedef std::map<std::string, ItemType*> ItemNameMap;
@@ -12,7 +12,7 @@
 #include <wx/event.h>
 
 LiveClient::LiveClient() : LiveSocket(),
-	readMessage(), queryNodeList(), currentOperation(),
+	readMessage(), queryNodeList(), currentOperation(), pendingCursor(), hasPendingCursor(false),
 	resolver(nullptr), socket(nullptr), editor(nullptr), stopped(false)
 {
 	//
@@ -127,6 +127,10 @@ void LiveClient::close()
 		socket->close();
 	}
 
+	if (cursorTimer) {
+		cursorTimer->cancel();
+	}
+
 	if (log) {
 		log->Message(wxT("Disconnected from server."));
 		log->Disconnect();
@@ -161,6 +165,8 @@ std::string LiveClient::getHostName() const
 
 void LiveClient::receiveHeader()
 {
+	// The last message was moved out for parsing
+	readMessage.buffer.resize(4);
 	readMessage.position = 0;
 	boost::asio::async_read(*socket,
 		boost::asio::buffer(readMessage.buffer, 4),
@@ -215,23 +221,116 @@ void LiveClient::send(NetworkMessage& message)
 
 void LiveClient::updateCursor(const Position& position)
 {
-	LiveCursor cursor;
-	cursor.id = 77; // Unimportant, server fixes it for us
-	cursor.pos = position;
-	cursor.color = wxColor(
+	pendingCursor.id = 77; // Unimportant, server fixes it for us
+	pendingCursor.pos = position;
+	pendingCursor.color = wxColor(
 		settings.getInteger(Config::CURSOR_RED),
 		settings.getInteger(Config::CURSOR_GREEN),
 		settings.getInteger(Config::CURSOR_BLUE),
 		settings.getInteger(Config::CURSOR_ALPHA)
 	);
+	hasPendingCursor = true;
+
+	scheduleCursorFlush();
+}
+
+void LiveClient::flushCursors()
+{
+	if (stopped || !hasPendingCursor) {
+		return;
+	}
+	hasPendingCursor = false;
 
 	NetworkMessage message;
 	message.write<uint8_t>(PACKET_CLIENT_UPDATE_CURSOR);
-	writeCursor(message, cursor);
+	writeCursor(message, pendingCursor);
 
 	send(message);
 }
 
+void LiveClient::updateViewport(int32_t startX, int32_t startY, int32_t endX, int32_t endY, int32_t topZ, int32_t bottomZ)
+{
+	LiveViewport newViewport;
+	newViewport.startX = std::max<int32_t>(0, startX) >> 2;
+	newViewport.startY = std::max<int32_t>(0, startY) >> 2;
+	newViewport.endX = std::max<int32_t>(0, endX) >> 2;
+	newViewport.endY = std::max<int32_t>(0, endY) >> 2;
+	newViewport.topZ = topZ;
+	newViewport.bottomZ = bottomZ;
+
+	if (hasViewport && newViewport == viewport) {
+		return;
+	}
+
+	const bool joining = !hasViewport;
+	viewport = newViewport;
+	hasViewport = true;
+
+	if (!joining) {
+		dropDistantNodes();
+	}
+
+	NetworkMessage message;
+	message.write<uint8_t>(PACKET_CLIENT_UPDATE_VIEWPORT);
+	writeViewport(message, viewport);
+
+	send(message);
+
+	// The server bounds the snapshot by the view it was told about first
+	if (joining) {
+		requestSnapshot();
+	}
+}
+
+void LiveClient::requestSnapshot()
+{
+	// Everything the server keeps in sync around the first view, in one go
+	Map& map = editor->map;
+
+	LiveViewport region = getSnapshotRegion(viewport, map.getWidth(), map.getHeight());
+
+	// The snapshot covers all of these, don't ask for them one by one meanwhile
+	for (int32_t ndx = region.startX; ndx <= region.endX; ++ndx) {
+		for (int32_t ndy = region.startY; ndy <= region.endY; ++ndy) {
+			QTreeNode* node = map.createLeaf(ndx * 4, ndy * 4);
+			for (int32_t layer = 0; layer < 2; ++layer) {
+				bool underground = layer != 0;
+				if (isInsideInterest(region, ndx, ndy, underground, 0)) {
+					node->setRequested(underground, true);
+				}
+			}
+		}
+	}
+
+	NetworkMessage message;
+	message.write<uint8_t>(PACKET_REQUEST_SNAPSHOT);
+	writeViewport(message, region);
+
+	send(message);
+	gui.SetStatusText(wxT("Receiving map..."));
+}
+
+void LiveClient::dropDistantNodes()
+{
+	for (auto it = knownNodes.begin(); it != knownNodes.end();) {
+		int32_t ndx = *it >> 18;
+		int32_t ndy = (*it >> 4) & 0x3FFF;
+		bool underground = *it & 1;
+
+		if (isInsideInterest(viewport, ndx, ndy, underground, DROP_RING)) {
+			++it;
+			continue;
+		}
+
+		QTreeNode* node = editor->map.getLeaf(ndx * 4, ndy * 4);
+		if (node) {
+			node->setVisible(underground, false);
+			node->setRequested(underground, false);
+		}
+		it = knownNodes.erase(it);
+	}
+}
+
 LiveLogTab* LiveClient::createLogWindow(wxWindow* parent)
 {
 	MapTabbook* mtb = dynamic_cast<MapTabbook*>(parent);
@@ -363,9 +462,15 @@ void LiveClient::parsePacket(NetworkMessage message)
 			case PACKET_NODE:
 				parseNode(message);
 				break;
+			case PACKET_SNAPSHOT:
+				parseSnapshot(message);
+				break;
 			case PACKET_CURSOR_UPDATE:
 				parseCursorUpdate(message);
 				break;
+			case PACKET_CURSOR_LIST:
+				parseCursorList(message);
+				break;
 			case PACKET_START_OPERATION:
 				parseStartOperation(message);
 				break;
@@ -441,10 +546,80 @@ void LiveClient::parseNode(NetworkMessage& message)
 	int32_t ndy = (ind >> 4) & 0x3FFF;
 	bool underground = ind & 1;
 
+	// Leaves of the prefetch ring are pushed before we ever asked for them
+	editor->map.createLeaf(ndx * 4, ndy * 4);
+
 	Action* action = editor->actionQueue->createAction(ACTION_REMOTE);
 	receiveNode(message, *editor, action, ndx, ndy, underground);
 	editor->actionQueue->addAction(action);
 
+	// The server stops updating leaves outside the interest area, so a node that
+	// arrives after we scrolled away from it can't be trusted to stay current.
+	if (hasViewport && !isInsideInterest(viewport, ndx, ndy, underground, DROP_RING)) {
+		QTreeNode* node = editor->map.getLeaf(ndx * 4, ndy * 4);
+		if (node) {
+			node->setVisible(underground, false);
+			node->setRequested(underground, false);
+		}
+	} else {
+		knownNodes.insert(ind);
+	}
+
+	gui.RefreshView();
+	gui.UpdateMinimap();
+}
+
+void LiveClient::parseSnapshot(NetworkMessage& message)
+{
+	uint32_t chunk = message.read<uint32_t>();
+	uint32_t chunkCount = message.read<uint32_t>();
+	uint32_t size = message.read<uint32_t>();
+
+	uint32_t length;
+	const uint8_t* data = message.readBytes(length);
+	if (!data || size > SNAPSHOT_CHUNK_MAX_SIZE) {
+		logMessage(wxT("Received a broken map snapshot, disconnecting."));
+		close();
+		return;
+	}
+
+	NetworkMessage body;
+	body.buffer.resize(4 + size);
+	if (!decompressData(data, length, body.buffer.data() + 4, size)) {
+		logMessage(wxT("Received a broken map snapshot, disconnecting."));
+		close();
+		return;
+	}
+
+	Map& map = editor->map;
+	Action* action = editor->actionQueue->createAction(ACTION_REMOTE);
+	while (body.position < body.buffer.size()) {
+		uint32_t ind = body.read<uint32_t>();
+
+		int32_t ndx = ind >> 18;
+		int32_t ndy = (ind >> 4) & 0x3FFF;
+		bool underground = ind & 1;
+
+		map.createLeaf(ndx * 4, ndy * 4);
+		receiveNode(body, *editor, action, ndx, ndy, underground);
+
+		// Same as for single nodes, the view may have moved on while this was in flight
+		if (isInsideInterest(viewport, ndx, ndy, underground, DROP_RING)) {
+			knownNodes.insert(ind);
+		} else {
+			QTreeNode* node = map.getLeaf(ndx * 4, ndy * 4);
+			node->setVisible(underground, false);
+			node->setRequested(underground, false);
+		}
+	}
+	editor->actionQueue->addAction(action);
+
+	if (chunk + 1 >= chunkCount) {
+		gui.SetStatusText(wxT("Map received."));
+	} else {
+		gui.SetStatusText(wxString::Format(wxT("Receiving map... (%d%%)"), (chunk + 1) * 100 / chunkCount));
+	}
+
 	gui.RefreshView();
 	gui.UpdateMinimap();
 }
@@ -457,6 +632,17 @@ void LiveClient::parseCursorUpdate(NetworkMessage& message)
 	gui.RefreshView();
 }
 
+void LiveClient::parseCursorList(NetworkMessage& message)
+{
+	uint16_t count = message.read<uint16_t>();
+	for (uint16_t i = 0; i < count; ++i) {
+		LiveCursor cursor = readCursor(message);
+		cursors[cursor.id] = cursor;
+	}
+
+	gui.RefreshView();
+}
+
 void LiveClient::parseStartOperation(NetworkMessage& message)
 {
 	const std::string& operation = message.read<std::string>();
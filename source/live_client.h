@@ -36,6 +36,7 @@ class LiveClient : public LiveSocket
 
 		//
 		void updateCursor(const Position& position);
+		void updateViewport(int32_t startX, int32_t startY, int32_t endX, int32_t endY, int32_t topZ, int32_t bottomZ);
 
 		LiveLogTab* createLogWindow(wxWindow* parent);
 		MapTab* createEditorWindow();
@@ -53,6 +54,15 @@ class LiveClient : public LiveSocket
 	protected:
 		void parsePacket(NetworkMessage message);
 
+		// Asks for the whole interest area of the first view as one bulk transfer
+		void requestSnapshot();
+
+		// Hides leaves outside the interest area, mirrors what the server does
+		void dropDistantNodes();
+
+		// Sends the newest cursor position, at most once per cursor tick
+		void flushCursors();
+
 		// parse packets
 		void parseHello(NetworkMessage& message);
 		void parseKick(NetworkMessage& message);
@@ -60,7 +70,9 @@ class LiveClient : public LiveSocket
 		void parseChangeClientVersion(NetworkMessage& message);
 		void parseServerTalk(NetworkMessage& message);
 		void parseNode(NetworkMessage& message);
+		void parseSnapshot(NetworkMessage& message);
 		void parseCursorUpdate(NetworkMessage& message);
+		void parseCursorList(NetworkMessage& message);
 		void parseStartOperation(NetworkMessage& message);
 		void parseUpdateOperation(NetworkMessage& message);
 
@@ -70,6 +82,9 @@ class LiveClient : public LiveSocket
 		std::set<uint32_t> queryNodeList;
 		wxString currentOperation;
 
+		LiveCursor pendingCursor;
+		bool hasPendingCursor;
+
 		std::shared_ptr<boost::asio::ip::tcp::resolver> resolver;
 		std::shared_ptr<boost::asio::ip::tcp::socket> socket;
 
@@ -0,0 +1,270 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "live_journal.h"
+#include "action.h"
+#include "editor.h"
+#include "map.h"
+
+static const char journalIdentifier[] = "RMEJ";
+
+LiveJournal::LiveJournal() :
+	path(), file(nullptr), tileRecords(), buffer(),
+	records(0), lastError()
+{
+	//
+}
+
+LiveJournal::~LiveJournal()
+{
+	close();
+}
+
+bool LiveJournal::open(const std::string& newPath)
+{
+	close();
+	path = newPath;
+
+	// An existing journal is continued, as long as it's really one
+	size_t existingSize = 0;
+	size_t completeSize = 0;
+	records = 0;
+	{
+		FileReadHandle existing(path);
+		if (existing.isOk() && existing.size() > 0) {
+			uint8_t identifier[4];
+			uint32_t version = 0;
+			if (!existing.getRAW(identifier, 4) || memcmp(identifier, journalIdentifier, 4) != 0 || !existing.getU32(version)) {
+				lastError = wxT("The file is not a live journal.");
+				return false;
+			}
+
+			if (version != VERSION) {
+				lastError = wxString::Format(wxT("Unsupported journal version %d."), version);
+				return false;
+			}
+			existingSize = existing.size();
+			completeSize = existing.tell();
+
+			// Records appended after a torn one would never be replayed
+			uint32_t size;
+			while (completeSize + RECORD_HEADER_SIZE <= existingSize && existing.getU32(size)) {
+				if (size > existingSize - completeSize - RECORD_HEADER_SIZE) {
+					break;
+				}
+				completeSize += RECORD_HEADER_SIZE + size;
+				if (!existing.seek(completeSize)) {
+					break;
+				}
+				++records;
+			}
+		}
+	}
+
+	if (completeSize < existingSize && !cutAt(completeSize)) {
+		return false;
+	}
+
+	file = newd FileWriteHandle(path, true);
+	if (!file->isOk()) {
+		lastError = wxT("Could not open the journal for writing.");
+		close();
+		return false;
+	}
+
+	if (existingSize == 0 && !writeHeader()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void LiveJournal::close()
+{
+	delete file;
+	file = nullptr;
+}
+
+bool LiveJournal::truncate()
+{
+	if (!file) {
+		return false;
+	}
+
+	delete file;
+	file = newd FileWriteHandle(path, false);
+	records = 0;
+
+	if (!file->isOk()) {
+		lastError = wxT("Could not reopen the journal.");
+		close();
+		return false;
+	}
+	return writeHeader();
+}
+
+bool LiveJournal::cutAt(size_t size)
+{
+	// There is no portable way to shorten a file, the complete part is
+	// copied aside and replaces the journal
+	const std::string cutPath = path + ".tmp";
+	{
+		FileReadHandle source(path);
+		FileWriteHandle target(cutPath, false);
+		if (!source.isOk() || !target.isOk()) {
+			lastError = wxT("Could not cut the incomplete record off the journal.");
+			return false;
+		}
+
+		std::vector<uint8_t> buffer(64 * 1024);
+		for (size_t copied = 0; copied < size;) {
+			const size_t chunk = std::min(buffer.size(), size - copied);
+			if (!source.getRAW(&buffer[0], chunk)) {
+				lastError = wxT("Could not read the journal.");
+				return false;
+			}
+			target.addRAW(&buffer[0], chunk);
+			copied += chunk;
+		}
+		target.flush();
+		if (!target.isOk()) {
+			lastError = wxT("Could not cut the incomplete record off the journal.");
+			return false;
+		}
+	}
+
+	if (!wxRenameFile(wxstr(cutPath), wxstr(path), true)) {
+		wxRemoveFile(wxstr(cutPath));
+		lastError = wxT("Could not replace the journal.");
+		return false;
+	}
+	return true;
+}
+
+bool LiveJournal::writeHeader()
+{
+	file->addRAW(reinterpret_cast<const uint8_t*>(journalIdentifier), 4);
+	file->addU32(VERSION);
+	file->flush();
+
+	if (!file->isOk()) {
+		lastError = wxT("Could not write the journal header.");
+		return false;
+	}
+	return true;
+}
+
+void LiveJournal::record(Map& map, DirtyList& dirtyList)
+{
+	if (!file) {
+		return;
+	}
+
+	// The dirty list only knows the floors of every leaf that changed, the
+	// whole floor is written so replaying needs nothing but the record.
+	uint32_t tileCount = 0;
+	buffer.clear();
+	for (const auto& ind : dirtyList.GetPosList()) {
+		int32_t ndx = ind.pos >> 18;
+		int32_t ndy = (ind.pos >> 4) & 0x3FFF;
+
+		for (int32_t z = 0; z < 16; ++z) {
+			if (!testFlags(ind.floors, 1 << z)) {
+				continue;
+			}
+
+			for (int32_t x = 0; x < 4; ++x) {
+				for (int32_t y = 0; y < 4; ++y) {
+					Position position(ndx * 4 + x, ndy * 4 + y, z);
+					tileRecords.write(buffer, map.getTile(position), &position);
+					++tileCount;
+				}
+			}
+		}
+	}
+	if (tileCount == 0) {
+		return;
+	}
+
+	const uint64_t timestamp = wxGetUTCTimeMillis().GetValue();
+	file->addU32(buffer.size());
+	file->addU64(timestamp);
+	file->addU32(dirtyList.owner);
+	file->addU32(tileCount);
+	file->addRAW(buffer.data(), buffer.size());
+
+	// Flushed right away, the journal is only useful if it survives a crash
+	file->flush();
+	++records;
+}
+
+bool LiveJournal::replay(const std::string& path, Editor& editor, LiveJournalReplay& result, wxString& error)
+{
+	FileReadHandle file(path);
+	if (!file.isOk()) {
+		error = wxT("Could not open the journal.");
+		return false;
+	}
+
+	uint8_t identifier[4];
+	uint32_t version = 0;
+	if (!file.getRAW(identifier, 4) || memcmp(identifier, journalIdentifier, 4) != 0 || !file.getU32(version)) {
+		error = wxT("The file is not a live journal.");
+		return false;
+	}
+
+	if (version != VERSION) {
+		error = wxString::Format(wxT("Unsupported journal version %d."), version);
+		return false;
+	}
+
+	TileRecordReader tileRecords;
+	std::vector<uint8_t> buffer;
+
+	wxStopWatch watch;
+	watch.Pause();
+
+	while (file.tell() + RECORD_HEADER_SIZE <= file.size()) {
+		uint32_t size, owner, tileCount;
+		uint64_t timestamp;
+		file.getU32(size);
+		file.getRAW(reinterpret_cast<uint8_t*>(&timestamp), 8);
+		file.getU32(owner);
+		file.getU32(tileCount);
+
+		if (file.tell() + size > file.size()) {
+			break;
+		}
+
+		buffer.resize(size);
+		if (size > 0 && !file.getRAW(buffer.data(), size)) {
+			break;
+		}
+
+		watch.Resume();
+		Action* action = editor.actionQueue->createAction(ACTION_REMOTE);
+		size_t offset = 0;
+		while (offset < buffer.size()) {
+			// Every record carries its position
+			Tile* tile = nullptr;
+			if (!tileRecords.read(buffer.data(), buffer.size(), offset, editor.map, nullptr, nullptr, tile)) {
+				break;
+			}
+			if (tile) {
+				action->addChange(newd Change(tile));
+				++result.tiles;
+			}
+		}
+
+		editor.actionQueue->addAction(action);
+		watch.Pause();
+		++result.records;
+	}
+
+	result.seconds = watch.Time() / 1000.0;
+	result.truncated = file.tell() < file.size();
+	return true;
+}
@@ -0,0 +1,78 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _RME_LIVE_JOURNAL_H_
+#define _RME_LIVE_JOURNAL_H_
+
+#include "filehandle.h"
+#include "tile_record.h"
+
+class Map;
+class Editor;
+class DirtyList;
+
+struct LiveJournalReplay
+{
+	LiveJournalReplay() : records(0), tiles(0), seconds(0.0), truncated(false) {}
+
+	uint32_t records;
+	uint64_t tiles;
+	double seconds; // spent decoding and applying, file reading excluded
+	bool truncated; // the last record was cut off, usually by a crash
+};
+
+// Append-only record of every change set the live server applies. Each
+// record holds the complete contents of the floors the change set
+// touched as tile records, spawns and creatures included, so replaying
+// the records in order on top of the last saved map brings it to the
+// state of the session.
+//
+//   header: "RMEJ", u32 version
+//   record: u32 size, u64 UTC milliseconds, u32 owner, u32 tile count, tile records
+class LiveJournal
+{
+	public:
+		LiveJournal();
+		~LiveJournal();
+
+		// Appends to the journal at path, or starts a new one. A record
+		// torn by a crash is cut off first
+		bool open(const std::string& path);
+		void close();
+		bool isOpen() const {
+			return file != nullptr;
+		}
+
+		// Drops all records, called once they are part of the saved map
+		bool truncate();
+
+		void record(Map& map, DirtyList& dirtyList);
+
+		uint32_t getRecordCount() const {
+			return records;
+		}
+		const wxString& getLastError() const {
+			return lastError;
+		}
+
+		// Applies every record of the journal to the editor's map
+		static bool replay(const std::string& path, Editor& editor, LiveJournalReplay& result, wxString& error);
+
+		static const uint32_t VERSION = 2;
+		static const size_t RECORD_HEADER_SIZE = 4 + 8 + 4 + 4;
+
+	protected:
+		bool cutAt(size_t size);
+		bool writeHeader();
+
+		std::string path;
+		FileWriteHandle* file;
+		TileRecordWriter tileRecords;
+		std::vector<uint8_t> buffer;
+
+		uint32_t records;
+		wxString lastError;
+};
+
+#endif
@@ -0,0 +1,609 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "live_loadtest.h"
+#include "iomap_otbm.h"
+
+// Size of the simulated screen in leaves, about a maximized window at 100% zoom
+static const int32_t VIEW_WIDTH = 16;
+static const int32_t VIEW_HEIGHT = 10;
+static const uint32_t TICK_INTERVAL = 20;
+
+static double percentile(std::vector<double> values, double fraction)
+{
+	if (values.empty()) {
+		return 0.0;
+	}
+
+	std::sort(values.begin(), values.end());
+	size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+	return values[std::min(index, values.size() - 1)];
+}
+
+LiveLoadTestOptions::LiveLoadTestOptions() :
+	host("localhost"), port(31313), password(),
+	clients(10), duration(60),
+	panInterval(1000), cursorInterval(100), strokeInterval(500),
+	strokeItem(4526), strokeLength(8)
+{
+	//
+}
+
+// LiveLoadTest
+LiveLoadTest::LiveLoadTest(const LiveLoadTestOptions& options) :
+	options(options), service(), endTimer(service), clients(), elapsedSeconds(0)
+{
+	//
+}
+
+LiveLoadTest::~LiveLoadTest()
+{
+	for (LiveLoadClient* client : clients) {
+		delete client;
+	}
+}
+
+bool LiveLoadTest::run()
+{
+	boost::system::error_code error;
+	boost::asio::ip::tcp::resolver resolver(service);
+	boost::asio::ip::tcp::resolver::query query(options.host, std::to_string(options.port));
+
+	boost::asio::ip::tcp::resolver::iterator endpoints = resolver.resolve(query, error);
+	if (error) {
+		std::cout << "Could not resolve " << options.host << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	std::cout << "Connecting " << options.clients << " clients to " << options.host << ":" << options.port
+		<< " for " << options.duration << " seconds..." << std::endl;
+
+	for (uint32_t index = 0; index < options.clients; ++index) {
+		LiveLoadClient* client = newd LiveLoadClient(*this, index);
+		clients.push_back(client);
+
+		// A team never connects in the same millisecond, stagger the joins a bit
+		client->start(endpoints, index * 100);
+	}
+
+	endTimer.expires_from_now(boost::posix_time::seconds(options.duration));
+	endTimer.async_wait([this](const boost::system::error_code& error) -> void {
+		finish();
+	});
+
+	const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+	service.run();
+	elapsedSeconds = (boost::posix_time::microsec_clock::universal_time() - startTime).total_milliseconds() / 1000.0;
+
+	for (LiveLoadClient* client : clients) {
+		if (client->hasJoined()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void LiveLoadTest::finish()
+{
+	for (LiveLoadClient* client : clients) {
+		client->stop();
+	}
+}
+
+void LiveLoadTest::printReport(std::ostream& out) const
+{
+	const double seconds = std::max(elapsedSeconds, 0.001);
+
+	out << std::endl;
+	out << std::left << std::setw(16) << "Client"
+		<< std::right << std::setw(8) << "Nodes"
+		<< std::setw(9) << "Strokes"
+		<< std::setw(9) << "Cursors"
+		<< std::setw(9) << "Join ms"
+		<< std::setw(9) << "p50 ms"
+		<< std::setw(9) << "p95 ms"
+		<< std::setw(9) << "p99 ms"
+		<< std::setw(11) << "KiB/s in"
+		<< std::setw(11) << "KiB/s out" << std::endl;
+
+	std::vector<double> allLatencies;
+	std::vector<double> snapshotTimes;
+	uint64_t totalReceived = 0;
+	uint64_t totalSent = 0;
+	uint32_t totalNodes = 0;
+	uint32_t totalStrokes = 0;
+	uint32_t totalCursors = 0;
+	uint32_t joinedClients = 0;
+
+	out << std::fixed << std::setprecision(1);
+	for (const LiveLoadClient* client : clients) {
+		out << std::left << std::setw(16) << client->name
+			<< std::right << std::setw(8) << client->nodesReceived
+			<< std::setw(9) << client->strokesSent
+			<< std::setw(9) << client->cursorsReceived
+			<< std::setw(9) << client->snapshotTime
+			<< std::setw(9) << percentile(client->latencies, 0.50)
+			<< std::setw(9) << percentile(client->latencies, 0.95)
+			<< std::setw(9) << percentile(client->latencies, 0.99)
+			<< std::setw(11) << client->bytesReceived / 1024.0 / seconds
+			<< std::setw(11) << client->bytesSent / 1024.0 / seconds;
+		if (!client->error.empty()) {
+			out << "  " << client->error;
+		}
+		out << std::endl;
+
+		allLatencies.insert(allLatencies.end(), client->latencies.begin(), client->latencies.end());
+		totalReceived += client->bytesReceived;
+		totalSent += client->bytesSent;
+		totalNodes += client->nodesReceived;
+		totalStrokes += client->strokesSent;
+		totalCursors += client->cursorsReceived;
+		if (client->hasJoined()) {
+			++joinedClients;
+		}
+		if (client->snapshotTime > 0) {
+			snapshotTimes.push_back(client->snapshotTime);
+		}
+	}
+
+	out << std::left << std::setw(16) << "All"
+		<< std::right << std::setw(8) << totalNodes
+		<< std::setw(9) << totalStrokes
+		<< std::setw(9) << totalCursors
+		<< std::setw(9) << percentile(snapshotTimes, 0.50)
+		<< std::setw(9) << percentile(allLatencies, 0.50)
+		<< std::setw(9) << percentile(allLatencies, 0.95)
+		<< std::setw(9) << percentile(allLatencies, 0.99)
+		<< std::setw(11) << totalReceived / 1024.0 / seconds
+		<< std::setw(11) << totalSent / 1024.0 / seconds << std::endl;
+
+	out << std::endl << joinedClients << " of " << clients.size() << " clients joined, "
+		<< allLatencies.size() << " leaf round trips over " << seconds << " seconds." << std::endl;
+	out << "Join is the time until the join snapshot was in, the All row shows its median." << std::endl;
+	out << "Latency is measured from requesting a leaf until it arrives, see the server output for its CPU usage." << std::endl;
+	out.unsetf(std::ios::floatfield);
+}
+
+// LiveLoadClient
+LiveLoadClient::LiveLoadClient(LiveLoadTest& test, uint32_t index) :
+	name("loadtest-" + std::to_string(index + 1)), error(), latencies(), snapshotTime(0),
+	bytesSent(0), bytesReceived(0), nodesReceived(0), strokesSent(0), cursorsReceived(0),
+	test(test), socket(test.getService()), timer(test.getService()), endpoints(),
+	readMessage(), mapWriter(), clientVersion(0), joined(false), stopped(false),
+	mapWidth(0), mapHeight(0), viewport(), cursor(),
+	knownNodes(), pendingNodes(),
+	startTime(boost::posix_time::microsec_clock::universal_time()), joinTime(0),
+	nextPan(0), nextCursor(0), nextStroke(0)
+{
+	//
+}
+
+LiveLoadClient::~LiveLoadClient()
+{
+	//
+}
+
+void LiveLoadClient::start(boost::asio::ip::tcp::resolver::iterator endpoints, uint32_t delay)
+{
+	this->endpoints = endpoints;
+
+	timer.expires_from_now(boost::posix_time::milliseconds(delay));
+	timer.async_wait([this](const boost::system::error_code& error) -> void {
+		if (!error && !stopped) {
+			connect();
+		}
+	});
+}
+
+void LiveLoadClient::stop()
+{
+	stopped = true;
+
+	boost::system::error_code error;
+	timer.cancel(error);
+	socket.close(error);
+}
+
+void LiveLoadClient::fail(const std::string& reason)
+{
+	if (error.empty()) {
+		error = reason;
+	}
+	stop();
+}
+
+double LiveLoadClient::now() const
+{
+	return (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds() / 1000.0;
+}
+
+void LiveLoadClient::connect()
+{
+	boost::asio::async_connect(socket, endpoints, [this](const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator) -> void
+	{
+		if (stopped) {
+			return;
+		} else if (error) {
+			fail(error.message());
+			return;
+		}
+
+		boost::system::error_code optionError;
+		socket.set_option(boost::asio::ip::tcp::no_delay(true), optionError);
+
+		NetworkMessage message;
+		message.write<uint8_t>(PACKET_HELLO_FROM_CLIENT);
+		message.write<uint32_t>(__RME_VERSION_ID__);
+		message.write<uint32_t>(__LIVE_NET_VERSION__);
+		message.write<uint32_t>(clientVersion);
+		message.write<std::string>(name);
+		message.write<std::string>(test.getOptions().password);
+		send(message);
+
+		receiveHeader();
+	});
+}
+
+void LiveLoadClient::receiveHeader()
+{
+	readMessage.buffer.resize(4);
+	readMessage.position = 0;
+	boost::asio::async_read(socket,
+		boost::asio::buffer(readMessage.buffer, 4),
+		[this](const boost::system::error_code& error, size_t bytesTransferred) -> void {
+			if (stopped) {
+				return;
+			} else if (error) {
+				fail(error.message());
+			} else {
+				receive(readMessage.read<uint32_t>());
+			}
+		}
+	);
+}
+
+void LiveLoadClient::receive(uint32_t packetSize)
+{
+	readMessage.buffer.resize(readMessage.position + packetSize);
+	boost::asio::async_read(socket,
+		boost::asio::buffer(&readMessage.buffer[readMessage.position], packetSize),
+		[this](const boost::system::error_code& error, size_t bytesTransferred) -> void {
+			if (stopped) {
+				return;
+			} else if (error) {
+				fail(error.message());
+			} else {
+				bytesReceived += bytesTransferred + 4;
+
+				parsePacket(readMessage);
+				if (!stopped) {
+					receiveHeader();
+				}
+			}
+		}
+	);
+}
+
+void LiveLoadClient::send(NetworkMessage& message)
+{
+	memcpy(&message.buffer[0], &message.size, 4);
+
+	// The message goes out of scope before the write completes
+	auto buffer = std::make_shared<std::vector<uint8_t>>(message.buffer.begin(), message.buffer.begin() + message.size + 4);
+	bytesSent += buffer->size();
+
+	boost::asio::async_write(socket,
+		boost::asio::buffer(*buffer),
+		[this, buffer](const boost::system::error_code& error, size_t bytesTransferred) -> void {
+			if (error && !stopped) {
+				fail(error.message());
+			}
+		}
+	);
+}
+
+void LiveLoadClient::parsePacket(NetworkMessage& message)
+{
+	while (!stopped && message.position < message.buffer.size()) {
+		uint8_t packetType = message.read<uint8_t>();
+		switch (packetType) {
+			case PACKET_KICK: {
+				fail("Kicked: " + message.read<std::string>());
+				break;
+			}
+			case PACKET_CHANGE_CLIENT_VERSION: {
+				// The editor reloads its data files here, we have none to reload
+				clientVersion = message.read<uint32_t>();
+
+				NetworkMessage outMessage;
+				outMessage.write<uint8_t>(PACKET_READY_CLIENT);
+				send(outMessage);
+				break;
+			}
+			case PACKET_ACCEPTED_CLIENT: {
+				NetworkMessage outMessage;
+				outMessage.write<uint8_t>(PACKET_READY_CLIENT);
+				send(outMessage);
+				break;
+			}
+			case PACKET_HELLO_FROM_SERVER: {
+				message.read<std::string>();
+				mapWidth = message.read<uint16_t>();
+				mapHeight = message.read<uint16_t>();
+				joined = true;
+
+				// Everyone starts around the middle of the map so the views overlap
+				int32_t centerX = mapWidth / 2 + uniform_random(-128, 128);
+				int32_t centerY = mapHeight / 2 + uniform_random(-128, 128);
+				viewport.startX = std::max<int32_t>(0, (centerX >> 2) - VIEW_WIDTH / 2);
+				viewport.startY = std::max<int32_t>(0, (centerY >> 2) - VIEW_HEIGHT / 2);
+				viewport.endX = viewport.startX + VIEW_WIDTH;
+				viewport.endY = viewport.startY + VIEW_HEIGHT;
+				cursor = Position(centerX, centerY, 7);
+
+				// The server bounds the snapshot by the view it was told about
+				joinTime = now();
+				sendViewport();
+				requestSnapshot();
+				pan();
+				scheduleTick();
+				break;
+			}
+			case PACKET_NODE:
+				parseNode(message);
+				break;
+			case PACKET_SNAPSHOT:
+				parseSnapshot(message);
+				break;
+			case PACKET_CURSOR_UPDATE: {
+				message.read<uint32_t>();
+				message.read<uint32_t>();
+				message.read<Position>();
+				++cursorsReceived;
+				break;
+			}
+			case PACKET_CURSOR_LIST: {
+				uint16_t count = message.read<uint16_t>();
+				for (uint16_t i = 0; i < count; ++i) {
+					message.read<uint32_t>();
+					message.read<uint32_t>();
+					message.read<Position>();
+				}
+				cursorsReceived += count;
+				break;
+			}
+			case PACKET_SERVER_TALK: {
+				message.read<std::string>();
+				message.read<std::string>();
+				break;
+			}
+			case PACKET_START_OPERATION:
+				message.read<std::string>();
+				break;
+			case PACKET_UPDATE_OPERATION:
+				message.read<uint32_t>();
+				break;
+			default:
+				// Can't know the size of it, skip the rest of the message
+				message.position = message.buffer.size();
+				break;
+		}
+	}
+}
+
+void LiveLoadClient::parseNode(NetworkMessage& message)
+{
+	uint32_t ind = message.read<uint32_t>();
+
+	// Skip the tile data, only the arrival matters here
+	uint16_t floorBits = message.read<uint16_t>();
+	for (uint32_t z = 0; z < 16; ++z) {
+		if (testFlags(floorBits, 1 << z)) {
+			uint16_t tileBits = message.read<uint16_t>();
+			if (tileBits != 0) {
+				message.position += message.read<uint16_t>();
+			}
+		}
+	}
+	++nodesReceived;
+
+	auto it = pendingNodes.find(ind);
+	if (it != pendingNodes.end()) {
+		latencies.push_back(now() - it->second);
+		pendingNodes.erase(it);
+	}
+
+	int32_t ndx = ind >> 18;
+	int32_t ndy = (ind >> 4) & 0x3FFF;
+	if (LiveSocket::isInsideInterest(viewport, ndx, ndy, ind & 1, LiveSocket::DROP_RING)) {
+		knownNodes.insert(ind);
+	}
+}
+
+void LiveLoadClient::requestSnapshot()
+{
+	LiveViewport region = LiveSocket::getSnapshotRegion(viewport, mapWidth, mapHeight);
+
+	// The snapshot brings all of these, same as the editor they aren't requested again
+	for (int32_t ndx = region.startX; ndx <= region.endX; ++ndx) {
+		for (int32_t ndy = region.startY; ndy <= region.endY; ++ndy) {
+			knownNodes.insert(LiveSocket::getNodeIndex(ndx, ndy, false));
+		}
+	}
+
+	NetworkMessage message;
+	message.write<uint8_t>(PACKET_REQUEST_SNAPSHOT);
+	message.write<uint16_t>(region.startX);
+	message.write<uint16_t>(region.startY);
+	message.write<uint16_t>(region.endX);
+	message.write<uint16_t>(region.endY);
+	message.write<uint8_t>(region.topZ);
+	message.write<uint8_t>(region.bottomZ);
+	send(message);
+}
+
+void LiveLoadClient::parseSnapshot(NetworkMessage& message)
+{
+	uint32_t chunk = message.read<uint32_t>();
+	uint32_t chunkCount = message.read<uint32_t>();
+	message.read<uint32_t>();
+
+	uint32_t length;
+	message.readBytes(length);
+
+	if (chunk + 1 >= chunkCount) {
+		snapshotTime = now() - joinTime;
+	}
+}
+
+void LiveLoadClient::scheduleTick()
+{
+	timer.expires_from_now(boost::posix_time::milliseconds(TICK_INTERVAL));
+	timer.async_wait([this](const boost::system::error_code& error) -> void {
+		if (error || stopped) {
+			return;
+		}
+		tick();
+		scheduleTick();
+	});
+}
+
+void LiveLoadClient::tick()
+{
+	const LiveLoadTestOptions& options = test.getOptions();
+	const double time = now();
+
+	if (time >= nextPan) {
+		pan();
+		nextPan = time + options.panInterval;
+	}
+
+	if (time >= nextCursor) {
+		moveCursor();
+		nextCursor = time + options.cursorInterval;
+	}
+
+	if (options.strokeItem != 0 && time >= nextStroke) {
+		paintStroke();
+		nextStroke = time + options.strokeInterval;
+	}
+}
+
+void LiveLoadClient::sendViewport()
+{
+	NetworkMessage message;
+	message.write<uint8_t>(PACKET_CLIENT_UPDATE_VIEWPORT);
+	message.write<uint16_t>(viewport.startX);
+	message.write<uint16_t>(viewport.startY);
+	message.write<uint16_t>(viewport.endX);
+	message.write<uint16_t>(viewport.endY);
+	message.write<uint8_t>(viewport.topZ);
+	message.write<uint8_t>(viewport.bottomZ);
+	send(message);
+}
+
+void LiveLoadClient::pan()
+{
+	const int32_t maxX = std::max<int32_t>(0, ((mapWidth - 1) >> 2) - VIEW_WIDTH);
+	const int32_t maxY = std::max<int32_t>(0, ((mapHeight - 1) >> 2) - VIEW_HEIGHT);
+
+	viewport.startX = std::max<int32_t>(0, std::min<int32_t>(maxX, viewport.startX + uniform_random(-3, 3)));
+	viewport.startY = std::max<int32_t>(0, std::min<int32_t>(maxY, viewport.startY + uniform_random(-3, 3)));
+	viewport.endX = viewport.startX + VIEW_WIDTH;
+	viewport.endY = viewport.startY + VIEW_HEIGHT;
+
+	// Forget the leaves the server stops updating, like the editor does
+	for (auto it = knownNodes.begin(); it != knownNodes.end();) {
+		int32_t ndx = *it >> 18;
+		int32_t ndy = (*it >> 4) & 0x3FFF;
+		if (LiveSocket::isInsideInterest(viewport, ndx, ndy, *it & 1, LiveSocket::DROP_RING)) {
+			++it;
+		} else {
+			it = knownNodes.erase(it);
+		}
+	}
+
+	sendViewport();
+
+	// The editor asks for every leaf it draws that it doesn't have yet
+	const double time = now();
+	std::vector<uint32_t> requests;
+	for (int32_t ndx = viewport.startX; ndx <= viewport.endX; ++ndx) {
+		for (int32_t ndy = viewport.startY; ndy <= viewport.endY; ++ndy) {
+			uint32_t ind = LiveSocket::getNodeIndex(ndx, ndy, false);
+			if (knownNodes.count(ind) == 0 && pendingNodes.count(ind) == 0) {
+				pendingNodes[ind] = time;
+				requests.push_back(ind);
+			}
+		}
+	}
+
+	if (requests.empty()) {
+		return;
+	}
+
+	NetworkMessage requestMessage;
+	requestMessage.write<uint8_t>(PACKET_REQUEST_NODES);
+	requestMessage.write<uint32_t>(requests.size());
+	for (uint32_t ind : requests) {
+		requestMessage.write<uint32_t>(ind);
+	}
+	send(requestMessage);
+}
+
+void LiveLoadClient::moveCursor()
+{
+	const int32_t centerX = (viewport.startX + viewport.endX) * 2;
+	const int32_t centerY = (viewport.startY + viewport.endY) * 2;
+	cursor.x = std::max<int32_t>(0, centerX + uniform_random(-12, 12));
+	cursor.y = std::max<int32_t>(0, centerY + uniform_random(-8, 8));
+
+	NetworkMessage message;
+	message.write<uint8_t>(PACKET_CLIENT_UPDATE_CURSOR);
+	message.write<uint32_t>(77); // Server fixes it for us
+	message.write<uint8_t>(0xFF);
+	message.write<uint8_t>(0x80);
+	message.write<uint8_t>(0x00);
+	message.write<uint8_t>(0x80);
+	message.write<Position>(cursor);
+	send(message);
+}
+
+void LiveLoadClient::paintStroke()
+{
+	const LiveLoadTestOptions& options = test.getOptions();
+
+	// A straight drag from the cursor, the way a ground brush would paint it
+	const int32_t dx = uniform_random(-1, 1);
+	const int32_t dy = dx == 0 ? (uniform_random(0, 1) ? 1 : -1) : uniform_random(-1, 1);
+
+	mapWriter.reset();
+	for (uint32_t step = 0; step < options.strokeLength; ++step) {
+		int32_t x = cursor.x + dx * step;
+		int32_t y = cursor.y + dy * step;
+		if (x < 0 || y < 0 || x >= mapWidth || y >= mapHeight) {
+			break;
+		}
+
+		mapWriter.addNode(OTBM_TILE);
+		mapWriter.addU16(x);
+		mapWriter.addU16(y);
+		mapWriter.addU8(cursor.z);
+		mapWriter.addByte(OTBM_ATTR_ITEM);
+		mapWriter.addU16(options.strokeItem);
+		mapWriter.endNode();
+	}
+	mapWriter.endNode();
+
+	NetworkMessage message;
+	message.write<uint8_t>(PACKET_CHANGE_LIST);
+
+	std::string data(reinterpret_cast<const char*>(mapWriter.getMemory()), mapWriter.getSize());
+	message.write<std::string>(data);
+
+	send(message);
+	++strokesSent;
+}
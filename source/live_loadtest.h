@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef _RME_LIVE_LOADTEST_H_
+#define _RME_LIVE_LOADTEST_H_
+
+#include "live_socket.h"
+
+#include <memory>
+#include <unordered_map>
+
+struct LiveLoadTestOptions
+{
+	LiveLoadTestOptions();
+
+	std::string host;
+	uint16_t port;
+	std::string password;
+
+	uint32_t clients;
+	uint32_t duration; // seconds
+
+	// How often every simulated client does something, in milliseconds
+	uint32_t panInterval;
+	uint32_t cursorInterval;
+	uint32_t strokeInterval;
+
+	// Ground item painted by the simulated brush strokes, 0 disables painting
+	uint16_t strokeItem;
+	uint32_t strokeLength;
+};
+
+class LiveLoadClient;
+
+// Connects a number of simulated clients to a live server. Every client
+// joins like the editor does, then pans around, asks for the leaves it
+// scrolls into, moves its cursor and paints short strokes of ground.
+// Latency is the time between asking for a leaf and receiving it.
+class LiveLoadTest
+{
+	public:
+		LiveLoadTest(const LiveLoadTestOptions& options);
+		~LiveLoadTest();
+
+		// Runs the simulation to completion, returns false if no client could join
+		bool run();
+		void printReport(std::ostream& out) const;
+
+		boost::asio::io_service& getService() {
+			return service;
+		}
+		const LiveLoadTestOptions& getOptions() const {
+			return options;
+		}
+
+	protected:
+		void finish();
+
+		LiveLoadTestOptions options;
+		boost::asio::io_service service;
+		boost::asio::deadline_timer endTimer;
+		std::vector<LiveLoadClient*> clients;
+		double elapsedSeconds;
+};
+
+class LiveLoadClient
+{
+	public:
+		LiveLoadClient(LiveLoadTest& test, uint32_t index);
+		~LiveLoadClient();
+
+		void start(boost::asio::ip::tcp::resolver::iterator endpoints, uint32_t delay);
+		void stop();
+
+		bool hasJoined() const {
+			return joined;
+		}
+
+		// Results
+		std::string name;
+		std::string error;
+		std::vector<double> latencies; // milliseconds
+		double snapshotTime; // milliseconds from joining until the snapshot was in
+		uint64_t bytesSent;
+		uint64_t bytesReceived;
+		uint32_t nodesReceived;
+		uint32_t strokesSent;
+		uint32_t cursorsReceived;
+
+	protected:
+		void connect();
+		void receiveHeader();
+		void receive(uint32_t packetSize);
+		void send(NetworkMessage& message);
+		void fail(const std::string& reason);
+
+		void parsePacket(NetworkMessage& message);
+		void parseNode(NetworkMessage& message);
+		void parseSnapshot(NetworkMessage& message);
+
+		void requestSnapshot();
+
+		void scheduleTick();
+		void tick();
+		void sendViewport();
+		void pan();
+		void moveCursor();
+		void paintStroke();
+
+		double now() const;
+
+		LiveLoadTest& test;
+		boost::asio::ip::tcp::socket socket;
+		boost::asio::deadline_timer timer;
+		boost::asio::ip::tcp::resolver::iterator endpoints;
+		NetworkMessage readMessage;
+		MemoryNodeFileWriteHandle mapWriter;
+
+		uint32_t clientVersion;
+		bool joined;
+		bool stopped;
+
+		uint16_t mapWidth;
+		uint16_t mapHeight;
+		LiveViewport viewport;
+		Position cursor;
+
+		std::set<uint32_t> knownNodes;
+		std::unordered_map<uint32_t, double> pendingNodes;
+
+		boost::posix_time::ptime startTime;
+		double joinTime;
+		double nextPan;
+		double nextCursor;
+		double nextStroke;
+};
+
+#endif
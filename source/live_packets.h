@@ -13,12 +13,14 @@ enum LivePacketType
 
 	PACKET_REQUEST_NODES = 0x20,
 	PACKET_CHANGE_LIST = 0x21,
+	PACKET_REQUEST_SNAPSHOT = 0x22,
 	PACKET_ADD_HOUSE = 0x23,
 	PACKET_EDIT_HOUSE = 0x24,
 	PACKET_REMOVE_HOUSE = 0x25,
 
 	PACKET_CLIENT_TALK = 0x30,
 	PACKET_CLIENT_UPDATE_CURSOR = 0x31,
+	PACKET_CLIENT_UPDATE_VIEWPORT = 0x32,
 	
 	PACKET_HELLO_FROM_SERVER = 0x80,
 	PACKET_KICK = 0x81,
@@ -31,6 +33,8 @@ enum LivePacketType
 	PACKET_START_OPERATION = 0x92,
 	PACKET_UPDATE_OPERATION = 0x93,
 	PACKET_CHAT_MESSAGE = 0x94,
+	PACKET_SNAPSHOT = 0x95,
+	PACKET_CURSOR_LIST = 0x96,
 };
 
 #endif
@@ -10,9 +10,10 @@
 #include "live_action.h"
 
 #include "editor.h"
+#include "settings.h"
 
 LivePeer::LivePeer(LiveServer* server, boost::asio::ip::tcp::socket socket) : LiveSocket(),
-	readMessage(), server(server), socket(std::move(socket)), color(), id(0), clientId(0), connected(false)
+	readMessage(), writeQueue(), server(server), socket(std::move(socket)), color(), id(0), clientId(0), connected(false), snapshotSent(false)
 {
 	ASSERT(server != nullptr);
 }
@@ -49,6 +50,8 @@ std::string LivePeer::getHostName() const
 
 void LivePeer::receiveHeader()
 {
+	// The last message was moved out for parsing
+	readMessage.buffer.resize(4);
 	readMessage.position = 0;
 	boost::asio::async_read(socket,
 		boost::asio::buffer(readMessage.buffer, 4),
@@ -95,11 +98,32 @@ void LivePeer::receive(uint32_t packetSize)
 void LivePeer::send(NetworkMessage& message)
 {
 	memcpy(&message.buffer[0], &message.size, 4);
+
+	// The message dies with the caller and writes may not overlap on the socket,
+	// so a copy is queued and the network thread writes them one after another.
+	auto buffer = std::make_shared<std::vector<uint8_t>>(message.buffer.begin(), message.buffer.begin() + message.size + 4);
+	NetworkConnection::getInstance().get_service().post([this, buffer]() -> void {
+		writeQueue.push_back(buffer);
+		if (writeQueue.size() == 1) {
+			sendQueued();
+		}
+	});
+}
+
+void LivePeer::sendQueued()
+{
 	boost::asio::async_write(socket,
-		boost::asio::buffer(message.buffer, message.size + 4),
+		boost::asio::buffer(*writeQueue.front()),
 		[this](const boost::system::error_code& error, size_t bytesTransferred) -> void {
 			if (error) {
 				logMessage(wxString() + getHostName() + wxT(": ") + error.message());
+				writeQueue.clear();
+				return;
+			}
+
+			writeQueue.pop_front();
+			if (!writeQueue.empty()) {
+				sendQueued();
 			}
 		}
 	);
@@ -118,7 +142,7 @@ void LivePeer::parseLoginPacket(NetworkMessage message)
 				parseReady(message);
 				break;
 			default: {
-				log->Message(wxT("Invalid login packet receieved, connection severed."));
+				logMessage(wxT("Invalid login packet receieved, connection severed."));
 				close();
 				break;
 			}
@@ -138,6 +162,9 @@ void LivePeer::parseEditorPacket(NetworkMessage message)
 			case PACKET_CHANGE_LIST:
 				parseReceiveChanges(message);
 				break;
+			case PACKET_REQUEST_SNAPSHOT:
+				parseSnapshotRequest(message);
+				break;
 			case PACKET_ADD_HOUSE:
 				parseAddHouse(message);
 				break;
@@ -150,11 +177,14 @@ void LivePeer::parseEditorPacket(NetworkMessage message)
 			case PACKET_CLIENT_UPDATE_CURSOR:
 				parseCursorUpdate(message);
 				break;
+			case PACKET_CLIENT_UPDATE_VIEWPORT:
+				parseViewportUpdate(message);
+				break;
 			case PACKET_CLIENT_TALK:
 				parseChatMessage(message);
 				break;
 			default: {
-				log->Message(wxT("Invalid editor packet receieved, connection severed."));
+				logMessage(wxT("Invalid editor packet receieved, connection severed."));
 				close();
 				break;
 			}
@@ -196,13 +226,13 @@ void LivePeer::parseHello(NetworkMessage& message)
 	std::string password = message.read<std::string>();
 
 	if (server->getPassword() != wxString(password.c_str(), wxConvUTF8)) {
-		log->Message(wxT("Client tried to connect, but used the wrong password, connection refused."));
+		logMessage(wxT("Client tried to connect, but used the wrong password, connection refused."));
 		close();
 		return;
 	}
 
 	name = wxString(nickname.c_str(), wxConvUTF8);
-	log->Message(name + wxT(" (") + getHostName() + wxT(") connected."));
+	logMessage(name + wxT(" (") + getHostName() + wxT(") connected."));
 
 	NetworkMessage outMessage;
 	if (static_cast<ClientVersionID>(clientVersion) != gui.GetCurrentVersionID()) {
@@ -259,11 +289,107 @@ void LivePeer::parseNodeRequest(NetworkMessage& message)
 		int32_t ndy = (ind >> 4) & 0x3FFF;
 		bool underground = ind & 1;
 	
-		QTreeNode* node = map.createLeaf(ndx * 4, ndy * 4);
-		if (node) {
-			sendNode(clientId, node, ndx, ndy, underground ? 0xFF00 : 0x00FF);
+		QTreeNode* node = map.getLeaf(ndx * 4, ndy * 4);
+		sendNode(clientId, node, ndx, ndy, underground ? 0xFF00 : 0x00FF);
+	}
+}
+
+void LivePeer::parseSnapshotRequest(NetworkMessage& message)
+{
+	// The region in the request isn't trusted, the snapshot covers the view the
+	// client reported, bounded the same way the client bounds its request
+	readViewport(message);
+	if (!hasViewport) {
+		return;
+	}
+
+	Map& map = server->getEditor()->map;
+	const LiveViewport region = getSnapshotRegion(viewport, map.getWidth(), map.getHeight());
+
+	// The client holds back requests for the whole region until the snapshot
+	// is in, so every leaf of it is sent, starting from the center.
+	const int32_t centerX = (region.startX + region.endX) / 2;
+	const int32_t centerY = (region.startY + region.endY) / 2;
+
+	std::vector<std::pair<int32_t, uint32_t>> order;
+	for (int32_t ndx = region.startX; ndx <= region.endX; ++ndx) {
+		for (int32_t ndy = region.startY; ndy <= region.endY; ++ndy) {
+			for (int32_t layer = 0; layer < 2; ++layer) {
+				bool underground = layer != 0;
+				if (!isInsideInterest(region, ndx, ndy, underground, 0)) {
+					continue;
+				}
+
+				int32_t dx = ndx - centerX;
+				int32_t dy = ndy - centerY;
+				order.push_back(std::make_pair(dx * dx + dy * dy, getNodeIndex(ndx, ndy, underground)));
+			}
 		}
 	}
+	std::sort(order.begin(), order.end());
+
+	struct SnapshotLeaf {
+		QTreeNode* node;
+		int32_t ndx, ndy;
+		uint32_t floorMask;
+	};
+
+	std::vector<SnapshotLeaf> leaves;
+	leaves.reserve(order.size());
+	for (const auto& entry : order) {
+		SnapshotLeaf leaf;
+		leaf.ndx = entry.second >> 18;
+		leaf.ndy = (entry.second >> 4) & 0x3FFF;
+		leaf.floorMask = (entry.second & 1) ? 0xFF00 : 0x00FF;
+		// Missing leaves go out as empty ones, they aren't created for this
+		leaf.node = map.getLeaf(leaf.ndx * 4, leaf.ndy * 4);
+		if (leaf.node) {
+			leaf.node->setVisible(clientId, (entry.second & 1) != 0, true);
+		}
+		knownNodes.insert(entry.second);
+		leaves.push_back(leaf);
+	}
+
+	// Serialize and compress the chunks in parallel, the map can't change
+	// underneath since the main thread waits for the workers.
+	const size_t chunkCount = std::max<size_t>(1, (leaves.size() + SNAPSHOT_CHUNK_LEAVES - 1) / SNAPSHOT_CHUNK_LEAVES);
+	std::vector<std::vector<uint8_t>> chunks(chunkCount);
+	std::vector<uint32_t> chunkSizes(chunkCount, 0);
+
+	ParallelStripes(chunkCount, settings.getInteger(Config::WORKER_THREADS),
+		[this, &leaves, &chunks, &chunkSizes](size_t stripe, size_t begin, size_t end) -> void {
+			MemoryNodeFileWriteHandle writer;
+			for (size_t chunk = begin; chunk < end; ++chunk) {
+				NetworkMessage body;
+
+				const size_t first = chunk * SNAPSHOT_CHUNK_LEAVES;
+				const size_t last = std::min(leaves.size(), first + SNAPSHOT_CHUNK_LEAVES);
+				for (size_t index = first; index < last; ++index) {
+					const SnapshotLeaf& leaf = leaves[index];
+					writeNode(body, writer, leaf.node, leaf.ndx, leaf.ndy, leaf.floorMask);
+				}
+
+				chunkSizes[chunk] = body.size;
+				chunks[chunk] = compressData(body.buffer.data() + 4, body.size);
+			}
+		}
+	);
+
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+		NetworkMessage outMessage;
+		outMessage.write<uint8_t>(PACKET_SNAPSHOT);
+		outMessage.write<uint32_t>(chunk);
+		outMessage.write<uint32_t>(chunkCount);
+		outMessage.write<uint32_t>(chunkSizes[chunk]);
+		outMessage.writeBytes(chunks[chunk].data(), chunks[chunk].size());
+		send(outMessage);
+	}
+
+	logMessage(name + wxT(" received ") + std::to_string(leaves.size()) + wxT(" leaves in ") + std::to_string(chunkCount) + wxT(" chunks."));
+
+	// The prefetch ring around the snapshot
+	snapshotSent = true;
+	pushNodes();
 }
 
 void LivePeer::parseReceiveChanges(NetworkMessage& message)
@@ -317,7 +443,90 @@ void LivePeer::parseCursorUpdate(NetworkMessage& message)
 	}
 
 	server->broadcastCursor(cursor);
-	gui.RefreshView();
+}
+
+void LivePeer::parseViewportUpdate(NetworkMessage& message)
+{
+	viewport = readViewport(message);
+	hasViewport = true;
+
+	Map& map = server->getEditor()->map;
+
+	// Leaves the client has moved far away from no longer receive broadcasts,
+	// the client forgets them as well and asks again when it comes back.
+	for (auto it = knownNodes.begin(); it != knownNodes.end();) {
+		int32_t ndx = *it >> 18;
+		int32_t ndy = (*it >> 4) & 0x3FFF;
+		bool underground = *it & 1;
+
+		if (isInsideInterest(viewport, ndx, ndy, underground, DROP_RING)) {
+			++it;
+			continue;
+		}
+
+		QTreeNode* node = map.getLeaf(ndx * 4, ndy * 4);
+		if (node) {
+			node->setVisible(clientId, underground, false);
+		}
+		it = knownNodes.erase(it);
+	}
+
+	// A joining client asks for a snapshot of its view right after telling
+	// us the view, pushing the same leaves one by one first would send them twice
+	if (snapshotSent) {
+		pushNodes();
+	}
+}
+
+void LivePeer::pushNodes()
+{
+	Map& map = server->getEditor()->map;
+
+	// Closest to the center of the view first
+	const int32_t centerX = (viewport.startX + viewport.endX) / 2;
+	const int32_t centerY = (viewport.startY + viewport.endY) / 2;
+
+	const int32_t startX = std::max<int32_t>(0, viewport.startX - PREFETCH_RING);
+	const int32_t startY = std::max<int32_t>(0, viewport.startY - PREFETCH_RING);
+	const int32_t endX = std::min<int32_t>((map.getWidth() - 1) >> 2, viewport.endX + PREFETCH_RING);
+	const int32_t endY = std::min<int32_t>((map.getHeight() - 1) >> 2, viewport.endY + PREFETCH_RING);
+
+	std::vector<std::pair<int32_t, uint32_t>> pending;
+	for (int32_t ndx = startX; ndx <= endX; ++ndx) {
+		for (int32_t ndy = startY; ndy <= endY; ++ndy) {
+			for (int32_t layer = 0; layer < 2; ++layer) {
+				bool underground = layer != 0;
+				if (!isInsideInterest(viewport, ndx, ndy, underground, PREFETCH_RING)) {
+					continue;
+				}
+
+				// Leaves the map doesn't have are answered as empty once, but not created
+				if (knownNodes.count(getNodeIndex(ndx, ndy, underground))) {
+					continue;
+				}
+
+				int32_t dx = ndx - centerX;
+				int32_t dy = ndy - centerY;
+				pending.push_back(std::make_pair(dx * dx + dy * dy, getNodeIndex(ndx, ndy, underground)));
+			}
+		}
+	}
+	std::sort(pending.begin(), pending.end());
+
+	for (const auto& entry : pending) {
+		int32_t ndx = entry.second >> 18;
+		int32_t ndy = (entry.second >> 4) & 0x3FFF;
+		bool underground = entry.second & 1;
+
+		QTreeNode* node = map.getLeaf(ndx * 4, ndy * 4);
+		sendNode(clientId, node, ndx, ndy, underground ? 0xFF00 : 0x00FF);
+	}
+}
+
+void LivePeer::sendNode(uint32_t clientId, QTreeNode* node, int32_t ndx, int32_t ndy, uint32_t floorMask)
+{
+	knownNodes.insert(getNodeIndex(ndx, ndy, (floorMask & 0xFF00) != 0));
+	LiveSocket::sendNode(clientId, node, ndx, ndy, floorMask);
 }
 
 void LivePeer::parseChatMessage(NetworkMessage& message)
@@ -8,6 +8,8 @@
 #include "live_socket.h"
 #include "net_connection.h"
 
+#include <deque>
+
 class LiveServer;
 class LivePeer : public LiveSocket
 {
@@ -45,15 +47,26 @@ class LivePeer : public LiveSocket
 
 		// editor packets
 		void parseNodeRequest(NetworkMessage& message);
+		void parseSnapshotRequest(NetworkMessage& message);
 		void parseReceiveChanges(NetworkMessage& message);
 		void parseAddHouse(NetworkMessage& message);
 		void parseEditHouse(NetworkMessage& message);
 		void parseRemoveHouse(NetworkMessage& message);
 		void parseCursorUpdate(NetworkMessage& message);
+		void parseViewportUpdate(NetworkMessage& message);
 		void parseChatMessage(NetworkMessage& message);
 
+		// Writes the next queued message, runs on the network thread
+		void sendQueued();
+
+		// Sends the leaves in and around the view the client doesn't have yet
+		void pushNodes();
+		// Same as LiveSocket::sendNode, but remembers the leaf for interest management
+		void sendNode(uint32_t clientId, QTreeNode* node, int32_t ndx, int32_t ndy, uint32_t floorMask);
+
 		//
 		NetworkMessage readMessage;
+		std::deque<std::shared_ptr<std::vector<uint8_t>>> writeQueue;
 
 		LiveServer* server;
 		boost::asio::ip::tcp::socket socket;
@@ -64,6 +77,8 @@ class LivePeer : public LiveSocket
 		uint32_t clientId;
 
 		bool connected;
+		// Leaves are only pushed one by one once the join snapshot is out
+		bool snapshotSent;
 
 		friend class LiveLogTab;
 		friend class LiveServer;
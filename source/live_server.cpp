@@ -8,11 +8,12 @@
 #include "live_peer.h"
 #include "live_tab.h"
 #include "live_action.h"
+#include "live_journal.h"
 
 #include "editor.h"
 
 LiveServer::LiveServer(Editor& editor) : LiveSocket(),
-	clients(), acceptor(nullptr), socket(nullptr), editor(&editor),
+	clients(), pendingCursors(), acceptor(nullptr), socket(nullptr), editor(&editor), journal(nullptr),
 	clientIds(0), port(0), stopped(false)
 {
 	//
@@ -20,7 +21,7 @@ LiveServer::LiveServer(Editor& editor) : LiveSocket(),
 
 LiveServer::~LiveServer()
 {
-	//
+	delete journal;
 }
 
 bool LiveServer::bind()
@@ -65,6 +66,10 @@ void LiveServer::close()
 	}
 
 	stopped = true;
+	if (cursorTimer) {
+		cursorTimer->cancel();
+	}
+
 	if (acceptor) {
 		acceptor->close();
 	}
@@ -112,7 +117,7 @@ void LiveServer::removeClient(uint32_t id)
 	const uint32_t clientId = it->second->getClientId();
 	if (clientId != 0) {
 		clientIds &= ~clientId;
-		editor->map.clearVisible(clientIds);
+		editor->map.clearVisible(clientIds | (clientIds << 16));
 	}
 
 	clients.erase(it);
@@ -135,7 +140,9 @@ void LiveServer::updateCursor(const Position& position)
 
 void LiveServer::updateClientList() const
 {
-	log->UpdateClientList(clients);
+	if (log) {
+		log->UpdateClientList(clients);
+	}
 }
 
 uint16_t LiveServer::getPort() const
@@ -164,6 +171,17 @@ uint32_t LiveServer::getFreeClientId()
 	return 0;
 }
 
+size_t LiveServer::getClientCount() const
+{
+	size_t count = 0;
+	for (const auto& clientEntry : clients) {
+		if (clientEntry.second->getClientId() != 0) {
+			++count;
+		}
+	}
+	return count;
+}
+
 std::string LiveServer::getHostName() const
 {
 	if (acceptor) {
@@ -179,6 +197,10 @@ void LiveServer::broadcastNodes(DirtyList& dirtyList)
 		return;
 	}
 
+	if (journal) {
+		journal->record(editor->map, dirtyList);
+	}
+
 	for (const auto& ind : dirtyList.GetPosList()) {
 		int32_t ndx = ind.pos >> 18;
 		int32_t ndy = (ind.pos >> 4) & 0x3FFF;
@@ -197,11 +219,12 @@ void LiveServer::broadcastNodes(DirtyList& dirtyList)
 				continue;
 			}
 
-			if (node->isVisible(clientId, true)) {
+			// A leaf the client got as empty before it existed has no visibility bits yet
+			if (node->isVisible(clientId, true) || peer->knownNodes.count(ind.pos | 1)) {
 				peer->sendNode(clientId, node, ndx, ndy, floors & 0xFF00);
 			}
 
-			if (node->isVisible(clientId, false)) {
+			if (node->isVisible(clientId, false) || peer->knownNodes.count(ind.pos)) {
 				peer->sendNode(clientId, node, ndx, ndy, floors & 0x00FF);
 			}
 		}
@@ -218,15 +241,63 @@ void LiveServer::broadcastCursor(const LiveCursor& cursor)
 		cursors[cursor.id] = cursor;
 	}
 
-	NetworkMessage message;
-	message.write<uint8_t>(PACKET_CURSOR_UPDATE);
-	writeCursor(message, cursor);
+	pendingCursors[cursor.id] = cursor;
+	scheduleCursorFlush();
+}
+
+void LiveServer::flushCursors()
+{
+	if (stopped || pendingCursors.empty()) {
+		return;
+	}
 
 	for (auto& clientEntry : clients) {
 		LivePeer* peer = clientEntry.second;
-		if (peer->getClientId() != cursor.id) {
-			peer->send(message);
+
+		const uint32_t clientId = peer->getClientId();
+		if (clientId == 0) {
+			continue;
 		}
+
+		const size_t count = pendingCursors.size() - pendingCursors.count(clientId);
+		if (count == 0) {
+			continue;
+		}
+
+		NetworkMessage message;
+		message.write<uint8_t>(PACKET_CURSOR_LIST);
+		message.write<uint16_t>(count);
+		for (auto& cursorEntry : pendingCursors) {
+			if (cursorEntry.first != clientId) {
+				writeCursor(message, cursorEntry.second);
+			}
+		}
+		peer->send(message);
+	}
+	pendingCursors.clear();
+
+	gui.RefreshView();
+}
+
+bool LiveServer::startJournal(const std::string& path)
+{
+	if (!journal) {
+		journal = newd LiveJournal();
+	}
+
+	if (!journal->open(path)) {
+		setLastError(journal->getLastError());
+		delete journal;
+		journal = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void LiveServer::truncateJournal()
+{
+	if (journal && !journal->truncate()) {
+		logMessage(wxT("Journal: ") + journal->getLastError());
 	}
 }
 
@@ -245,7 +316,11 @@ void LiveServer::broadcastChat(const wxString& speaker, const wxString& chatMess
 		clientEntry.second->send(message);
 	}
 
-	log->Chat(name, chatMessage);
+	if (log) {
+		log->Chat(name, chatMessage);
+	} else if (gui.IsHeadless()) {
+		std::cout << nstr(speaker) << ": " << nstr(chatMessage) << std::endl;
+	}
 }
 
 void LiveServer::startOperation(const wxString& operationMessage)
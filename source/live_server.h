@@ -12,6 +12,7 @@
 
 class LivePeer;
 class LiveLogTab;
+class LiveJournal;
 class QTreeNode;
 
 class LiveServer : public LiveSocket
@@ -48,6 +49,7 @@ class LiveServer : public LiveSocket
 		}
 
 		uint32_t getFreeClientId();
+		size_t getClientCount() const;
 		std::string getHostName() const;
 
 		//
@@ -58,13 +60,26 @@ class LiveServer : public LiveSocket
 		void startOperation(const wxString& operationMessage);
 		void updateOperation(int32_t percent);
 
+		// Records every change set applied from now on, see LiveJournal
+		bool startJournal(const std::string& path);
+		void truncateJournal();
+		LiveJournal* getJournal() const {
+			return journal;
+		}
+
 	protected:
+		void flushCursors();
+
 		std::unordered_map<uint32_t, LivePeer*> clients;
+
+		// Cursors that moved since the last tick, keyed by client id
+		std::unordered_map<uint32_t, LiveCursor> pendingCursors;
 		
 		std::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor;
 		std::shared_ptr<boost::asio::ip::tcp::socket> socket;
 
 		Editor* editor;
+		LiveJournal* journal;
 
 		uint32_t clientIds;
 		uint16_t port;
@@ -9,8 +9,11 @@
 #include "live_tab.h"
 #include "editor.h"
 
+#include <wx/mstream.h>
+#include <wx/zstream.h>
+
 LiveSocket::LiveSocket() :
-	cursors(), mapReader(nullptr, 0), mapWriter(),
+	cursors(), cursorTimer(nullptr), lastCursorFlush(0), cursorFlushPending(false), knownNodes(), viewport(), hasViewport(false), mapReader(nullptr, 0), mapWriter(),
 	mapVersion(MapVersion(MAP_OTBM_4, CLIENT_VERSION_NONE)), log(nullptr),
 	name(wxT("User")), password(wxT(""))
 {
@@ -79,11 +82,47 @@ std::vector<LiveCursor> LiveSocket::getCursorList() const
 	return cursorList;
 }
 
+bool LiveSocket::isInsideInterest(const LiveViewport& viewport, int32_t ndx, int32_t ndy, bool underground, int32_t ring)
+{
+	if (underground) {
+		if (viewport.bottomZ <= 7) {
+			return false;
+		}
+	} else if (viewport.topZ > 7) {
+		return false;
+	}
+
+	return ndx >= viewport.startX - ring && ndx <= viewport.endX + ring &&
+		ndy >= viewport.startY - ring && ndy <= viewport.endY + ring;
+}
+
+LiveViewport LiveSocket::getSnapshotRegion(const LiveViewport& viewport, int32_t mapWidth, int32_t mapHeight)
+{
+	LiveViewport region = viewport;
+	region.startX = std::max<int32_t>(0, region.startX - DROP_RING);
+	region.startY = std::max<int32_t>(0, region.startY - DROP_RING);
+	region.endX = std::min<int32_t>((mapWidth - 1) >> 2, region.endX + DROP_RING);
+	region.endY = std::min<int32_t>((mapHeight - 1) >> 2, region.endY + DROP_RING);
+
+	// Keep the middle of a view that is too wide
+	if (region.endX - region.startX >= SNAPSHOT_MAX_SPAN) {
+		region.startX = (region.startX + region.endX - SNAPSHOT_MAX_SPAN) / 2;
+		region.endX = region.startX + SNAPSHOT_MAX_SPAN - 1;
+	}
+	if (region.endY - region.startY >= SNAPSHOT_MAX_SPAN) {
+		region.startY = (region.startY + region.endY - SNAPSHOT_MAX_SPAN) / 2;
+		region.endY = region.startY + SNAPSHOT_MAX_SPAN - 1;
+	}
+	return region;
+}
+
 void LiveSocket::logMessage(const wxString& message)
 {
 	wxTheApp->CallAfter([this, message]() {
 		if (log) {
 			log->Message(message);
+		} else if (gui.IsHeadless()) {
+			std::cout << nstr(message) << std::endl;
 		}
 	});
 }
@@ -92,7 +131,7 @@ void LiveSocket::receiveNode(NetworkMessage& message, Editor& editor, Action* ac
 {
 	QTreeNode* node = editor.map.getLeaf(ndx * 4, ndy * 4);
 	if (!node) {
-		log->Message(wxT("Warning: Received update for unknown tile (") + std::to_string(ndx * 4) + wxT("/") + std::to_string(ndy * 4) + wxT("/") + (underground ? "true" : "false") + wxT(")"));
+		logMessage(wxT("Warning: Received update for unknown tile (") + std::to_string(ndx * 4) + wxT("/") + std::to_string(ndy * 4) + wxT("/") + (underground ? "true" : "false") + wxT(")"));
 		return;
 	}
 
@@ -124,15 +163,25 @@ void LiveSocket::sendNode(uint32_t clientId, QTreeNode* node, int32_t ndx, int32
 		underground = false;
 	}
 
-	node->setVisible(clientId, underground, true);
+	if (node) {
+		node->setVisible(clientId, underground, true);
+	}
 
 	// Send message
 	NetworkMessage message;
 	message.write<uint8_t>(PACKET_NODE);
-	message.write<uint32_t>((ndx << 18) | (ndy << 4) | ((floorMask & 0xFF00) ? 1 : 0));
+	writeNode(message, mapWriter, node, ndx, ndy, floorMask);
+
+	send(message);
+}
+
+void LiveSocket::writeNode(NetworkMessage& message, MemoryNodeFileWriteHandle& writer, QTreeNode* node, int32_t ndx, int32_t ndy, uint32_t floorMask)
+{
+	message.write<uint32_t>(getNodeIndex(ndx, ndy, (floorMask & 0xFF00) != 0));
 
 	if (!node) {
-		message.write<uint8_t>(0x00);
+		// No floors, the same as a leaf without any
+		message.write<uint16_t>(0x0000);
 	} else {
 		Floor** floors = node->getFloors();
 
@@ -147,12 +196,10 @@ void LiveSocket::sendNode(uint32_t clientId, QTreeNode* node, int32_t ndx, int32
 		message.write<uint16_t>(sendMask);
 		for (uint32_t z = 0; z < 16; ++z) {
 			if (testFlags(sendMask, 1 << z)) {
-				sendFloor(message, floors[z]);
+				writeFloor(message, writer, floors[z]);
 			}
 		}
 	}
-
-	send(message);
 }
 
 void LiveSocket::receiveFloor(NetworkMessage& message, Editor& editor, Action* action, int32_t ndx, int32_t ndy, int32_t z, QTreeNode* node, Floor* floor)
@@ -193,7 +240,7 @@ void LiveSocket::receiveFloor(NetworkMessage& message, Editor& editor, Action* a
 	mapReader.close();
 }
 
-void LiveSocket::sendFloor(NetworkMessage& message, Floor* floor)
+void LiveSocket::writeFloor(NetworkMessage& message, MemoryNodeFileWriteHandle& writer, Floor* floor)
 {
 	uint16_t tileBits = 0;
 	for (uint_fast8_t x = 0; x < 4; ++x) {
@@ -212,20 +259,20 @@ void LiveSocket::sendFloor(NetworkMessage& message, Floor* floor)
 		return;
 	}
 
-	mapWriter.reset();
+	writer.reset();
 	for (uint_fast8_t x = 0; x < 4; ++x) {
 		for (uint_fast8_t y = 0; y < 4; ++y) {
 			uint_fast8_t index = (x * 4) + y;
 			if (testFlags(tileBits, 1 << index)) {
-				sendTile(mapWriter, floor->locs[index].get(), nullptr);
+				sendTile(writer, floor->locs[index].get(), nullptr);
 			}
 		}
 	}
-	mapWriter.endNode();
+	writer.endNode();
 
 	std::string stream(
-		reinterpret_cast<char*>(mapWriter.getMemory()),
-		mapWriter.getSize()
+		reinterpret_cast<char*>(writer.getMemory()),
+		writer.getSize()
 	);
 	message.write<std::string>(stream);
 }
@@ -242,6 +289,27 @@ void LiveSocket::receiveTile(BinaryNode* node, Editor& editor, Action* action, c
 
 void LiveSocket::sendTile(MemoryNodeFileWriteHandle& writer, Tile* tile, const Position* position)
 {
+	serializeTile(writer, tile, position, mapVersion);
+}
+
+Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* position)
+{
+	return unserializeTile(node, editor.map, position, mapVersion);
+}
+
+void LiveSocket::serializeTile(MemoryNodeFileWriteHandle& writer, Tile* tile, const Position* position, const IOMap& version)
+{
+	if (!tile) {
+		writer.addNode(OTBM_TILE);
+		if (position) {
+			writer.addU16(position->x);
+			writer.addU16(position->y);
+			writer.addU8(position->z);
+		}
+		writer.endNode();
+		return;
+	}
+
 	writer.addNode(tile->isHouseTile() ? OTBM_HOUSETILE : OTBM_TILE);
 	if (position) {
 		writer.addU16(position->x);
@@ -261,25 +329,28 @@ void LiveSocket::sendTile(MemoryNodeFileWriteHandle& writer, Tile* tile, const P
 	Item* ground = tile->ground;
 	if (ground) {
 		if (ground->isComplex()) {
-			ground->serializeItemNode_OTBM(mapVersion, writer);
+			ground->serializeItemNode_OTBM(version, writer);
 		} else {
 			writer.addByte(OTBM_ATTR_ITEM);
-			ground->serializeItemCompact_OTBM(mapVersion, writer);
+			ground->serializeItemCompact_OTBM(version, writer);
 		}
 	}
 
 	for (Item* item : tile->items) {
-		item->serializeItemNode_OTBM(mapVersion, writer);
+		item->serializeItemNode_OTBM(version, writer);
 	}
 
 	writer.endNode();
 }
 
-Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* position)
+Tile* LiveSocket::unserializeTile(BinaryNode* node, Map& map, const Position* position, const IOMap& version)
 {
-	ASSERT(node != nullptr);
+	return unserializeTile(node, map, &map.houses, position, version);
+}
 
-	Map& map = editor.map;
+Tile* LiveSocket::unserializeTile(BinaryNode* node, BaseMap& map, Houses* houses, const Position* position, const IOMap& version)
+{
+	ASSERT(node != nullptr);
 
 	uint8_t tileType;
 	node->getByte(tileType);
@@ -297,6 +368,11 @@ Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* pos
 		uint8_t z; node->getU8(z); pos.z = z;
 	}
 
+	// The bytes come from another process, a floor out of range would be created
+	if (!pos.isValid()) {
+		return nullptr;
+	}
+
 	Tile* tile = map.allocator(
 		map.createTileL(pos)
 	);
@@ -310,8 +386,9 @@ Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* pos
 		}
 
 		if (houseId) {
-			House* house = map.houses.getHouse(houseId);
-			if (house) {
+			if (!houses) {
+				tile->house_id = houseId;
+			} else if (House* house = houses->getHouse(houseId)) {
 				tile->setHouse(house);
 			}
 		} else {
@@ -331,7 +408,7 @@ Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* pos
 				break;
 			}
 			case OTBM_ATTR_ITEM: {
-				Item* item = Item::Create_OTBM(mapVersion, node);
+				Item* item = Item::Create_OTBM(version, node);
 				if (!item) {
 					//warning(wxT("Invalid item at tile %d:%d:%d"), pos.x, pos.y, pos.z);
 				}
@@ -355,9 +432,9 @@ Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* pos
 		}
 
 		if (itemType == OTBM_ITEM) {
-			Item* item = Item::Create_OTBM(mapVersion, itemNode);
+			Item* item = Item::Create_OTBM(version, itemNode);
 			if (item) {
-				if (!item->unserializeItemNode_OTBM(mapVersion, itemNode)) {
+				if (!item->unserializeItemNode_OTBM(version, itemNode)) {
 					//warning(wxT("Couldn't unserialize item attributes at %d:%d:%d"), pos.x, pos.y, pos.z);
 				}
 				tile->addItem(item);
@@ -371,6 +448,42 @@ Tile* LiveSocket::readTile(BinaryNode* node, Editor& editor, const Position* pos
 	return tile;
 }
 
+uint32_t LiveSocket::getCursorInterval()
+{
+	return 1000 / std::max<int32_t>(1, settings.getInteger(Config::LIVE_CURSOR_RATE));
+}
+
+void LiveSocket::scheduleCursorFlush()
+{
+	if (cursorFlushPending) {
+		return;
+	}
+	cursorFlushPending = true;
+
+	const wxLongLong elapsed = wxGetLocalTimeMillis() - lastCursorFlush;
+	const int64_t delay = std::max<int64_t>(0, getCursorInterval() - elapsed.GetValue());
+
+	if (!cursorTimer) {
+		cursorTimer = std::make_shared<boost::asio::deadline_timer>(
+			NetworkConnection::getInstance().get_service()
+		);
+	}
+
+	cursorTimer->expires_from_now(boost::posix_time::milliseconds(delay));
+	cursorTimer->async_wait([this](const boost::system::error_code& error) -> void
+	{
+		if (error) {
+			return;
+		}
+
+		wxTheApp->CallAfter([this]() {
+			cursorFlushPending = false;
+			lastCursorFlush = wxGetLocalTimeMillis();
+			flushCursors();
+		});
+	});
+}
+
 LiveCursor LiveSocket::readCursor(NetworkMessage& message)
 {
 	LiveCursor cursor;
@@ -395,3 +508,53 @@ void LiveSocket::writeCursor(NetworkMessage& message, const LiveCursor& cursor)
 	message.write<uint8_t>(cursor.color.Alpha());
 	message.write<Position>(cursor.pos);
 }
+
+LiveViewport LiveSocket::readViewport(NetworkMessage& message)
+{
+	LiveViewport newViewport;
+	newViewport.startX = message.read<uint16_t>();
+	newViewport.startY = message.read<uint16_t>();
+	newViewport.endX = message.read<uint16_t>();
+	newViewport.endY = message.read<uint16_t>();
+	newViewport.topZ = message.read<uint8_t>();
+	newViewport.bottomZ = message.read<uint8_t>();
+	return newViewport;
+}
+
+void LiveSocket::writeViewport(NetworkMessage& message, const LiveViewport& viewport)
+{
+	message.write<uint16_t>(viewport.startX);
+	message.write<uint16_t>(viewport.startY);
+	message.write<uint16_t>(viewport.endX);
+	message.write<uint16_t>(viewport.endY);
+	message.write<uint8_t>(viewport.topZ);
+	message.write<uint8_t>(viewport.bottomZ);
+}
+
+std::vector<uint8_t> LiveSocket::compressData(const uint8_t* data, size_t size)
+{
+	wxMemoryOutputStream memory;
+	{
+		wxZlibOutputStream zlib(memory, -1, wxZLIB_ZLIB);
+		zlib.Write(data, size);
+		zlib.Close();
+	}
+
+	std::vector<uint8_t> compressed(memory.GetSize());
+	if (!compressed.empty()) {
+		memory.CopyTo(compressed.data(), compressed.size());
+	}
+	return compressed;
+}
+
+bool LiveSocket::decompressData(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+{
+	if (outSize == 0) {
+		return true;
+	}
+
+	wxMemoryInputStream memory(data, size);
+	wxZlibInputStream zlib(memory, wxZLIB_ZLIB);
+	zlib.Read(out, outSize);
+	return zlib.LastRead() == outSize;
+}
@@ -13,9 +13,12 @@
 
 #include <memory>
 #include <unordered_map>
+#include <set>
 
 class LiveLogTab;
 class Action;
+class BaseMap;
+class Houses;
 
 struct LiveCursor
 {
@@ -24,6 +27,25 @@ struct LiveCursor
 	Position pos;
 };
 
+// The area a client is looking at, in leaf (4x4 tile) coordinates
+struct LiveViewport
+{
+	LiveViewport() : startX(0), startY(0), endX(0), endY(0), topZ(7), bottomZ(7) {}
+
+	bool operator==(const LiveViewport& other) const {
+		return startX == other.startX && startY == other.startY &&
+			endX == other.endX && endY == other.endY &&
+			topZ == other.topZ && bottomZ == other.bottomZ;
+	}
+	bool operator!=(const LiveViewport& other) const {
+		return !(*this == other);
+	}
+
+	int32_t startX, startY;
+	int32_t endX, endY;
+	uint8_t topZ, bottomZ;
+};
+
 class LiveSocket
 {
 	public:
@@ -54,13 +76,53 @@ class LiveSocket
 		//
 		virtual void updateCursor(const Position& position) = 0;
 
+		// Milliseconds between two cursor ticks, from Config::LIVE_CURSOR_RATE
+		static uint32_t getCursorInterval();
+
+		// Leaves within PREFETCH_RING of a viewport are pushed to the client before
+		// it asks for them, leaves beyond DROP_RING are no longer kept up to date.
+		static const int32_t PREFETCH_RING = 2;
+		static const int32_t DROP_RING = 8;
+
+		// Leaves per compressed chunk of a join snapshot
+		static const size_t SNAPSHOT_CHUNK_LEAVES = 64;
+		// Leaves across a snapshot covers at most, a wider view is filled in by node requests
+		static const int32_t SNAPSHOT_MAX_SPAN = 192;
+		// A chunk is much smaller, anything claiming more is broken
+		static const uint32_t SNAPSHOT_CHUNK_MAX_SIZE = 64 * 1024 * 1024;
+
+		static bool isInsideInterest(const LiveViewport& viewport, int32_t ndx, int32_t ndy, bool underground, int32_t ring);
+		// The view plus the drop ring, inside the map and no wider than SNAPSHOT_MAX_SPAN,
+		// both ends compute it so they agree on what the snapshot holds
+		static LiveViewport getSnapshotRegion(const LiveViewport& viewport, int32_t mapWidth, int32_t mapHeight);
+
+		// Packs a leaf and layer the way node packets and requests address them
+		static uint32_t getNodeIndex(int32_t ndx, int32_t ndy, bool underground) {
+			return (uint32_t(ndx) << 18) | (uint32_t(ndy) << 4) | (underground ? 1 : 0);
+		}
+
+		// OTBM tile records, also used by the journal. A null tile is written as
+		// an empty one, which clears the position again when it's read back.
+		static void serializeTile(MemoryNodeFileWriteHandle& writer, Tile* tile, const Position* position, const IOMap& version);
+		static Tile* unserializeTile(BinaryNode* node, Map& map, const Position* position, const IOMap& version);
+		// Without houses to look them up in, house ids are kept as they are
+		static Tile* unserializeTile(BinaryNode* node, BaseMap& map, Houses* houses, const Position* position, const IOMap& version);
+
+		// zlib streams for the snapshot chunks, also used by the undo spill
+		static std::vector<uint8_t> compressData(const uint8_t* data, size_t size);
+		static bool decompressData(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
+
 	protected:
 		// receive / send methods
 		void receiveNode(NetworkMessage& message, Editor& editor, Action* action, int32_t ndx, int32_t ndy, bool underground);
 		void sendNode(uint32_t clientId, QTreeNode* node, int32_t ndx, int32_t ndy, uint32_t floorMask);
 
+		// Writes the leaf the way sendNode does, without touching any shared state.
+		// Safe to call from worker threads as long as each one has its own writer.
+		void writeNode(NetworkMessage& message, MemoryNodeFileWriteHandle& writer, QTreeNode* node, int32_t ndx, int32_t ndy, uint32_t floorMask);
+
 		void receiveFloor(NetworkMessage& message, Editor& editor, Action* action, int32_t ndx, int32_t ndy, int32_t z, QTreeNode* node, Floor* floor);
-		void sendFloor(NetworkMessage& message, Floor* floor);
+		void writeFloor(NetworkMessage& message, MemoryNodeFileWriteHandle& writer, Floor* floor);
 
 		void receiveTile(BinaryNode* node, Editor& editor, Action* action, const Position* position);
 		void sendTile(MemoryNodeFileWriteHandle& writer, Tile* tile, const Position* position);
@@ -71,9 +133,26 @@ class LiveSocket
 		LiveCursor readCursor(NetworkMessage& message);
 		void writeCursor(NetworkMessage& message, const LiveCursor& cursor);
 
+		// Cursor updates are collected and sent once per tick, only the
+		// newest position of every cursor makes it into the next tick.
+		void scheduleCursorFlush();
+		virtual void flushCursors() = 0;
+
+		LiveViewport readViewport(NetworkMessage& message);
+		void writeViewport(NetworkMessage& message, const LiveViewport& viewport);
+
 		//
 		std::unordered_map<uint32_t, LiveCursor> cursors;
 
+		std::shared_ptr<boost::asio::deadline_timer> cursorTimer;
+		wxLongLong lastCursorFlush;
+		bool cursorFlushPending;
+
+		// Leaves that are currently kept in sync with the other end
+		std::set<uint32_t> knownNodes;
+		LiveViewport viewport;
+		bool hasViewport;
+
 		MemoryNodeFileReadHandle mapReader;
 		MemoryNodeFileWriteHandle mapWriter;
 		VirtualIOMap mapVersion;
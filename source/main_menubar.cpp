@@ -36,6 +36,10 @@
 #include "materials.h"
 #include "live_client.h"
 #include "live_server.h"
+#include "reachability.h"
+#include "map_diff.h"
+#include "map_validator.h"
+#include "item_replacer.h"
 
 #define MAP_LOAD_FILE_WILDCARD_OTGZ wxT("OpenTibia Binary Map (*.otbm;*.otgz)|*.otbm;*.otgz")
 #define MAP_SAVE_FILE_WILDCARD_OTGZ wxT("OpenTibia Binary Map (*.otbm)|*.otbm|Compressed OpenTibia Binary Map (*.otgz)|*.otgz")
@@ -76,6 +80,7 @@ MainMenuBar::MainMenuBar(MainFrame *frame) : frame(frame)
 
 	MAKE_ACTION(FIND_ITEM, wxITEM_NORMAL, OnSearchForItem);
 	MAKE_ACTION(REPLACE_ITEM, wxITEM_NORMAL, OnReplaceItem);
+	MAKE_ACTION(REPLACE_ITEMS_TABLE, wxITEM_NORMAL, OnReplaceItemsTable);
 	MAKE_ACTION(SEARCH_EVERYTHING, wxITEM_NORMAL, OnSearchForStuff);
 	MAKE_ACTION(SEARCH_UNIQUE, wxITEM_NORMAL, OnSearchForUnique);
 	MAKE_ACTION(SEARCH_ACTION, wxITEM_NORMAL, OnSearchForAction);
@@ -108,10 +113,14 @@ MainMenuBar::MainMenuBar(MainFrame *frame) : frame(frame)
 	MAKE_ACTION(MAP_REMOVE_ITEMS, wxITEM_NORMAL, OnMapRemoveItems);
 	MAKE_ACTION(MAP_REMOVE_CORPSES, wxITEM_NORMAL, OnMapRemoveCorpses);
 	MAKE_ACTION(MAP_REMOVE_UNREACHABLE_TILES, wxITEM_NORMAL, OnMapRemoveUnreachable);
+	MAKE_ACTION(MAP_ANALYZE_REACHABILITY, wxITEM_NORMAL, OnMapAnalyzeReachability);
+	MAKE_ACTION(MAP_VALIDATE, wxITEM_NORMAL, OnMapValidate);
 	MAKE_ACTION(MAP_CLEANUP, wxITEM_NORMAL, OnMapCleanup);
 	MAKE_ACTION(MAP_CLEAN_HOUSE_ITEMS, wxITEM_NORMAL, OnMapCleanHouseItems);
 	MAKE_ACTION(MAP_PROPERTIES, wxITEM_NORMAL, OnMapProperties);
 	MAKE_ACTION(MAP_STATISTICS, wxITEM_NORMAL, OnMapStatistics);
+	MAKE_ACTION(MAP_COMPARE, wxITEM_NORMAL, OnMapCompare);
+	MAKE_ACTION(MAP_APPLY_PATCH, wxITEM_NORMAL, OnMapApplyPatch);
 
 	MAKE_ACTION(NEW_VIEW, wxITEM_NORMAL, OnNewView);
 	MAKE_ACTION(TOGGLE_FULLSCREEN, wxITEM_NORMAL, OnToggleFullscreen);
@@ -131,6 +140,8 @@ MainMenuBar::MainMenuBar(MainFrame *frame) : frame(frame)
 	MAKE_ACTION(SHOW_ONLY_MODIFIED, wxITEM_CHECK, OnChangeViewSettings);
 	MAKE_ACTION(SHOW_HOUSES, wxITEM_CHECK, OnChangeViewSettings);
 	MAKE_ACTION(SHOW_PATHING, wxITEM_CHECK, OnChangeViewSettings);
+	MAKE_ACTION(SHOW_REACHABILITY, wxITEM_CHECK, OnChangeViewSettings);
+	MAKE_ACTION(SHOW_MAP_DIFF, wxITEM_CHECK, OnChangeViewSettings);
 
 	MAKE_ACTION(WIN_MINIMAP, wxITEM_NORMAL, OnMinimapWindow);
 	MAKE_ACTION(NEW_PALETTE, wxITEM_NORMAL, OnNewPalette);
@@ -296,6 +307,7 @@ void MainMenuBar::Update()
 
 	EnableItem(FIND_ITEM, is_host);
 	EnableItem(REPLACE_ITEM, is_local);
+	EnableItem(REPLACE_ITEMS_TABLE, is_local);
 	EnableItem(SEARCH_UNIQUE, is_host);
 
 	EnableItem(CUT, has_map);
@@ -315,6 +327,8 @@ void MainMenuBar::Update()
 	EnableItem(MAP_REMOVE_ITEMS, is_host);
 	EnableItem(MAP_REMOVE_CORPSES, is_local);
 	EnableItem(MAP_REMOVE_UNREACHABLE_TILES, is_local);
+	EnableItem(MAP_ANALYZE_REACHABILITY, is_local);
+	EnableItem(MAP_VALIDATE, is_local);
 
 	EnableItem(EDIT_TOWNS, is_local);
 	EnableItem(EDIT_ITEMS, false);
@@ -323,6 +337,8 @@ void MainMenuBar::Update()
 	EnableItem(MAP_CLEANUP, is_local);
 	EnableItem(MAP_PROPERTIES, is_local);
 	EnableItem(MAP_STATISTICS, is_local);
+	EnableItem(MAP_COMPARE, is_local);
+	EnableItem(MAP_APPLY_PATCH, is_local);
 
 	EnableItem(NEW_VIEW, has_map);
 
@@ -388,6 +404,8 @@ void MainMenuBar::LoadValues()
 	CheckItem(SHOW_ONLY_COLORS, settings.getBoolean(Config::SHOW_ONLY_TILEFLAGS));
 	CheckItem(SHOW_ONLY_MODIFIED, settings.getBoolean(Config::SHOW_ONLY_MODIFIED_TILES));
 	CheckItem(SHOW_HOUSES, settings.getBoolean(Config::SHOW_HOUSES));
+	CheckItem(SHOW_REACHABILITY, settings.getBoolean(Config::SHOW_REACHABILITY));
+	CheckItem(SHOW_MAP_DIFF, settings.getBoolean(Config::SHOW_MAP_DIFF));
 }
 
 void MainMenuBar::LoadRecentFiles()
@@ -841,31 +859,49 @@ void MainMenuBar::OnReplaceItem(wxCommandEvent& WXUNUSED(event))
 
 	if(dlg.ShowModal() != 0)
 	{
-		uint16_t find_id = dlg.GetResultFindID();
-		uint16_t with_id = dlg.GetResultWithID();
+		ItemReplacer::Rule rule;
+		rule.from = dlg.GetResultFindID();
+		rule.to = dlg.GetResultWithID();
 
-		OnSearchForItem::Finder finder(find_id);
-		gui.GetCurrentEditor()->actionQueue->clear();
-		gui.CreateLoadBar(wxT("Searching & replacing map..."));
+		ItemReplacer replacer;
+		replacer.addRule(rule);
 
-		// Search the map
-		foreach_ItemOnMap(gui.GetCurrentMap(), finder);
-
-		// Replace the items in a second step (can't replace while iterating)
-		for (std::vector<std::pair<Tile*, Item*> >::const_iterator replace_iter = finder.found.begin();
-				replace_iter != finder.found.end();
-				++replace_iter)
-		{
-			transformItem(replace_iter->second, with_id, replace_iter->first);
-		}
+		gui.CreateLoadBar(wxT("Searching & replacing map..."));
+		size_t replaced = replacer.apply(*gui.GetCurrentEditor(), std::max(settings.getInteger(Config::WORKER_THREADS), 1), true);
+		gui.DestroyLoadBar();
 
 		wxString msg;
-		msg << wxT("Replaced ") << finder.found.size() << wxT(" items.");
+		msg << wxT("Replaced ") << replaced << wxT(" items.");
 		gui.SetStatusText(msg);
+	}
 
-		gui.DestroyLoadBar();
+	gui.RefreshView();
+}
+
+void MainMenuBar::OnReplaceItemsTable(wxCommandEvent& WXUNUSED(event))
+{
+	if(gui.IsEditorOpen() == false)
+		return;
+
+	wxFileDialog file(frame, wxT("Replace items from table"), wxT(""), wxT(""), wxT("Text files (*.txt)|*.txt|All files (*.*)|*.*"), wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+	if(file.ShowModal() != wxID_OK)
+		return;
+
+	ItemReplacer replacer;
+	wxString error;
+	if(!replacer.loadRules(nstr(file.GetPath()), error))
+	{
+		gui.PopupDialog(wxT("Error"), error, wxOK);
+		return;
 	}
 
+	gui.CreateLoadBar(wxT("Searching & replacing map..."));
+	size_t replaced = replacer.apply(*gui.GetCurrentEditor(), std::max(settings.getInteger(Config::WORKER_THREADS), 1), true);
+	gui.DestroyLoadBar();
+
+	wxString msg;
+	msg << wxT("Replaced ") << replaced << wxT(" items by ") << replacer.getRuleCount() << wxT(" rules.");
+	gui.SetStatusText(msg);
 	gui.RefreshView();
 }
 
@@ -1139,7 +1175,11 @@ void MainMenuBar::OnRandomizeMap(wxCommandEvent& WXUNUSED(event))
 
 	int ret = gui.PopupDialog(wxT("Randomize Map"), wxT("Are you sure you want to randomize the entire map (this action cannot be undone)?"), wxYES | wxNO);
 	if(ret == wxID_YES)
-		gui.GetCurrentEditor()->randomizeMap(true);
+	{
+		uint32_t seed = mt_randi();
+		gui.GetCurrentEditor()->randomizeMap(true, seed);
+		gui.SetStatusText(wxString::Format(wxT("Map randomized with seed %u."), seed));
+	}
 
 	gui.RefreshView();
 }
@@ -1283,29 +1323,147 @@ void MainMenuBar::OnMapRemoveCorpses(wxCommandEvent& WXUNUSED(event))
 
 namespace OnMapRemoveUnreachable
 {
-	struct condition
+	// How far from a walkable tile a tile still counts as reachable
+	const int REACH_X = 10;
+	const int REACH_Y = 8;
+
+	// One floor of the map, a cell is set if a walkable tile lies within
+	// REACH_X/REACH_Y of it. Covers the walkable tiles' bounds plus reach,
+	// anything outside is unreachable from this floor.
+	struct ReachFloor
 	{
-		condition() {}
+		ReachFloor() : x0(0), y0(0), width(0), height(0) {}
 
-		bool isReachable(Tile* tile)
+		bool test(int x, int y) const
 		{
-			if(tile == nullptr)
+			x -= x0;
+			y -= y0;
+			if(x < 0 || y < 0 || x >= width || y >= height)
 				return false;
-			if(!tile->isBlocking())
-				return true;
-			return false;
+			return cells[size_t(y) * width + x] != 0;
+		}
+
+		int x0, y0;
+		int width, height;
+		std::vector<uint8_t> cells;
+	};
+
+	// Marks the walkable tiles of floor z and dilates them by the reach, a
+	// row pass then a column pass, both with a sliding count so every cell
+	// costs the same however large the reach is.
+	void buildFloor(const std::vector<QTreeNode*>& leaves, int z, ReachFloor& floor)
+	{
+		int minx = 0x10000, miny = 0x10000, maxx = -1, maxy = -1;
+		for(QTreeNode* leaf : leaves)
+		{
+			Floor* tiles = leaf->getFloor(z);
+			if(!tiles)
+				continue;
+
+			for(TileLocation& location : tiles->locs)
+			{
+				Tile* tile = location.get();
+				if(!tile || tile->isBlocking())
+					continue;
+
+				Position pos = location.getPosition();
+				minx = std::min<int>(minx, pos.x);
+				miny = std::min<int>(miny, pos.y);
+				maxx = std::max<int>(maxx, pos.x);
+				maxy = std::max<int>(maxy, pos.y);
+			}
+		}
+
+		if(maxx < 0)
+			return;
+
+		floor.x0 = minx - REACH_X;
+		floor.y0 = miny - REACH_Y;
+		floor.width = maxx - minx + 1 + 2 * REACH_X;
+		floor.height = maxy - miny + 1 + 2 * REACH_Y;
+
+		const size_t width = floor.width;
+		const size_t height = floor.height;
+		std::vector<uint8_t> walkable(width * height, 0);
+		for(QTreeNode* leaf : leaves)
+		{
+			Floor* tiles = leaf->getFloor(z);
+			if(!tiles)
+				continue;
+
+			for(TileLocation& location : tiles->locs)
+			{
+				Tile* tile = location.get();
+				if(!tile || tile->isBlocking())
+					continue;
+
+				Position pos = location.getPosition();
+				walkable[size_t(pos.y - floor.y0) * width + (pos.x - floor.x0)] = 1;
+			}
+		}
+
+		// Rows, in place through a copy of the row being dilated
+		std::vector<uint8_t> row(width);
+		for(size_t y = 0; y < height; ++y)
+		{
+			uint8_t* line = &walkable[y * width];
+			std::copy(line, line + width, row.begin());
+
+			int count = 0;
+			for(size_t x = 0; x < std::min<size_t>(REACH_X, width); ++x)
+				count += row[x];
+
+			for(size_t x = 0; x < width; ++x)
+			{
+				if(x + REACH_X < width)
+					count += row[x + REACH_X];
+				line[x] = count > 0;
+				if(x >= size_t(REACH_X))
+					count -= row[x - REACH_X];
+			}
+		}
+
+		// Columns, a running count per column over the rows in reach
+		floor.cells.assign(width * height, 0);
+		std::vector<int> counts(width, 0);
+		for(size_t y = 0; y < std::min<size_t>(REACH_Y, height); ++y)
+		{
+			for(size_t x = 0; x < width; ++x)
+				counts[x] += walkable[y * width + x];
+		}
+
+		for(size_t y = 0; y < height; ++y)
+		{
+			if(y + REACH_Y < height)
+			{
+				const uint8_t* entering = &walkable[(y + REACH_Y) * width];
+				for(size_t x = 0; x < width; ++x)
+					counts[x] += entering[x];
+			}
+
+			uint8_t* line = &floor.cells[y * width];
+			for(size_t x = 0; x < width; ++x)
+				line[x] = counts[x] > 0;
+
+			if(y >= size_t(REACH_Y))
+			{
+				const uint8_t* leaving = &walkable[(y - REACH_Y) * width];
+				for(size_t x = 0; x < width; ++x)
+					counts[x] -= leaving[x];
+			}
 		}
+	}
+
+	struct condition
+	{
+		condition(const ReachFloor* floors) : floors(floors) {}
 
 		bool operator()(Map& map, Tile* tile, long long removed, long long done, long long total)
 		{
 			if(done % 0x1000 == 0)
-				gui.SetLoadDone((unsigned int)(100 * done / total));
+				gui.SetLoadDone((unsigned int)(50 + 50 * done / total));
 
 			Position pos = tile->getPosition();
-			int sx = std::max(pos.x - 10, 0);
-			int ex = std::min(pos.x + 10, 65535);
-			int sy = std::max(pos.y - 8,  0);
-			int ey = std::min(pos.y + 8,  65535);
 			int sz, ez;
 
 			if(pos.z < 8)
@@ -1322,17 +1480,13 @@ namespace OnMapRemoveUnreachable
 
 			for(int z = sz; z <= ez; ++z)
 			{
-				for(int y = sy; y <= ey; ++y)
-				{
-					for(int x = sx; x <= ex; ++x)
-					{
-						if(isReachable(map.getTile(x, y, z)))
-							return false;
-					}
-				}
+				if(floors[z].test(pos.x, pos.y))
+					return false;
 			}
 			return true;
 		}
+
+		const ReachFloor* floors;
 	};
 }
 
@@ -1348,10 +1502,28 @@ void MainMenuBar::OnMapRemoveUnreachable(wxCommandEvent& WXUNUSED(event))
 		gui.GetCurrentEditor()->selection.clear();
 		gui.GetCurrentEditor()->actionQueue->clear();
 
-		OnMapRemoveUnreachable::condition func;
+		Map& map = gui.GetCurrentMap();
 		gui.CreateLoadBar(wxT("Searching map for tiles to remove..."));
 
-		long long removed = remove_if_TileOnMap(gui.GetCurrentMap(), func);
+		// Every floor's reach is worked out once up front, the floors don't
+		// depend on each other. Only blocking tiles are ever removed, so
+		// removing them doesn't change the answer for the tiles after.
+		std::vector<QTreeNode*> leaves;
+		map.getLeaves(leaves);
+
+		OnMapRemoveUnreachable::ReachFloor floors[MAP_HEIGHT];
+		const size_t threads = std::max(settings.getInteger(Config::WORKER_THREADS), 1);
+		StripeProgress progress(MAP_HEIGHT, true, 0, 50, 1);
+		ParallelStripes(MAP_HEIGHT, threads, [&](size_t stripe, size_t begin, size_t end) {
+			for(size_t z = begin; z < end; ++z)
+			{
+				OnMapRemoveUnreachable::buildFloor(leaves, int(z), floors[z]);
+				progress.advance(stripe);
+			}
+		});
+
+		OnMapRemoveUnreachable::condition func(floors);
+		long long removed = remove_if_TileOnMap(map, func);
 
 		gui.DestroyLoadBar();
 
@@ -1360,8 +1532,119 @@ void MainMenuBar::OnMapRemoveUnreachable(wxCommandEvent& WXUNUSED(event))
 
 		gui.PopupDialog(wxT("Search completed"), msg, wxOK);
 
-		gui.GetCurrentMap().doChange();
+		map.doChange();
+	}
+}
+
+namespace OnMapAnalyzeReachability
+{
+	struct condition
+	{
+		condition(const Reachability& reachability) : reachability(reachability) {}
+
+		bool operator()(Map& map, Tile* tile, long long removed, long long done, long long total)
+		{
+			if(done % 0x1000 == 0)
+				gui.SetLoadDone((unsigned int)(100 * done / total));
+
+			Position pos = tile->getPosition();
+			return reachability.isWalkable(pos) && !reachability.isReachable(pos);
+		}
+
+		const Reachability& reachability;
+	};
+}
+
+void MainMenuBar::OnMapAnalyzeReachability(wxCommandEvent& WXUNUSED(event))
+{
+	if(gui.IsEditorOpen() == false)
+		return;
+
+	Editor* editor = gui.GetCurrentEditor();
+	if(!editor->reachability)
+		editor->reachability = newd Reachability();
+
+	gui.CreateLoadBar(wxT("Analyzing reachability..."));
+	bool ok = editor->reachability->analyze(editor->map, std::max(settings.getInteger(Config::WORKER_THREADS), 1), true);
+	gui.DestroyLoadBar();
+
+	if(!ok)
+	{
+		delete editor->reachability;
+		editor->reachability = nullptr;
+		gui.PopupDialog(wxT("Reachability"), wxT("No town has its temple on a walkable tile, there is nowhere to start from."), wxOK);
+		gui.RefreshView();
+		return;
+	}
+
+	const Reachability& reachability = *editor->reachability;
+	const std::vector<Reachability::Region>& regions = reachability.getRegions();
+
+	SearchResultWindow* result = gui.ShowSearchWindow();
+	result->Clear();
+	for(const Reachability::Region& region : regions)
+	{
+		result->AddPosition(wxString::Format(wxT("Isolated region, %lld tiles"), (long long)region.tiles), region.start);
+	}
+
+	const long long unreachable = (long long)(reachability.getWalkableCount() - reachability.getReachableCount());
+
+	wxString msg;
+	msg << (long long)reachability.getReachableCount() << wxT(" of ") << (long long)reachability.getWalkableCount()
+		<< wxT(" walkable tiles can be reached from the temples.");
+
+	if(unreachable == 0)
+	{
+		gui.PopupDialog(wxT("Reachability"), msg, wxOK);
+		gui.RefreshView();
+		return;
+	}
+
+	msg << wxT("\n") << unreachable << wxT(" tiles in ") << (long long)regions.size() << wxT(" isolated regions can't be reached.")
+		<< wxT("\n\nDo you want to remove the unreachable tiles from the map?");
+
+	if(gui.PopupDialog(wxT("Reachability"), msg, wxYES | wxNO) == wxID_YES)
+	{
+		editor->selection.clear();
+		editor->actionQueue->clear();
+
+		OnMapAnalyzeReachability::condition func(reachability);
+		gui.CreateLoadBar(wxT("Removing unreachable tiles..."));
+
+		long long removed = remove_if_TileOnMap(editor->map, func);
+
+		gui.DestroyLoadBar();
+
+		wxString done;
+		done << removed << wxT(" tiles deleted.");
+		gui.PopupDialog(wxT("Reachability"), done, wxOK);
+
+		editor->map.doChange();
 	}
+	gui.RefreshView();
+}
+
+void MainMenuBar::OnMapValidate(wxCommandEvent& WXUNUSED(event))
+{
+	if(gui.IsEditorOpen() == false)
+		return;
+
+	Editor* editor = gui.GetCurrentEditor();
+
+	MapValidator validator;
+	gui.CreateLoadBar(wxT("Validating map..."));
+	std::vector<MapValidator::Problem> problems = validator.validate(editor->map, std::max(settings.getInteger(Config::WORKER_THREADS), 1), true);
+	gui.DestroyLoadBar();
+
+	SearchResultWindow* result = gui.ShowSearchWindow();
+	result->Clear();
+	for(const MapValidator::Problem& problem : problems)
+	{
+		result->AddPosition(wxstr(problem.description), problem.position);
+	}
+
+	if(problems.empty())
+		gui.PopupDialog(wxT("Validate map"), wxT("No problems were found."), wxOK);
 }
 
 void MainMenuBar::OnClearHouseTiles(wxCommandEvent& WXUNUSED(event))
@@ -1451,234 +1734,153 @@ void MainMenuBar::OnMapStatistics(wxCommandEvent& WXUNUSED(event))
 	if(!gui.IsEditorOpen())
 		return;
 
-	gui.CreateLoadBar(wxT("Collecting data..."));
-
-	Map* map = &gui.GetCurrentMap();
-
-	int load_counter = 0;
-
-	uint64_t tile_count = 0;
-	uint64_t detailed_tile_count = 0;
-	uint64_t blocking_tile_count = 0;
-	uint64_t walkable_tile_count = 0;
-	double percent_pathable = 0.0;
-	double percent_detailed = 0.0;
-	uint64_t spawn_count = 0;
-	uint64_t creature_count = 0;
-	double creatures_per_spawn = 0.0;
-
-	uint64_t item_count = 0;
-	uint64_t loose_item_count = 0;
-	uint64_t depot_count = 0;
-	uint64_t action_item_count = 0;
-	uint64_t unique_item_count = 0;
-	uint64_t container_count = 0; // Only includes containers containing more than 1 item
-
-
-	int town_count = map->towns.count();
-	int house_count = map->houses.count();
-	std::map<uint32_t, uint32_t> town_sqm_count;
-	const Town* largest_town = nullptr;
-	uint64_t largest_town_size = 0;
-	uint64_t total_house_sqm = 0;
-	const House* largest_house = nullptr;
-	uint64_t largest_house_size = 0;
-	double houses_per_town = 0.0;
-	double sqm_per_house = 0.0;
-	double sqm_per_town = 0.0;
-
-
-	for(MapIterator mit = map->begin();
-			mit != map->end();
-			++mit)
-	{
-		Tile* tile = (*mit)->get();
-		if(load_counter % 8192 == 0) {
-			gui.SetLoadDone((unsigned int)(int64_t(load_counter) * 95ll / int64_t(map->getTileCount())));
-		}
+	Editor* editor = gui.GetCurrentEditor();
+	MapStatistics& statistics = editor->statistics;
+	const size_t threads = std::max(settings.getInteger(Config::WORKER_THREADS), 1);
 
-		if(tile->empty())
-			continue;
+	// The totals are only counted when an edit outside the actions invalidated them
+	if(!statistics.isValid())
+	{
+		gui.CreateLoadBar(wxT("Collecting data..."));
+		statistics.get(editor->map, threads, true);
+		gui.DestroyLoadBar();
+	}
 
-		tile_count += 1;
-
-		bool is_detailed = false;
-#define ANALYZE_ITEM(_item) {\
-	item_count += 1; \
-	if((_item)->isGroundTile() == false && (_item)->isBorder() == false) { \
-		is_detailed = true; \
-		ItemType& it = item_db[(_item)->getID()]; \
-		if(it.moveable) { \
-			loose_item_count += 1; \
-		} \
-		if(it.isDepot()) { \
-			depot_count += 1; \
-		} \
-		if((_item)->getActionID() > 0) { \
-			action_item_count += 1; \
-		} \
-		if((_item)->getUniqueID() > 0) { \
-			unique_item_count += 1; \
-		} \
-		if(Container* c = dynamic_cast<Container*>((_item))) { \
-			if(c->getVector().size()) { \
-				container_count += 1; \
-			} \
-		} \
-	} \
-}
-
-		if(tile->ground)
+	while(true)
+	{
+		wxDialog* dg = newd wxDialog(frame, wxID_ANY, wxT("Map Statistics"), wxDefaultPosition, wxDefaultSize, wxRESIZE_BORDER | wxCAPTION | wxCLOSE_BOX);
+		wxSizer* topsizer = newd wxBoxSizer(wxVERTICAL);
+		wxTextCtrl* text_field = newd wxTextCtrl(dg, wxID_ANY, wxstr(statistics.getReport(editor->map, MapStatistics::FORMAT_TEXT)), wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY);
+		text_field->SetMinSize(wxSize(400, 300));
+		topsizer->Add(text_field, wxSizerFlags(5).Expand());
+
+		wxSizer* choicesizer = newd wxBoxSizer(wxHORIZONTAL);
+		choicesizer->Add(newd wxButton(dg, wxID_OK, wxT("Export...")), wxSizerFlags(1).Center());
+		wxButton* verify_button = newd wxButton(dg, wxID_REFRESH, wxT("Recount"));
+		verify_button->SetToolTip(wxT("Counts the whole map again and checks the totals against it"));
+		verify_button->Bind(wxEVT_COMMAND_BUTTON_CLICKED, [dg](wxCommandEvent&) { dg->EndModal(wxID_REFRESH); });
+		choicesizer->Add(verify_button, wxSizerFlags(1).Center());
+		choicesizer->Add(newd wxButton(dg, wxID_CANCEL, wxT("OK")), wxSizerFlags(1).Center());
+		topsizer->Add(choicesizer, wxSizerFlags(1).Center());
+		dg->SetSizerAndFit(topsizer);
+
+		int ret = dg->ShowModal();
+		dg->Destroy();
+
+		if(ret == wxID_REFRESH)
 		{
-			ANALYZE_ITEM(tile->ground);
+			gui.CreateLoadBar(wxT("Collecting data..."));
+			bool matched = statistics.verify(editor->map, threads, true);
+			gui.DestroyLoadBar();
+
+			if(!matched)
+				gui.PopupDialog(wxT("Map Statistics"), wxT("The totals had drifted from the map, they have been corrected."), wxOK);
+			continue;
 		}
 
-		for(ItemVector::const_iterator item_iter = tile->items.begin();
-				item_iter != tile->items.end();
-				++item_iter)
+		if(ret == wxID_OK)
 		{
-			Item* item = *item_iter;
-			ANALYZE_ITEM(item);
+			wxFileDialog file(frame, wxT("Export statistics"), wxT(""), wxT(""),
+				wxT("JSON files (*.json)|*.json|CSV files (*.csv)|*.csv|Text files (*.txt)|*.txt"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+			if(file.ShowModal() == wxID_OK)
+			{
+				MapStatistics::Format format = MapStatistics::FORMAT_JSON;
+				if(file.GetFilterIndex() == 1)
+					format = MapStatistics::FORMAT_CSV;
+				else if(file.GetFilterIndex() == 2)
+					format = MapStatistics::FORMAT_TEXT;
+
+				if(!statistics.saveReport(editor->map, format, nstr(file.GetPath())))
+					gui.PopupDialog(wxT("Error"), wxT("Could not write ") + file.GetPath() + wxT("."), wxOK);
+			}
 		}
-#undef ANALYZE_ITEM
+		break;
+	}
+}
 
-		if(tile->spawn)
-			spawn_count += 1;
+void MainMenuBar::OnMapCompare(wxCommandEvent& WXUNUSED(event))
+{
+	if(!gui.IsEditorOpen())
+		return;
 
-		if(tile->creature)
-			creature_count += 1;
+	wxString wildcard = (settings.getInteger(Config::USE_OTGZ) != 0 ? MAP_LOAD_FILE_WILDCARD_OTGZ : MAP_LOAD_FILE_WILDCARD);
+	wxFileDialog filedlg(frame, wxT("Compare with map"), wxT(""), wxT(""), wildcard, wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+	if(filedlg.ShowModal() != wxID_OK)
+		return;
 
-		if(tile->isBlocking())
-			blocking_tile_count += 1;
-		else
-			walkable_tile_count += 1;
+	Editor* editor = gui.GetCurrentEditor();
 
-		if(is_detailed)
-			detailed_tile_count += 1;
+	// The other map is the older version, what it takes to turn it into this one is the patch
+	Map* base = newd Map();
+	gui.CreateLoadBar(wxT("Loading map..."));
+	bool loaded = base->open(nstr(filedlg.GetPath()));
+	gui.DestroyLoadBar();
 
-		load_counter += 1;
+	if(!loaded)
+	{
+		gui.PopupDialog(wxT("Error"), base->getError(), wxOK);
+		delete base;
+		return;
 	}
 
-	creatures_per_spawn =       (spawn_count != 0? double(creature_count) /      double(spawn_count) : -1.0);
-	percent_pathable    = 100.0*(tile_count != 0?  double(walkable_tile_count) / double(tile_count) : -1.0);
-	percent_detailed    = 100.0*(tile_count != 0?  double(detailed_tile_count) / double(tile_count) : -1.0);
+	if(!editor->diff)
+		editor->diff = newd MapDiff();
 
-	load_counter = 0;
-	Houses& houses = map->houses;
-	for(HouseMap::const_iterator hit = houses.begin();
-			hit != houses.end();
-			++hit)
-	{
-		const House* house = hit->second;
-
-		if(load_counter % 64)
-			gui.SetLoadDone((unsigned int)(95ll + int64_t(load_counter) * 5ll / int64_t(house_count)));
+	gui.CreateLoadBar(wxT("Comparing maps..."));
+	editor->diff->compare(*base, editor->map, std::max(settings.getInteger(Config::WORKER_THREADS), 1), true);
+	gui.DestroyLoadBar();
+	delete base;
 
-		if(house->size() > largest_house_size)
-		{
-			largest_house = house;
-			largest_house_size = house->size();
-		}
-		total_house_sqm += house->size();
-		town_sqm_count[house->townid] += house->size();
+	const MapDiff& diff = *editor->diff;
+	SearchResultWindow* result = gui.ShowSearchWindow();
+	result->Clear();
+	for(const Position& pos : diff.getChanges())
+	{
+		result->AddPosition(wxString::Format(wxT("Changed tile %d:%d:%d"), pos.x, pos.y, pos.z), pos);
 	}
+	gui.RefreshView();
 
-	houses_per_town = (town_count != 0?  double(house_count) /     double(town_count)  : -1.0);
-	sqm_per_house   = (house_count != 0? double(total_house_sqm) / double(house_count) : -1.0);
-	sqm_per_town    = (town_count != 0?  double(total_house_sqm) / double(town_count)  : -1.0);
+	wxString msg;
+	msg << (long long)diff.getChanges().size() << wxT(" tiles in ") << (long long)diff.getChangedLeafCount() << wxT(" of ")
+		<< (long long)diff.getLeafCount() << wxT(" areas differ from ") << filedlg.GetFilename() << wxT(".");
 
-	Towns& towns = map->towns;
-	for(std::map<uint32_t, uint32_t>::iterator town_iter = town_sqm_count.begin();
-			town_iter != town_sqm_count.end();
-			++town_iter)
+	if(diff.getChanges().empty())
 	{
-		// No load bar for this, load is non-existant
-		uint32_t town_id = town_iter->first;
-		uint32_t town_sqm = town_iter->second;
-		Town* town = towns.getTown(town_id);
-		if(town && town_sqm > largest_town_size)
-		{
-			largest_town = town;
-			largest_town_size = town_sqm;
-		} else {
-			// Non-existant town!
-		}
+		gui.PopupDialog(wxT("Compare maps"), msg, wxOK);
+		return;
 	}
 
-	gui.DestroyLoadBar();
+	msg << wxT("\n\nDo you want to save the differences as a patch?");
+	if(gui.PopupDialog(wxT("Compare maps"), msg, wxYES | wxNO) != wxID_YES)
+		return;
 
-	std::ostringstream os;
-	os.setf(std::ios::fixed, std::ios::floatfield);
-	os.precision(2);
-	os << "Map statistics for the map \"" << map->getMapDescription() << "\"\n";
-	os << "\tTile data:\n";
-	os << "\t\tTotal number of tiles: " << tile_count << "\n";
-	os << "\t\tNumber of pathable tiles: " << walkable_tile_count << "\n";
-	os << "\t\tNumber of unpathable tiles: " << blocking_tile_count << "\n";
-	if(percent_pathable >= 0.0)
-		os << "\t\tPercent walkable tiles: " << percent_pathable << "%\n";
-	os << "\t\tDetailed tiles: " << detailed_tile_count << "\n";
-	if(percent_detailed >= 0.0)
-		os << "\t\tPercent detailed tiles: " << percent_detailed << "%\n";
-
-	os << "\tItem data:\n";
-	os << "\t\tTotal number of items: " << item_count << "\n";
-	os << "\t\tNumber of moveable tiles: " << loose_item_count << "\n";
-	os << "\t\tNumber of depots: " << depot_count << "\n";
-	os << "\t\tNumber of containers: " << container_count << "\n";
-	os << "\t\tNumber of items with Action ID: " << action_item_count << "\n";
-	os << "\t\tNumber of items with Unique ID: " << unique_item_count << "\n";
-
-	os << "\tCreature data:\n";
-	os << "\t\tTotal creature count: " << creature_count << "\n";
-	os << "\t\tTotal spawn count: " << spawn_count << "\n";
-	if(creatures_per_spawn >= 0)
-		os << "\t\tMean creatures per spawn: " << creatures_per_spawn << "\n";
-
-	os << "\tTown/House data:\n";
-	os << "\t\tTotal number of towns: " << town_count << "\n";
-	os << "\t\tTotal number of houses: " << house_count << "\n";
-	if(houses_per_town >= 0)
-		os << "\t\tMean houses per town: " << houses_per_town << "\n";
-	os << "\t\tTotal amount of housetiles: " << total_house_sqm << "\n";
-	if(sqm_per_house >= 0)
-		os << "\t\tMean tiles per house: " << sqm_per_house << "\n";
-	if(sqm_per_town >= 0)
-		os << "\t\tMean tiles per town: " << sqm_per_town << "\n";
-
-	if(largest_town)
-		os << "\t\tLargest Town: \"" << largest_town->getName() << "\" (" << largest_town_size << " sqm)\n";
-	if(largest_house)
-		os << "\t\tLargest House: \"" << largest_house->name << "\" (" << largest_house_size << " sqm)\n";
-
-	os << "\n";
-	os << "Generated by Remere's Map Editor version " + __RME_VERSION__ + "\n";
-
-
-    wxDialog* dg = newd wxDialog(frame, wxID_ANY, wxT("Map Statistics"), wxDefaultPosition, wxDefaultSize, wxRESIZE_BORDER | wxCAPTION | wxCLOSE_BOX);
-	wxSizer* topsizer = newd wxBoxSizer(wxVERTICAL);
-	wxTextCtrl* text_field = newd wxTextCtrl(dg, wxID_ANY, wxstr(os.str()), wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY);
-	text_field->SetMinSize(wxSize(400, 300));
-	topsizer->Add(text_field, wxSizerFlags(5).Expand());
-
-	wxSizer* choicesizer = newd wxBoxSizer(wxHORIZONTAL);
-	wxButton* export_button = newd wxButton(dg, wxID_OK, wxT("Export as XML"));
-	choicesizer->Add(export_button, wxSizerFlags(1).Center());
-	export_button->Enable(false);
-	choicesizer->Add(newd wxButton(dg, wxID_CANCEL, wxT("OK")), wxSizerFlags(1).Center());
-	topsizer->Add(choicesizer, wxSizerFlags(1).Center());
-	dg->SetSizerAndFit(topsizer);
-
-	int ret = dg->ShowModal();
-
-	if(ret == wxID_OK)
-	{
-		//std::cout << "XML EXPORT";
-	}
-	else if(ret == wxID_CANCEL)
-	{
-		//std::cout << "OK";
-	}
+	wxFileDialog file(frame, wxT("Save patch"), wxT(""), wxT(""), wxT("Map patches (*.rmepatch)|*.rmepatch"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+	if(file.ShowModal() == wxID_OK && !diff.savePatch(nstr(file.GetPath())))
+		gui.PopupDialog(wxT("Error"), wxT("Could not write ") + file.GetPath() + wxT("."), wxOK);
+}
+
+void MainMenuBar::OnMapApplyPatch(wxCommandEvent& WXUNUSED(event))
+{
+	if(!gui.IsEditorOpen())
+		return;
+
+	wxFileDialog file(frame, wxT("Apply map patch"), wxT(""), wxT(""), wxT("Map patches (*.rmepatch)|*.rmepatch"), wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+	if(file.ShowModal() != wxID_OK)
+		return;
+
+	Editor* editor = gui.GetCurrentEditor();
+	editor->selection.clear();
+
+	size_t applied = 0;
+	wxString error;
+	bool ok = MapDiff::ApplyPatch(nstr(file.GetPath()), *editor, applied, error);
+	gui.RefreshView();
+
+	wxString msg;
+	if(!ok)
+		msg << error << wxT("\n");
+	msg << (long long)applied << wxT(" tiles replaced.");
+	gui.PopupDialog(ok ? wxT("Apply map patch") : wxT("Error"), msg, wxOK);
 }
 
 void MainMenuBar::OnMapCleanup(wxCommandEvent& WXUNUSED(event))
@@ -1686,7 +1888,10 @@ void MainMenuBar::OnMapCleanup(wxCommandEvent& WXUNUSED(event))
 	int ok = gui.PopupDialog(wxT("Clean map"), wxT("Do you want to remove all invalid items from the map?"), wxYES | wxNO);
 
 	if(ok == wxID_YES)
+	{
 		gui.GetCurrentMap().cleanInvalidTiles(true);
+		gui.GetCurrentEditor()->statistics.invalidate();
+	}
 }
 
 void MainMenuBar::OnMapProperties(wxCommandEvent& WXUNUSED(event))
@@ -1759,6 +1964,8 @@ void MainMenuBar::OnChangeViewSettings(wxCommandEvent& event)
 	settings.setInteger(Config::SHOW_HOUSES, IsItemChecked(MenuBar::SHOW_HOUSES));
 	settings.setInteger(Config::HIGHLIGHT_ITEMS, IsItemChecked(MenuBar::HIGHLIGHT_ITEMS));
 	settings.setInteger(Config::SHOW_BLOCKING, IsItemChecked(MenuBar::SHOW_PATHING));
+	settings.setInteger(Config::SHOW_REACHABILITY, IsItemChecked(MenuBar::SHOW_REACHABILITY));
+	settings.setInteger(Config::SHOW_MAP_DIFF, IsItemChecked(MenuBar::SHOW_MAP_DIFF));
 
 	gui.RefreshView();
 }
@@ -46,6 +46,7 @@ namespace MenuBar
 		REDO,
 		FIND_ITEM,
 		REPLACE_ITEM,
+		REPLACE_ITEMS_TABLE,
 		SEARCH_EVERYTHING,
 		SEARCH_UNIQUE,
 		SEARCH_ACTION,
@@ -75,9 +76,13 @@ namespace MenuBar
 		MAP_REMOVE_ITEMS,
 		MAP_REMOVE_CORPSES,
 		MAP_REMOVE_UNREACHABLE_TILES,
+		MAP_ANALYZE_REACHABILITY,
+		MAP_VALIDATE,
 		MAP_CLEAN_HOUSE_ITEMS,
 		MAP_PROPERTIES,
 		MAP_STATISTICS,
+		MAP_COMPARE,
+		MAP_APPLY_PATCH,
 		NEW_VIEW,
 		TOGGLE_FULLSCREEN,
 		SHOW_SHADE,
@@ -95,6 +100,8 @@ namespace MenuBar
 		SHOW_ONLY_MODIFIED,
 		SHOW_HOUSES,
 		SHOW_PATHING,
+		SHOW_REACHABILITY,
+		SHOW_MAP_DIFF,
 		WIN_MINIMAP,
 		NEW_PALETTE,
 		TAKE_SCREENSHOT,
@@ -188,6 +195,8 @@ public:
 	void OnMapRemoveItems(wxCommandEvent& event);
 	void OnMapRemoveCorpses(wxCommandEvent& event);
 	void OnMapRemoveUnreachable(wxCommandEvent& event);
+	void OnMapAnalyzeReachability(wxCommandEvent& event);
+	void OnMapValidate(wxCommandEvent& event);
 	void OnClearHouseTiles(wxCommandEvent& event);
 	void OnClearModifiedState(wxCommandEvent& event);
 	void OnToggleAutomagic(wxCommandEvent& event);
@@ -197,6 +206,7 @@ public:
 	void OnPaste(wxCommandEvent& event);
 	void OnSearchForItem(wxCommandEvent& event);
 	void OnReplaceItem(wxCommandEvent& event);
+	void OnReplaceItemsTable(wxCommandEvent& event);
 	void OnSearchForStuff(wxCommandEvent& event);
 	void OnSearchForUnique(wxCommandEvent& event);
 	void OnSearchForAction(wxCommandEvent& event);
@@ -211,6 +221,8 @@ public:
 	void OnMapCleanup(wxCommandEvent& event);
 	void OnMapProperties(wxCommandEvent& event);
 	void OnMapStatistics(wxCommandEvent& event);
+	void OnMapCompare(wxCommandEvent& event);
+	void OnMapApplyPatch(wxCommandEvent& event);
 
 	// View Menu
 	void OnNewView(wxCommandEvent& event);
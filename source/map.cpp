@@ -311,6 +311,7 @@ void Map::cleanInvalidTiles(bool showdialog)
 		if(tile->size() == 0)
 			continue;
 
+		bool changed = false;
 		for(ItemVector::iterator item_iter = tile->items.begin(); item_iter != tile->items.end();)
 		{
 			if(item_db.typeExists((*item_iter)->getID()))
@@ -319,9 +320,17 @@ void Map::cleanInvalidTiles(bool showdialog)
 			{
 				delete *item_iter;
 				item_iter = tile->items.erase(item_iter);
+				changed = true;
 			}
 		}
 
+		// Changed in place, its house counts it again
+		if(changed && tile->isHouseTile())
+		{
+			if(House* house = houses.getHouse(tile->getHouseID()))
+				house->updateTile(tile);
+		}
+
 		++tiles_done;
 		if(showdialog && tiles_done % 0x10000 == 0) {
 			gui.SetLoadDone(int(tiles_done / double(getTileCount()) * 100.0));
@@ -399,116 +408,30 @@ void Map::setSpawnFilename(const std::string&  new_spawnfile)
 
 bool Map::addSpawn(Tile* tile)
 {
-	Spawn* spawn = tile->spawn;
-	if(spawn)
+	if(tile->spawn)
 	{
-		int z = tile->getZ();
-		int start_x = tile->getX() - spawn->getSize();
-		int start_y = tile->getY() - spawn->getSize();
-		int end_x = tile->getX() + spawn->getSize();
-		int end_y = tile->getY() + spawn->getSize();
-
-		for(int y = start_y; y <= end_y; ++y)
-		{
-			for(int x = start_x; x <= end_x; ++x)
-			{
-				TileLocation* ctile_loc = createTileL(x, y, z);
-				ctile_loc->increaseSpawnCount();
-			}
-		}
 		spawns.addSpawn(tile);
 		return true;
 	}
 	return false;
 }
 
-void Map::removeSpawnInternal(Tile* tile)
-{
-	Spawn* spawn = tile->spawn;
-	ASSERT(spawn);
-
-	int z = tile->getZ();
-	int start_x = tile->getX() - spawn->getSize();
-	int start_y = tile->getY() - spawn->getSize();
-	int end_x = tile->getX() + spawn->getSize();
-	int end_y = tile->getY() + spawn->getSize();
-
-	for(int y = start_y; y <= end_y; ++y)
-	{
-		for(int x = start_x; x <= end_x; ++x)
-		{
-			TileLocation* ctile_loc = getTileL(x, y, z);
-			if(ctile_loc != nullptr && ctile_loc->getSpawnCount() > 0)
-				ctile_loc->decreaseSpawnCount();
-		}
-	}
-}
-
 void Map::removeSpawn(Tile* tile)
 {
 	if(tile->spawn)
-	{
-		removeSpawnInternal(tile);
 		spawns.removeSpawn(tile);
-	}
 }
 
-SpawnList Map::getSpawnList(Tile* where)
+SpawnList Map::getSpawnList(const Position& position)
 {
 	SpawnList list;
-	TileLocation* tile_loc = where->getLocation();
-	if(tile_loc)
+	std::vector<Position> centres;
+	spawns.getSpawns(position, centres);
+	for(const Position& centre : centres)
 	{
-		if(tile_loc->getSpawnCount() > 0)
-		{
-			uint32_t found = 0;
-			if(where->spawn)
-			{
-				++found;
-				list.push_back(where->spawn);
-			}
-
-			// Scans the border tiles in an expanding square around the original spawn
-			int z = where->getZ();
-			int start_x = where->getX() - 1, end_x = where->getX() + 1;
-			int start_y = where->getY() - 1, end_y = where->getY() + 1;
-			while(found != tile_loc->getSpawnCount())
-			{
-				for(int x = start_x; x <= end_x; ++x)
-				{
-					Tile* tile = getTile(x, start_y, z);
-					if(tile && tile->spawn)
-					{
-						list.push_back(tile->spawn);
-						++found;
-					}
-					tile = getTile(x, end_y, z);
-					if(tile && tile->spawn)
-					{
-						list.push_back(tile->spawn);
-						++found;
-					}
-				}
-
-				for(int y = start_y + 1; y < end_y; ++y)
-				{
-					Tile* tile = getTile(start_x, y, z);
-					if(tile && tile->spawn)
-					{
-						list.push_back(tile->spawn);
-						++found;
-					}
-					tile = getTile(end_x, y, z);
-					if(tile && tile->spawn)
-					{
-						list.push_back(tile->spawn);
-						++found;
-					}
-				}
-				--start_x, --start_y;
-				++end_x, ++end_y;
-			}
-		}
+		Tile* tile = getTile(centre);
+		if(tile && tile->spawn)
+			list.push_back(tile->spawn);
 	}
 	return list;
 }
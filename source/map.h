@@ -66,10 +66,10 @@ public:
 	void removeSpawn(Tile* tile);
 	void removeSpawn(const Position& position) { removeSpawn(getTile(position)); }
 
-	// Returns all possible spawns on the target tile
-	SpawnList getSpawnList(Tile* t);
-	SpawnList getSpawnList(const Position& position) { return getSpawnList(getTile(position)); }
-	SpawnList getSpawnList(int32_t x, int32_t y, int32_t z) { return getSpawnList(getTile(x, y, z)); }
+	// Returns all spawns covering the target tile
+	SpawnList getSpawnList(const Position& position);
+	SpawnList getSpawnList(Tile* t) { return getSpawnList(t->getPosition()); }
+	SpawnList getSpawnList(int32_t x, int32_t y, int32_t z) { return getSpawnList(Position(x, y, z)); }
 
 	// Returns true if the map has been saved
 	// ie. it knows which file it should be saved to
@@ -99,8 +99,6 @@ protected:
 	bool open(const std::string identifier);
 
 protected:
-	void removeSpawnInternal(Tile* tile);
-
 	wxArrayString warnings;
 	wxString error;
 
@@ -203,6 +201,8 @@ inline long long remove_if_TileOnMap(Map& map, RemoveIfType& remove_if)
 		Tile* tile = (*tileiter)->get();
 		if(remove_if(map, tile, removed, done, total))
 		{
+			if(House* house = map.houses.getHouse(tile->getHouseID()))
+				house->removeTile(tile);
 			map.setTile(tile->getPosition(), nullptr, true);
 			++removed;
 		}
@@ -224,6 +224,7 @@ inline long long remove_if_ItemOnMap(Map& map, RemoveIfType& remove_if) {
 	while(tileiter != end)
 	{
 		Tile* tile = (*tileiter)->get();
+		const long long removedBefore = removed;
 
 		if(tile->ground)
 		{
@@ -248,6 +249,13 @@ inline long long remove_if_ItemOnMap(Map& map, RemoveIfType& remove_if) {
 			else
 				++itemiter;
 		}
+
+		// The tile is changed in place, its house counts it again
+		if(removed != removedBefore && tile->isHouseTile())
+		{
+			if(House* house = map.houses.getHouse(tile->getHouseID()))
+				house->updateTile(tile);
+		}
 		++tileiter;
 		++done;
 	}
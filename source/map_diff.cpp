@@ -0,0 +1,673 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "map_diff.h"
+#include "map.h"
+#include "editor.h"
+#include "action.h"
+#include "live_socket.h"
+#include "tile_record.h"
+#include "iomap_otbm.h"
+#include "gui.h"
+
+#include <fstream>
+
+static const char PATCH_MAGIC[4] = {'R', 'M', 'E', 'P'};
+static const uint32_t PATCH_VERSION = 1;
+
+static const int TILES_PER_LEAF = MAP_HEIGHT * 16;
+// Far more than the tiles of a leaf need, a block claiming more is damaged
+static const uint32_t PATCH_MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+template <typename T>
+static void diffWrite(std::vector<uint8_t>& out, T value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static void patchWrite(std::ostream& out, T value)
+{
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool patchRead(std::istream& in, T& value)
+{
+	in.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return !in.fail();
+}
+
+// Reads a block back, never past its end
+class DiffReader
+{
+public:
+	DiffReader(const std::vector<uint8_t>& data) : data(data), offset(0), ok(true) {}
+
+	template <typename T>
+	T read()
+	{
+		T value = T();
+		if (offset + sizeof(T) > data.size()) {
+			ok = false;
+			return value;
+		}
+		memcpy(&value, &data[offset], sizeof(T));
+		offset += sizeof(T);
+		return value;
+	}
+
+	bool atEnd() const { return offset >= data.size(); }
+
+	const std::vector<uint8_t>& data;
+	size_t offset;
+	bool ok;
+};
+
+// Tiles with nothing on them count as no tile, the editor leaves those
+// behind wherever something was erased
+static bool IsBlank(const Tile* tile)
+{
+	return !tile || (tile->empty() && tile->getHouseID() == 0 && tile->getMapFlags() == 0);
+}
+
+// The tile as a patch stores it, without its position
+static void WriteTile(std::vector<uint8_t>& out, TileRecordWriter& records, Tile* tile)
+{
+	records.write(out, IsBlank(tile) ? nullptr : tile);
+}
+
+static uint64_t HashBytes(const uint8_t* data, size_t size)
+{
+	// FNV-1a, never 0 so it doesn't collide with a missing tile
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 0x100000001B3ull;
+	}
+	return hash ? hash : 1;
+}
+
+// 0 for no tile
+static uint64_t HashTile(Tile* tile, TileRecordWriter& records, std::vector<uint8_t>& scratch)
+{
+	if (IsBlank(tile)) {
+		return 0;
+	}
+
+	scratch.clear();
+	WriteTile(scratch, records, tile);
+	return HashBytes(scratch.data(), scratch.size());
+}
+
+// Hashes every tile of the leaf into 'hashes', floor by floor, and returns
+// a hash of the whole leaf
+static uint64_t HashLeaf(QTreeNode* leaf, TileRecordWriter& records, std::vector<uint8_t>& scratch, uint64_t* hashes)
+{
+	std::fill(hashes, hashes + TILES_PER_LEAF, 0);
+	if (!leaf) {
+		return 0;
+	}
+
+	for (int z = 0; z < MAP_HEIGHT; ++z) {
+		Floor* floor = leaf->getFloor(z);
+		if (!floor) {
+			continue;
+		}
+
+		for (int i = 0; i < 16; ++i) {
+			hashes[z * 16 + i] = HashTile(floor->locs[i].get(), records, scratch);
+		}
+	}
+	return HashBytes(reinterpret_cast<const uint8_t*>(hashes), TILES_PER_LEAF * sizeof(uint64_t));
+}
+
+static bool LeafCorner(QTreeNode* leaf, Position& corner)
+{
+	for (int z = 0; z < MAP_HEIGHT; ++z) {
+		if (Floor* floor = leaf->getFloor(z)) {
+			corner = floor->locs[0].getPosition();
+			corner.z = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+// A changed tile as a block holds it
+static void WriteChange(std::vector<uint8_t>& out, TileRecordWriter& records, const Position& pos, Tile* tile)
+{
+	diffWrite<uint16_t>(out, pos.x);
+	diffWrite<uint16_t>(out, pos.y);
+	diffWrite<uint8_t>(out, pos.z);
+	WriteTile(out, records, tile);
+}
+
+// The spawns of the newer map, which are read before its tiles. They are
+// put on tiles of their own and moved to the tiles of the file once those
+// are read.
+class MapDiff::SpawnSink : public OTBMTileSink
+{
+public:
+	SpawnSink(Map& map) : map(map) {}
+
+	virtual Tile* createTile(const Position& position)
+	{
+		return map.allocator(map.createTileL(position));
+	}
+
+	virtual Tile* createCreatureTile(const Position& position)
+	{
+		creatureTiles.push_back(position);
+		return createTile(position);
+	}
+
+	virtual House* getHouse(uint32_t)
+	{
+		return nullptr;
+	}
+
+	virtual void addTile(Tile* tile, House*)
+	{
+		map.setTile(tile->getPosition(), tile);
+	}
+
+	// Loading a map drops the creatures on tiles the file doesn't have,
+	// only spawns get a tile of their own
+	void removeCreatureTiles()
+	{
+		for (const Position& pos : creatureTiles) {
+			map.setTile(pos, nullptr, true);
+		}
+		creatureTiles.clear();
+	}
+
+protected:
+	Map& map;
+	std::vector<Position> creatureTiles;
+};
+
+// Compares the tiles of the newer map with the older one as they are read.
+// A tile area of the file holds whole floors of leaves, its tiles are kept
+// until the reader moves on to another area and then compared floor by
+// floor. A floor whose tiles come in several parts, which a map file may
+// but rarely does, gets a block for every part, applied in order they add
+// up to the right tiles.
+class MapDiff::FileSink : public OTBMTileSink
+{
+public:
+	FileSink(MapDiff& diff, Map& base, Map& info, bool showdialog) :
+		diff(diff), base(base), info(info), showdialog(showdialog), pending(newd BaseMap()), area(0)
+	{
+		//
+	}
+
+	~FileSink()
+	{
+		delete pending;
+	}
+
+	virtual Tile* createTile(const Position& position)
+	{
+		if (!position.isValid()) {
+			return nullptr;
+		}
+
+		const uint64_t tileArea = Key(Position(position.x & ~0xFF, position.y & ~0xFF, position.z));
+		if (tileArea != area) {
+			comparePending();
+			area = tileArea;
+		}
+
+		// Loading the map keeps the first of duplicate tiles
+		if (pending->getTile(position)) {
+			return nullptr;
+		}
+		return pending->allocator(pending->createTileL(position));
+	}
+
+	virtual House* getHouse(uint32_t house_id)
+	{
+		House* house = info.houses.getHouse(house_id);
+		if (!house) {
+			house = newd House(info);
+			house->id = house_id;
+			info.houses.addHouse(house);
+		}
+		return house;
+	}
+
+	virtual void addTile(Tile* tile, House* house)
+	{
+		tile->setHouse(house);
+		if (Tile* spawnTile = info.getTile(tile->getPosition())) {
+			std::swap(tile->spawn, spawnTile->spawn);
+			std::swap(tile->creature, spawnTile->creature);
+		}
+		pending->setTile(tile->getPosition(), tile);
+	}
+
+	virtual void progress(size_t read, size_t size)
+	{
+		if (showdialog) {
+			gui.SetLoadDone(std::min<int32_t>(99, static_cast<int32_t>(100.0 * read / size)));
+		}
+	}
+
+	void comparePending()
+	{
+		compareTiles(*pending);
+		delete pending;
+		pending = newd BaseMap();
+	}
+
+	// Compares the floors of the source with the older map, floors seen
+	// before only add the tiles the source has
+	void compareTiles(BaseMap& source)
+	{
+		std::vector<QTreeNode*> leaves;
+		source.getLeaves(leaves);
+		for (QTreeNode* leaf : leaves) {
+			Position corner;
+			LeafCorner(leaf, corner);
+			QTreeNode* baseLeaf = base.getLeaf(corner.x, corner.y);
+
+			raw.clear();
+			uint32_t tiles = 0;
+			bool hasTiles = false;
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaf->getFloor(z);
+				if (!floor) {
+					continue;
+				}
+
+				Floor* baseFloor = baseLeaf ? baseLeaf->getFloor(z) : nullptr;
+				const bool again = !visited.insert(Key(Position(corner.x, corner.y, z))).second;
+				for (int i = 0; i < 16; ++i) {
+					Tile* tile = floor->locs[i].get();
+					hasTiles = hasTiles || tile;
+					if (again && IsBlank(tile)) {
+						continue;
+					}
+
+					// A tile of a floor seen before was written as removed then
+					if (!again && HashTile(tile, records, scratch) == HashTile(baseFloor ? baseFloor->locs[i].get() : nullptr, records, scratch)) {
+						continue;
+					}
+
+					const Position pos = floor->locs[i].getPosition();
+					WriteChange(raw, records, pos, tile);
+					diff.addChange(pos);
+					++tiles;
+				}
+			}
+
+			Position baseCorner;
+			if (hasTiles && (!baseLeaf || !LeafCorner(baseLeaf, baseCorner)) && added.insert(Key(corner)).second) {
+				++diff.leafCount;
+			}
+			addBlock(tiles);
+		}
+	}
+
+	// The floors of the older map the file has no tiles on
+	void compareRemoved()
+	{
+		std::vector<QTreeNode*> leaves;
+		base.getLeaves(leaves);
+		for (QTreeNode* leaf : leaves) {
+			Position corner;
+			LeafCorner(leaf, corner);
+
+			raw.clear();
+			uint32_t tiles = 0;
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaf->getFloor(z);
+				if (!floor || visited.count(Key(Position(corner.x, corner.y, z))) != 0) {
+					continue;
+				}
+
+				for (int i = 0; i < 16; ++i) {
+					if (IsBlank(floor->locs[i].get())) {
+						continue;
+					}
+
+					const Position pos = floor->locs[i].getPosition();
+					WriteChange(raw, records, pos, nullptr);
+					diff.addChange(pos);
+					++tiles;
+				}
+			}
+			addBlock(tiles);
+		}
+	}
+
+protected:
+	void addBlock(uint32_t tiles)
+	{
+		if (tiles == 0) {
+			return;
+		}
+
+		Block block;
+		block.tiles = tiles;
+		block.rawSize = raw.size();
+		block.data = LiveSocket::compressData(raw.data(), raw.size());
+		diff.blocks.push_back(std::move(block));
+	}
+
+	MapDiff& diff;
+	Map& base;
+	// The header, houses and spawns of the newer map
+	Map& info;
+	bool showdialog;
+
+	// The tiles of the tile area being read
+	BaseMap* pending;
+	uint64_t area;
+	// Every floor of a leaf the file had tiles on
+	std::unordered_set<uint64_t> visited;
+	// Leaves only the newer map has
+	std::unordered_set<uint64_t> added;
+
+	TileRecordWriter records;
+	std::vector<uint8_t> scratch;
+	std::vector<uint8_t> raw;
+};
+
+MapDiff::MapDiff() :
+	leafCount(0),
+	changedLeafCount(0)
+{
+	//
+}
+
+void MapDiff::clear()
+{
+	blocks.clear();
+	changes.clear();
+	changed.clear();
+	leafCount = 0;
+	changedLeafCount = 0;
+}
+
+void MapDiff::addChange(const Position& pos)
+{
+	// A tile of a floor read in parts may be written twice
+	if (changed.insert(Key(pos)).second) {
+		changes.push_back(pos);
+	}
+}
+
+bool MapDiff::isChanged(const Position& pos) const
+{
+	return changed.count(Key(pos)) != 0;
+}
+
+void MapDiff::compare(Map& base, Map& target, size_t threads, bool showdialog)
+{
+	threads = std::max<size_t>(threads, 1);
+	clear();
+
+	// A leaf only one of the maps has is compared against nothing
+	std::map<uint64_t, std::pair<QTreeNode*, QTreeNode*>> pairs;
+	std::vector<QTreeNode*> mapLeaves;
+	base.getLeaves(mapLeaves);
+	for (QTreeNode* leaf : mapLeaves) {
+		Position corner;
+		if (LeafCorner(leaf, corner)) {
+			pairs[Key(corner)].first = leaf;
+		}
+	}
+	mapLeaves.clear();
+	target.getLeaves(mapLeaves);
+	for (QTreeNode* leaf : mapLeaves) {
+		Position corner;
+		if (LeafCorner(leaf, corner)) {
+			pairs[Key(corner)].second = leaf;
+		}
+	}
+
+	std::vector<std::pair<QTreeNode*, QTreeNode*>> leaves;
+	leaves.reserve(pairs.size());
+	for (const auto& entry : pairs) {
+		leaves.push_back(entry.second);
+	}
+	leafCount = leaves.size();
+
+	struct StripeResult
+	{
+		std::vector<Block> blocks;
+		std::vector<Position> changes;
+	};
+	std::vector<StripeResult> results(threads);
+	StripeProgress progress(leaves.size(), showdialog);
+
+	ParallelStripes(leaves.size(), threads, [&](size_t stripe, size_t begin, size_t end) {
+		StripeResult& result = results[stripe];
+		TileRecordWriter records;
+		std::vector<uint8_t> scratch;
+		std::vector<uint8_t> raw;
+		uint64_t before[TILES_PER_LEAF];
+		uint64_t after[TILES_PER_LEAF];
+
+		for (size_t i = begin; i < end; ++i) {
+			QTreeNode* baseLeaf = leaves[i].first;
+			QTreeNode* targetLeaf = leaves[i].second;
+			if (HashLeaf(baseLeaf, records, scratch, before) != HashLeaf(targetLeaf, records, scratch, after)) {
+				Position corner;
+				LeafCorner(targetLeaf ? targetLeaf : baseLeaf, corner);
+
+				raw.clear();
+				uint32_t tiles = 0;
+				for (int t = 0; t < TILES_PER_LEAF; ++t) {
+					if (before[t] == after[t]) {
+						continue;
+					}
+
+					const int z = t / 16;
+					const Position pos(corner.x + ((t % 16) >> 2), corner.y + (t & 3), z);
+					Floor* floor = targetLeaf ? targetLeaf->getFloor(z) : nullptr;
+					WriteChange(raw, records, pos, floor ? floor->locs[t % 16].get() : nullptr);
+
+					result.changes.push_back(pos);
+					++tiles;
+				}
+
+				// Equal tiles with different leaf hashes can't happen, but
+				// an empty block would be harmless anyway
+				if (tiles > 0) {
+					Block block;
+					block.tiles = tiles;
+					block.rawSize = raw.size();
+					block.data = LiveSocket::compressData(raw.data(), raw.size());
+					result.blocks.push_back(std::move(block));
+				}
+			}
+			progress.advance(stripe);
+		}
+	});
+
+	// Stripes are consecutive runs of the sorted leaves, so this keeps the order
+	for (StripeResult& result : results) {
+		for (Block& block : result.blocks) {
+			blocks.push_back(std::move(block));
+		}
+		for (const Position& pos : result.changes) {
+			changes.push_back(pos);
+			changed.insert(Key(pos));
+		}
+	}
+	changedLeafCount = blocks.size();
+}
+
+bool MapDiff::compareFile(Map& base, const std::string& filename, bool showdialog, wxString& error)
+{
+	clear();
+
+	const FileName identifier(wxstr(filename));
+	Map info;
+	IOMapOTBM loader(info.getVersion());
+	if (!loader.loadMapInfo(info, identifier)) {
+		error = loader.getError();
+		return false;
+	}
+
+	// A map without spawns is compared as one
+	SpawnSink spawns(info);
+	loader.importSpawns(info, identifier, info.spawnfile, Position(), spawns);
+
+	std::vector<QTreeNode*> baseLeaves;
+	base.getLeaves(baseLeaves);
+	leafCount = baseLeaves.size();
+	baseLeaves = std::vector<QTreeNode*>();
+
+	FileSink sink(*this, base, info, showdialog);
+	if (!loader.streamTiles(info, identifier, sink)) {
+		error = loader.getError();
+		clear();
+		return false;
+	}
+	sink.comparePending();
+
+	// What is left are the spawns on tiles the file doesn't have
+	spawns.removeCreatureTiles();
+	sink.compareTiles(info);
+	sink.compareRemoved();
+
+	// In the order compare gives them, by leaf, then by floor
+	std::sort(changes.begin(), changes.end(), [](const Position& a, const Position& b) {
+		const uint64_t leafA = Key(Position(a.x & ~3, a.y & ~3, 0));
+		const uint64_t leafB = Key(Position(b.x & ~3, b.y & ~3, 0));
+		if (leafA != leafB) {
+			return leafA < leafB;
+		}
+		if (a.z != b.z) {
+			return a.z < b.z;
+		}
+		return a.x != b.x ? a.x < b.x : a.y < b.y;
+	});
+	for (size_t i = 0; i < changes.size(); ++i) {
+		if (i == 0 || Key(Position(changes[i].x & ~3, changes[i].y & ~3, 0)) != Key(Position(changes[i - 1].x & ~3, changes[i - 1].y & ~3, 0))) {
+			++changedLeafCount;
+		}
+	}
+	return true;
+}
+
+bool MapDiff::savePatch(const std::string& filename) const
+{
+	std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+
+	file.write(PATCH_MAGIC, sizeof(PATCH_MAGIC));
+	patchWrite<uint32_t>(file, PATCH_VERSION);
+	patchWrite<uint32_t>(file, blocks.size());
+	patchWrite<uint32_t>(file, changes.size());
+	for (const Block& block : blocks) {
+		patchWrite<uint32_t>(file, block.tiles);
+		patchWrite<uint32_t>(file, block.rawSize);
+		patchWrite<uint32_t>(file, block.data.size());
+		file.write(reinterpret_cast<const char*>(block.data.data()), block.data.size());
+	}
+	return file.good();
+}
+
+bool MapDiff::ApplyPatch(const std::string& filename, Editor& editor, size_t& applied, wxString& error)
+{
+	applied = 0;
+
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		error = wxT("Could not open ") + wxstr(filename) + wxT(".");
+		return false;
+	}
+
+	char magic[sizeof(PATCH_MAGIC)];
+	uint32_t version = 0;
+	uint32_t blockCount = 0;
+	uint32_t tileCount = 0;
+	file.read(magic, sizeof(magic));
+	if (file.fail() || memcmp(magic, PATCH_MAGIC, sizeof(magic)) != 0 ||
+		!patchRead(file, version) || version != PATCH_VERSION ||
+		!patchRead(file, blockCount) || !patchRead(file, tileCount)) {
+		error = wxstr(filename) + wxT(" is not a map patch.");
+		return false;
+	}
+
+	Map& map = editor.map;
+	TileRecordReader records;
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> raw;
+
+	bool ok = true;
+	BatchAction* batch = editor.actionQueue->createBatch(ACTION_APPLY_PATCH);
+	for (uint32_t b = 0; b < blockCount && ok; ++b) {
+		uint32_t tiles = 0;
+		uint32_t rawSize = 0;
+		uint32_t size = 0;
+		if (!patchRead(file, tiles) || !patchRead(file, rawSize) || !patchRead(file, size) ||
+			tiles == 0 || tiles > uint32_t(TILES_PER_LEAF) || rawSize > PATCH_MAX_BLOCK_SIZE || size > PATCH_MAX_BLOCK_SIZE) {
+			ok = false;
+			break;
+		}
+
+		compressed.resize(size);
+		raw.resize(rawSize);
+		file.read(reinterpret_cast<char*>(compressed.data()), size);
+		if (file.fail() || !LiveSocket::decompressData(compressed.data(), size, raw.data(), rawSize)) {
+			ok = false;
+			break;
+		}
+
+		Action* action = editor.actionQueue->createAction(batch);
+		DiffReader in(raw);
+		uint32_t read = 0;
+		while (in.ok && !in.atEnd()) {
+			Position pos;
+			pos.x = in.read<uint16_t>();
+			pos.y = in.read<uint16_t>();
+			pos.z = in.read<uint8_t>();
+			// Patches are written from valid tiles only
+			if (!in.ok || !pos.isValid()) {
+				in.ok = false;
+				break;
+			}
+
+			// The houses of the patched map may not match, keep the ids as they are
+			Tile* tile = nullptr;
+			if (!records.read(raw.data(), raw.size(), in.offset, map, nullptr, &pos, tile)) {
+				in.ok = false;
+				break;
+			}
+
+			if (!tile) {
+				tile = map.allocator(map.createTileL(pos));
+			}
+			action->addChange(newd Change(tile));
+			++applied;
+			++read;
+		}
+
+		ok = in.ok && read == tiles;
+		batch->addAndCommitAction(action);
+	}
+
+	// What was applied before a damaged block can still be undone
+	if (batch->size() > 0) {
+		editor.addBatch(batch);
+	} else {
+		delete batch;
+	}
+
+	if (!ok) {
+		error = wxstr(filename) + wxT(" is damaged, the patch was applied up to the damage.");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_MAP_DIFF_H_
+#define RME_MAP_DIFF_H_
+
+#include "position.h"
+
+#include <unordered_set>
+
+class Map;
+class Editor;
+class QTreeNode;
+
+// What changed between two maps. The leaves of both are paired by their
+// corner and hashed in parallel, a tile by its OTBM record plus the spawn
+// and creature on it, and leaves whose hashes match are skipped. The tiles
+// of the newer map that differ are kept as OTBM tile records, compressed
+// per leaf, which is also what a patch file holds.
+class MapDiff
+{
+public:
+	MapDiff();
+
+	void compare(Map& base, Map& target, size_t threads, bool showdialog);
+	// Like compare, with the newer map read tile by tile from its file
+	// instead of loaded. Besides the older map only the tiles of one tile
+	// area of the file and a key per floor of a leaf are kept.
+	bool compareFile(Map& base, const std::string& filename, bool showdialog, wxString& error);
+
+	bool isChanged(const Position& pos) const;
+	// Leaves that either map has
+	size_t getLeafCount() const { return leafCount; }
+	size_t getChangedLeafCount() const { return changedLeafCount; }
+	// By leaf, then by floor
+	const std::vector<Position>& getChanges() const { return changes; }
+
+	bool savePatch(const std::string& filename) const;
+	// Replaces the tiles the patch lists as one undoable batch, tiles that
+	// were removed are emptied. The patch is read one leaf at a time.
+	static bool ApplyPatch(const std::string& filename, Editor& editor, size_t& applied, wxString& error);
+
+protected:
+	class FileSink;
+	class SpawnSink;
+
+	// The changed tiles of one leaf, compressed
+	struct Block
+	{
+		uint32_t tiles;
+		uint32_t rawSize;
+		std::vector<uint8_t> data;
+	};
+
+	static uint64_t Key(const Position& pos) { return (uint64_t(pos.z) << 32) | (uint64_t(pos.y & 0xFFFF) << 16) | uint64_t(pos.x & 0xFFFF); }
+
+	void clear();
+	void addChange(const Position& pos);
+
+	std::vector<Block> blocks;
+	std::vector<Position> changes;
+	std::unordered_set<uint64_t> changed;
+	size_t leafCount;
+	size_t changedLeafCount;
+};
+
+#endif
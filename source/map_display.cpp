@@ -172,6 +172,8 @@ void MapCanvas::OnPaint(wxPaintEvent& event)
 			options.show_items = settings.getBoolean(Config::SHOW_ITEMS);
 			options.highlight_items = settings.getBoolean(Config::HIGHLIGHT_ITEMS);
 			options.show_blocking = settings.getBoolean(Config::SHOW_BLOCKING);
+			options.show_reachability = settings.getBoolean(Config::SHOW_REACHABILITY);
+			options.show_map_diff = settings.getBoolean(Config::SHOW_MAP_DIFF);
 			options.show_only_colors = settings.getBoolean(Config::SHOW_ONLY_TILEFLAGS);
 			options.show_only_modified = settings.getBoolean(Config::SHOW_ONLY_MODIFIED_TILES);
 			options.hide_items_when_zoomed = settings.getBoolean(Config::HIDE_ITEMS_WHEN_ZOOMED);
@@ -999,7 +1001,6 @@ void MapCanvas::OnMouseActionRelease(wxMouseEvent& event)
 								end_y -= (floor < 7? 7-floor : 0);
 							}
 
-							numtiles = (start_z - end_z) * (end_x - start_x) * (end_y - start_y);
 							break;
 						}
 					case SELECT_VISIBLE_FLOORS:
@@ -1027,41 +1028,33 @@ void MapCanvas::OnMouseActionRelease(wxMouseEvent& event)
 							break;
 						}
 					}
+					numtiles = (start_z - end_z + 1) * (end_x - start_x + 1) * (end_y - start_y + 1);
 					if(numtiles < 500)
 					{
 						// No point in threading for such a small set.
 						threadcount = 1;
 					}
-					// Subdivide the selection area
-					// We know it's a square, just split it into several areas
-					int width = end_x - start_x;
-					if(width < threadcount)
-					{
-						threadcount = min(1, width);
-					}
-					// Let's divide!
-					int remainder = width;
-					int cleared = 0;
+					// Subdivide the selection area into stripes of whole leaves
+					// (4 tiles wide), every thread walks only the leaves of its own stripe
+					int columns = ((end_x | 3) - (start_x & ~3)) / 4 + 1;
+					threadcount = std::max(1, std::min(threadcount, columns));
+
 					std::vector<SelectionThread*> threads;
-					if(width == 0)
+					int stripe_x = start_x;
+					for(int i = 0; i < threadcount; ++i)
 					{
-						threads.push_back(newd SelectionThread(editor, Position(start_x, start_y, start_z), Position(start_x, end_y, end_z)));
-					} else {
-						for(int i = 0; i < threadcount; ++i)
+						// The last thread takes all the remainder
+						int stripe_end = end_x;
+						if(i != threadcount - 1)
 						{
-							int chunksize = width / threadcount;
-							// The last threads takes all the remainder
-							if(i == threadcount - 1)
-							{
-								chunksize = remainder;
-							}
-							threads.push_back(newd SelectionThread(editor, Position(start_x + cleared, start_y, start_z), Position(start_x + cleared + chunksize, end_y, end_z)));
-							cleared += chunksize;
-							remainder -= chunksize;
+							stripe_end = std::min(end_x, (start_x & ~3) + (columns * (i + 1) / threadcount) * 4 - 1);
 						}
+						if(stripe_end < stripe_x)
+							continue;
+						threads.push_back(newd SelectionThread(editor, Position(stripe_x, start_y, start_z), Position(stripe_end, end_y, end_z)));
+						stripe_x = stripe_end + 1;
 					}
-					ASSERT(cleared == width);
-					ASSERT(remainder == 0);
+					ASSERT(stripe_x == end_x + 1);
 
 					editor.selection.start(); // Start a selection session
 					for(std::vector<SelectionThread*>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
@@ -8,6 +8,8 @@
 #include "map_display.h"
 #include "copybuffer.h"
 #include "live_socket.h"
+#include "reachability.h"
+#include "map_diff.h"
 
 #include "doodad_brush.h"
 #include "creature_brush.h"
@@ -20,7 +22,8 @@
 #include "table_brush.h"
 #include "waypoint_brush.h"
 
-MapDrawer::MapDrawer(const DrawingOptions& options, MapCanvas* canvas, wxPaintDC& pdc) : canvas(canvas), editor(canvas->editor), pdc(pdc), options(options)
+MapDrawer::MapDrawer(const DrawingOptions& options, MapCanvas* canvas, wxPaintDC& pdc) : canvas(canvas), editor(canvas->editor), pdc(pdc), options(options),
+	cover_x(0), cover_y(0), cover_width(0), cover_height(0)
 {
 	canvas->MouseToMap(&mouse_map_x, &mouse_map_y);
 	canvas->GetViewBox(&view_scroll_x, &view_scroll_y, &screensize_x, &screensize_y);
@@ -109,6 +112,8 @@ void DrawingOptions::SetDefault()
 
 	highlight_items = false;
 	show_blocking = false;
+	show_reachability = false;
+	show_map_diff = false;
 	show_only_colors = false;
 	show_only_modified = false;
 	hide_items_when_zoomed = true;
@@ -133,6 +138,8 @@ void DrawingOptions::SetIngame()
 
 	highlight_items = false;
 	show_blocking = false;
+	show_reachability = false;
+	show_map_diff = false;
 	show_only_colors = false;
 	show_only_modified = false;
 	hide_items_when_zoomed = false;
@@ -198,6 +205,10 @@ void MapDrawer::DrawMap()
 		current_house_id = heb->getHouseID();
 	}
 
+	// Let the server know what we're looking at, so it can push the surroundings
+	if(live_client)
+		editor.UpdateViewport(start_x, start_y, end_x + 4, end_y + 4, end_z, start_z);
+
 	// Enable texture mode
 	if(!options.show_only_colors)
 		glEnable(GL_TEXTURE_2D);
@@ -228,6 +239,9 @@ void MapDrawer::DrawMap()
 			int nd_end_x = (end_x & ~3) + 4;
 			int nd_end_y = (end_y & ~3) + 4;
 
+			if(options.show_spawns)
+				CountSpawnCover(map_z, nd_start_x, nd_start_y, nd_end_x + 3, nd_end_y + 3);
+
 			for(int nd_map_x = nd_start_x; nd_map_x <= nd_end_x; nd_map_x += 4) {
 				for(int nd_map_y = nd_start_y; nd_map_y <= nd_end_y; nd_map_y += 4) {
 					QTreeNode* nd = editor.map.getLeaf(nd_map_x, nd_map_y);
@@ -287,6 +301,10 @@ void MapDrawer::DrawMap()
 			if(canvas->isPasting())
 			{
 				normalPos = editor.copybuffer.getPosition();
+				editor.copybuffer.prepareArea(
+					normalPos.x + start_x - to.x, normalPos.y + start_y - to.y,
+					normalPos.x + end_x - to.x, normalPos.y + end_y - to.y
+				);
 			}
 			else if(dynamic_cast<DoodadBrush*>(gui.GetCurrentBrush()))
 			{
@@ -1346,6 +1364,45 @@ void MapDrawer::MakeTooltip(Item* item, std::ostringstream& tip)
 		tip << "text: " << item->getText() << "\n";
 }
 
+void MapDrawer::CountSpawnCover(int map_z, int start_x, int start_y, int end_x, int end_y)
+{
+	cover_x = start_x;
+	cover_y = start_y;
+	cover_width = end_x - start_x + 1;
+	cover_height = end_y - start_y + 1;
+	spawn_cover.assign(cover_width * cover_height, 0);
+
+	// Only the few areas reaching into the view are walked, instead of
+	// looking every drawn tile up in the spawn grid
+	std::vector<Spawns::Area> areas;
+	editor.map.spawns.getSpawns(map_z, start_x, start_y, end_x, end_y, areas);
+	for(const Spawns::Area& area : areas)
+	{
+		const int from_x = std::max(start_x, area.centre.x - area.radius);
+		const int from_y = std::max(start_y, area.centre.y - area.radius);
+		const int to_x = std::min(end_x, area.centre.x + area.radius);
+		const int to_y = std::min(end_y, area.centre.y + area.radius);
+		for(int y = from_y; y <= to_y; ++y)
+		{
+			uint8_t* row = &spawn_cover[(y - cover_y) * cover_width];
+			for(int x = from_x; x <= to_x; ++x)
+			{
+				if(row[x - cover_x] < 0xFF)
+					++row[x - cover_x];
+			}
+		}
+	}
+}
+
+size_t MapDrawer::GetSpawnCover(int map_x, int map_y) const
+{
+	const int x = map_x - cover_x;
+	const int y = map_y - cover_y;
+	if(x < 0 || y < 0 || x >= cover_width || y >= cover_height)
+		return 0;
+	return spawn_cover[y * cover_width + x];
+}
+
 void MapDrawer::DrawTile(TileLocation* location) {
 	if(!location)
 		return;
@@ -1387,6 +1444,22 @@ void MapDrawer::DrawTile(TileLocation* location) {
 			g = g/3*2;
 			b = b/3*2;
 		}
+
+		if(options.show_reachability && editor.reachability)
+		{
+			Position pos(map_x, map_y, map_z);
+			if(editor.reachability->isWalkable(pos) && !editor.reachability->isReachable(pos))
+			{
+				r = r/3;
+				g = g/3;
+			}
+		}
+
+		if(options.show_map_diff && editor.diff && editor.diff->isChanged(Position(map_x, map_y, map_z)))
+		{
+			r = r/3;
+			b = b/3;
+		}
 		
 		int item_count = tile->items.size();
 		if (options.highlight_items && item_count > 0 && tile->items.back()->isBorder() == false)
@@ -1397,10 +1470,11 @@ void MapDrawer::DrawTile(TileLocation* location) {
 			r = int(r * factor[idx]);
 		}
 
-		if(location->getSpawnCount() > 0 && options.show_spawns)
+		const size_t spawn_count = options.show_spawns ? GetSpawnCover(map_x, map_y) : 0;
+		if(spawn_count > 0)
 		{
 			float f = 1.0f;
-			for(uint32_t i = 0; i < location->getSpawnCount(); ++i)
+			for(uint32_t i = 0; i < spawn_count; ++i)
 			{
 				f *= 0.7f;
 			}
@@ -34,6 +34,8 @@ struct DrawingOptions {
 
 	bool highlight_items;
 	bool show_blocking;
+	bool show_reachability;
+	bool show_map_diff;
 	bool show_only_colors;
 	bool show_only_modified;
 	bool hide_items_when_zoomed;
@@ -60,6 +62,10 @@ class MapDrawer
 	int tile_size;
 	int floor;
 
+	// How many spawn areas cover each tile of the floor being drawn
+	std::vector<uint8_t> spawn_cover;
+	int cover_x, cover_y, cover_width, cover_height;
+
 protected:
 	std::vector<MapTooltip> tooltips;
 
@@ -95,6 +101,8 @@ protected:
 	void BlitCreature(int screenx, int screeny, const Creature* c, int red = 255, int green = 255, int blue = 255, int alpha = 255);
 	void BlitCreature(int screenx, int screeny, const Outfit& outfit, Direction dir, int red = 255, int green = 255, int blue = 255, int alpha = 255);
 	void DrawTile(TileLocation* tile);
+	void CountSpawnCover(int map_z, int start_x, int start_y, int end_x, int end_y);
+	size_t GetSpawnCover(int map_x, int map_y) const;
 	void DrawTooltip(int screenx, int screeny, const std::string& s);
 	void MakeTooltip(Item* item, std::ostringstream& tip);
 
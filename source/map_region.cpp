@@ -16,7 +16,6 @@
 TileLocation::TileLocation() :
 	tile(nullptr),
 	position(0, 0, 0),
-	spawn_count(0),
 	waypoint_count(0),
 	house_exits(nullptr)
 {
@@ -32,7 +31,7 @@ int TileLocation::size() const
 {
 	if(tile)
 		return tile->size();
-	return spawn_count + waypoint_count + (house_exits? 1 : 0);
+	return waypoint_count + (house_exits? 1 : 0);
 }
 
 bool TileLocation::empty() const
@@ -210,10 +209,11 @@ void QTreeNode::clearVisible(uint32_t u)
 
 bool QTreeNode::isVisible(uint32_t client, bool underground)
 {
+	// Client ids are single bits, underground visibility lives in the upper half
 	if (underground) {
-		return testFlags(visible >> 16, 1 << client);
+		return testFlags(visible >> 16, client);
 	} else {
-		return testFlags(visible, 1 << client);
+		return testFlags(visible, client);
 	}
 }
 
@@ -231,7 +231,7 @@ void QTreeNode::setVisible(bool underground, bool value)
 		if(value)
 			visible |= 1;
 		else
-			visible &= 1;
+			visible &= ~1;
 	}
 }
 
@@ -246,9 +246,9 @@ void QTreeNode::setRequested(bool underground, bool r)
 void QTreeNode::setVisible(uint32_t client, bool underground, bool value)
 {
 	if(value)
-		visible |= (1 << client << (underground? 16 : 0));
+		visible |= (client << (underground? 16 : 0));
 	else
-		visible &= ~(1 << client << (underground? 16 : 0));
+		visible &= ~(client << (underground? 16 : 0));
 }
 
 TileLocation* QTreeNode::getTile(int x, int y, int z)
@@ -25,7 +25,6 @@ public:
 protected:
 	Tile* tile;
 	Position position;
-	size_t spawn_count;
 	size_t waypoint_count;
 	HouseExitList* house_exits; // Any house exits pointing here
 	
@@ -44,9 +43,6 @@ public:
 	int getY() const {return position.y;}
 	int getZ() const {return position.z;}
 
-	size_t getSpawnCount() const {return spawn_count;}
-	void increaseSpawnCount() {spawn_count++;}
-	void decreaseSpawnCount() {spawn_count--;}
 	size_t getWaypointCount() const {return waypoint_count;}
 	void increaseWaypointCount() {waypoint_count++;}
 	void decreaseWaypointCount() {waypoint_count--;}
@@ -0,0 +1,416 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "map_statistics.h"
+#include "map.h"
+#include "complexitem.h"
+#include "gui.h"
+
+#include <fstream>
+
+MapStatistics::Counters::Counters() :
+	tiles(0),
+	detailed(0),
+	blocking(0),
+	walkable(0),
+	items(0),
+	loose(0),
+	depots(0),
+	containers(0),
+	actions(0),
+	uniques(0),
+	spawns(0),
+	creatures(0)
+{
+	//
+}
+
+MapStatistics::Counters& MapStatistics::Counters::operator+=(const Counters& other)
+{
+	tiles += other.tiles;
+	detailed += other.detailed;
+	blocking += other.blocking;
+	walkable += other.walkable;
+	items += other.items;
+	loose += other.loose;
+	depots += other.depots;
+	containers += other.containers;
+	actions += other.actions;
+	uniques += other.uniques;
+	spawns += other.spawns;
+	creatures += other.creatures;
+	return *this;
+}
+
+MapStatistics::Counters& MapStatistics::Counters::operator-=(const Counters& other)
+{
+	tiles -= other.tiles;
+	detailed -= other.detailed;
+	blocking -= other.blocking;
+	walkable -= other.walkable;
+	items -= other.items;
+	loose -= other.loose;
+	depots -= other.depots;
+	containers -= other.containers;
+	actions -= other.actions;
+	uniques -= other.uniques;
+	spawns -= other.spawns;
+	creatures -= other.creatures;
+	return *this;
+}
+
+bool MapStatistics::Counters::operator==(const Counters& other) const
+{
+	return tiles == other.tiles && detailed == other.detailed &&
+		blocking == other.blocking && walkable == other.walkable &&
+		items == other.items && loose == other.loose &&
+		depots == other.depots && containers == other.containers &&
+		actions == other.actions && uniques == other.uniques &&
+		spawns == other.spawns && creatures == other.creatures;
+}
+
+MapStatistics::MapStatistics() :
+	valid(false)
+{
+	//
+}
+
+void MapStatistics::CountTile(const Tile* tile, Counters& counters)
+{
+	if (!tile || tile->empty()) {
+		return;
+	}
+
+	++counters.tiles;
+
+	bool detailed = false;
+	auto countItem = [&](Item* item) {
+		++counters.items;
+		if (item->isGroundTile() || item->isBorder()) {
+			return;
+		}
+
+		detailed = true;
+		const ItemType& type = item_db[item->getID()];
+		if (type.moveable) {
+			++counters.loose;
+		}
+		if (type.isDepot()) {
+			++counters.depots;
+		}
+		if (item->getActionID() > 0) {
+			++counters.actions;
+		}
+		if (item->getUniqueID() > 0) {
+			++counters.uniques;
+		}
+		if (Container* container = dynamic_cast<Container*>(item)) {
+			if (!container->getVector().empty()) {
+				++counters.containers;
+			}
+		}
+	};
+
+	if (tile->ground) {
+		countItem(tile->ground);
+	}
+	for (Item* item : tile->items) {
+		countItem(item);
+	}
+
+	if (tile->spawn) {
+		++counters.spawns;
+	}
+	if (tile->creature) {
+		++counters.creatures;
+	}
+
+	if (tile->isBlocking()) {
+		++counters.blocking;
+	} else {
+		++counters.walkable;
+	}
+
+	if (detailed) {
+		++counters.detailed;
+	}
+}
+
+void MapStatistics::addTile(const Tile* tile)
+{
+	if (valid) {
+		CountTile(tile, counters);
+	}
+}
+
+void MapStatistics::removeTile(const Tile* tile)
+{
+	if (valid) {
+		Counters removed;
+		CountTile(tile, removed);
+		counters -= removed;
+	}
+}
+
+MapStatistics::Counters MapStatistics::Count(Map& map, size_t threads, bool showdialog)
+{
+	threads = std::max<size_t>(threads, 1);
+
+	std::vector<QTreeNode*> leaves;
+	map.getLeaves(leaves);
+
+	std::vector<Counters> partial(threads);
+	StripeProgress progress(leaves.size(), showdialog);
+	ParallelStripes(leaves.size(), threads, [&](size_t stripe, size_t begin, size_t end) {
+		Counters& counters = partial[stripe];
+		for (size_t i = begin; i < end; ++i) {
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaves[i]->getFloor(z);
+				if (!floor) {
+					continue;
+				}
+
+				for (TileLocation& location : floor->locs) {
+					CountTile(location.get(), counters);
+				}
+			}
+			progress.advance(stripe);
+		}
+	});
+
+	Counters total;
+	for (const Counters& counters : partial) {
+		total += counters;
+	}
+	return total;
+}
+
+const MapStatistics::Counters& MapStatistics::get(Map& map, size_t threads, bool showdialog)
+{
+	if (!valid) {
+		counters = Count(map, threads, showdialog);
+		valid = true;
+	}
+	return counters;
+}
+
+bool MapStatistics::verify(Map& map, size_t threads, bool showdialog)
+{
+	const Counters counted = Count(map, threads, showdialog);
+	const bool matched = !valid || counted == counters;
+	counters = counted;
+	valid = true;
+	return matched;
+}
+
+namespace {
+	struct TownStatistics
+	{
+		TownStatistics() : houses(0), sqm(0) {}
+
+		uint64_t houses;
+		uint64_t sqm;
+	};
+
+	std::string CsvField(const std::string& value)
+	{
+		if (value.find_first_of(",\"\r\n") == std::string::npos) {
+			return value;
+		}
+
+		std::string quoted = "\"";
+		for (char c : value) {
+			if (c == '"') {
+				quoted += '"';
+			}
+			quoted += c;
+		}
+		return quoted + "\"";
+	}
+}
+
+std::string MapStatistics::getReport(const Map& map, Format format) const
+{
+	const uint64_t townCount = map.towns.count();
+	const uint64_t houseCount = map.houses.count();
+
+	std::map<uint32_t, TownStatistics> towns;
+	uint64_t houseSqm = 0;
+	uint64_t houseDoors = 0;
+	const House* largestHouse = nullptr;
+	for (const auto& entry : map.houses) {
+		const House* house = entry.second;
+		if (!largestHouse || house->size() > largestHouse->size()) {
+			largestHouse = house;
+		}
+		houseSqm += house->size();
+		houseDoors += house->getDoorCount();
+
+		TownStatistics& town = towns[house->townid];
+		++town.houses;
+		town.sqm += house->size();
+	}
+
+	// Houses of towns that don't exist don't make a town the largest
+	const Town* largestTown = nullptr;
+	uint64_t largestTownSqm = 0;
+	for (const auto& entry : towns) {
+		auto town = map.towns.find(entry.first);
+		if (town != map.towns.end() && entry.second.sqm > largestTownSqm) {
+			largestTown = town->second;
+			largestTownSqm = entry.second.sqm;
+		}
+	}
+
+	auto ratio = [](uint64_t a, uint64_t b) {
+		return b != 0 ? double(a) / double(b) : -1.0;
+	};
+	const double percentWalkable = 100.0 * ratio(counters.walkable, counters.tiles);
+	const double percentDetailed = 100.0 * ratio(counters.detailed, counters.tiles);
+	const double creaturesPerSpawn = ratio(counters.creatures, counters.spawns);
+	const double housesPerTown = ratio(houseCount, townCount);
+	const double sqmPerHouse = ratio(houseSqm, houseCount);
+	const double sqmPerTown = ratio(houseSqm, townCount);
+
+	std::ostringstream os;
+	if (format == FORMAT_JSON) {
+		json::Object tiles;
+		tiles.push_back(json::Pair("total", counters.tiles));
+		tiles.push_back(json::Pair("walkable", counters.walkable));
+		tiles.push_back(json::Pair("blocking", counters.blocking));
+		tiles.push_back(json::Pair("detailed", counters.detailed));
+
+		json::Object items;
+		items.push_back(json::Pair("total", counters.items));
+		items.push_back(json::Pair("moveable", counters.loose));
+		items.push_back(json::Pair("depots", counters.depots));
+		items.push_back(json::Pair("containers", counters.containers));
+		items.push_back(json::Pair("actionids", counters.actions));
+		items.push_back(json::Pair("uniqueids", counters.uniques));
+
+		json::Object creatures;
+		creatures.push_back(json::Pair("total", counters.creatures));
+		creatures.push_back(json::Pair("spawns", counters.spawns));
+
+		json::Object houses;
+		houses.push_back(json::Pair("total", houseCount));
+		houses.push_back(json::Pair("sqm", houseSqm));
+		houses.push_back(json::Pair("doors", houseDoors));
+
+		json::Array townList;
+		for (const auto& entry : map.towns) {
+			const TownStatistics& stats = towns[entry.first];
+			json::Object town;
+			town.push_back(json::Pair("id", uint64_t(entry.first)));
+			town.push_back(json::Pair("name", entry.second->getName()));
+			town.push_back(json::Pair("houses", stats.houses));
+			town.push_back(json::Pair("sqm", stats.sqm));
+			townList.push_back(town);
+		}
+
+		json::Object report;
+		report.push_back(json::Pair("map", map.getMapDescription()));
+		report.push_back(json::Pair("tiles", tiles));
+		report.push_back(json::Pair("items", items));
+		report.push_back(json::Pair("creatures", creatures));
+		report.push_back(json::Pair("houses", houses));
+		report.push_back(json::Pair("towns", townList));
+		report.push_back(json::Pair("version", __RME_VERSION__));
+		json::write_formatted(report, os);
+		os << "\n";
+	} else if (format == FORMAT_CSV) {
+		os << "section,statistic,value\n";
+		os << "tiles,total," << counters.tiles << "\n";
+		os << "tiles,walkable," << counters.walkable << "\n";
+		os << "tiles,blocking," << counters.blocking << "\n";
+		os << "tiles,detailed," << counters.detailed << "\n";
+		os << "items,total," << counters.items << "\n";
+		os << "items,moveable," << counters.loose << "\n";
+		os << "items,depots," << counters.depots << "\n";
+		os << "items,containers," << counters.containers << "\n";
+		os << "items,actionids," << counters.actions << "\n";
+		os << "items,uniqueids," << counters.uniques << "\n";
+		os << "creatures,total," << counters.creatures << "\n";
+		os << "creatures,spawns," << counters.spawns << "\n";
+		os << "houses,total," << houseCount << "\n";
+		os << "houses,sqm," << houseSqm << "\n";
+		os << "houses,doors," << houseDoors << "\n";
+		os << "towns,total," << townCount << "\n";
+		for (const auto& entry : map.towns) {
+			const std::string name = CsvField(entry.second->getName());
+			const TownStatistics& stats = towns[entry.first];
+			os << "town houses," << name << "," << stats.houses << "\n";
+			os << "town sqm," << name << "," << stats.sqm << "\n";
+		}
+	} else {
+		os.setf(std::ios::fixed, std::ios::floatfield);
+		os.precision(2);
+		os << "Map statistics for the map \"" << map.getMapDescription() << "\"\n";
+		os << "\tTile data:\n";
+		os << "\t\tTotal number of tiles: " << counters.tiles << "\n";
+		os << "\t\tNumber of pathable tiles: " << counters.walkable << "\n";
+		os << "\t\tNumber of unpathable tiles: " << counters.blocking << "\n";
+		if (percentWalkable >= 0.0) {
+			os << "\t\tPercent walkable tiles: " << percentWalkable << "%\n";
+		}
+		os << "\t\tDetailed tiles: " << counters.detailed << "\n";
+		if (percentDetailed >= 0.0) {
+			os << "\t\tPercent detailed tiles: " << percentDetailed << "%\n";
+		}
+
+		os << "\tItem data:\n";
+		os << "\t\tTotal number of items: " << counters.items << "\n";
+		os << "\t\tNumber of moveable tiles: " << counters.loose << "\n";
+		os << "\t\tNumber of depots: " << counters.depots << "\n";
+		os << "\t\tNumber of containers: " << counters.containers << "\n";
+		os << "\t\tNumber of items with Action ID: " << counters.actions << "\n";
+		os << "\t\tNumber of items with Unique ID: " << counters.uniques << "\n";
+
+		os << "\tCreature data:\n";
+		os << "\t\tTotal creature count: " << counters.creatures << "\n";
+		os << "\t\tTotal spawn count: " << counters.spawns << "\n";
+		if (creaturesPerSpawn >= 0) {
+			os << "\t\tMean creatures per spawn: " << creaturesPerSpawn << "\n";
+		}
+
+		os << "\tTown/House data:\n";
+		os << "\t\tTotal number of towns: " << townCount << "\n";
+		os << "\t\tTotal number of houses: " << houseCount << "\n";
+		if (housesPerTown >= 0) {
+			os << "\t\tMean houses per town: " << housesPerTown << "\n";
+		}
+		os << "\t\tTotal amount of housetiles: " << houseSqm << "\n";
+		os << "\t\tTotal amount of house doors: " << houseDoors << "\n";
+		if (sqmPerHouse >= 0) {
+			os << "\t\tMean tiles per house: " << sqmPerHouse << "\n";
+		}
+		if (sqmPerTown >= 0) {
+			os << "\t\tMean tiles per town: " << sqmPerTown << "\n";
+		}
+
+		if (largestTown) {
+			os << "\t\tLargest Town: \"" << largestTown->getName() << "\" (" << largestTownSqm << " sqm)\n";
+		}
+		if (largestHouse) {
+			os << "\t\tLargest House: \"" << largestHouse->name << "\" (" << largestHouse->size() << " sqm)\n";
+		}
+
+		os << "\n";
+		os << "Generated by Remere's Map Editor version " + __RME_VERSION__ + "\n";
+	}
+	return os.str();
+}
+
+bool MapStatistics::saveReport(const Map& map, Format format, const std::string& filename) const
+{
+	std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+
+	file << getReport(map, format);
+	return file.good();
+}
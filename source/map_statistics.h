@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_MAP_STATISTICS_H_
+#define RME_MAP_STATISTICS_H_
+
+class Map;
+class Tile;
+
+// Running totals of what is on the map. Actions report every tile they
+// put on or take off the map, so the totals stay current without walking
+// the map. Edits that bypass the undo queue invalidate them, the next
+// query then recounts the whole map, split between threads.
+// Town and house numbers are read from the houses, which keep their own.
+class MapStatistics
+{
+public:
+	struct Counters
+	{
+		Counters();
+
+		Counters& operator+=(const Counters& other);
+		Counters& operator-=(const Counters& other);
+		bool operator==(const Counters& other) const;
+		bool operator!=(const Counters& other) const { return !(*this == other); }
+
+		uint64_t tiles;
+		uint64_t detailed;
+		uint64_t blocking;
+		uint64_t walkable;
+
+		uint64_t items;
+		uint64_t loose;
+		uint64_t depots;
+		// Only containers that hold something
+		uint64_t containers;
+		uint64_t actions;
+		uint64_t uniques;
+
+		uint64_t spawns;
+		uint64_t creatures;
+	};
+
+	enum Format
+	{
+		FORMAT_TEXT,
+		FORMAT_JSON,
+		FORMAT_CSV,
+	};
+
+	MapStatistics();
+
+	// Deltas, ignored while the totals are invalid
+	void addTile(const Tile* tile);
+	void removeTile(const Tile* tile);
+
+	void invalidate() { valid = false; }
+	bool isValid() const { return valid; }
+
+	// Recounts the map if the totals are invalid
+	const Counters& get(Map& map, size_t threads, bool showdialog);
+	// Recounts the map and replaces the totals, false if the running
+	// totals were valid and didn't match the count
+	bool verify(Map& map, size_t threads, bool showdialog);
+
+	// Walks the whole map, each thread counts its own leaves
+	static Counters Count(Map& map, size_t threads, bool showdialog);
+
+	// The totals plus the town and house numbers, the totals must be valid
+	std::string getReport(const Map& map, Format format) const;
+	bool saveReport(const Map& map, Format format, const std::string& filename) const;
+
+protected:
+	static void CountTile(const Tile* tile, Counters& counters);
+
+	Counters counters;
+	bool valid;
+};
+
+#endif
@@ -0,0 +1,274 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "map_validator.h"
+#include "map.h"
+#include "complexitem.h"
+#include "gui.h"
+
+namespace
+{
+	std::string PositionString(const Position& pos)
+	{
+		std::ostringstream out;
+		out << pos.x << ":" << pos.y << ":" << pos.z;
+		return out.str();
+	}
+
+	class UnknownItemRule : public MapValidator::Rule
+	{
+	public:
+		UnknownItemRule() : Rule("unknown-item", "Items that are not in the item database") {}
+
+		void checkItem(const Map&, const Tile* tile, const Item* item, MapValidator::Report& report) const
+		{
+			if (!item_db.typeExists(item->getID())) {
+				report.problem(tile->getPosition(), "Item " + i2s(item->getID()) + " is not in the item database");
+			}
+		}
+	};
+
+	class DuplicateUniqueRule : public MapValidator::Rule
+	{
+	public:
+		DuplicateUniqueRule() : Rule("duplicate-unique", "Unique ids used by more than one item") {}
+
+		void checkItem(const Map&, const Tile* tile, const Item* item, MapValidator::Report& report) const
+		{
+			if (item->getUniqueID() != 0) {
+				report.note(item->getUniqueID(), tile->getPosition());
+			}
+		}
+
+		void finish(const Map&, std::vector<MapValidator::Note>& notes, MapValidator::Report& report) const
+		{
+			std::stable_sort(notes.begin(), notes.end(), [](const MapValidator::Note& a, const MapValidator::Note& b) {
+				return a.key < b.key;
+			});
+
+			for (size_t first = 0; first < notes.size();) {
+				size_t last = first + 1;
+				while (last < notes.size() && notes[last].key == notes[first].key) {
+					++last;
+				}
+
+				if (last - first > 1) {
+					const std::string description = "Unique id " + i2s(int(notes[first].key)) + " is used " + i2s(int(last - first)) + " times";
+					for (size_t i = first; i < last; ++i) {
+						report.problem(notes[i].position, description);
+					}
+				}
+				first = last;
+			}
+		}
+	};
+
+	class TeleportRule : public MapValidator::Rule
+	{
+	public:
+		TeleportRule() : Rule("teleport-void", "Teleports without a destination or leading to a tile without ground") {}
+
+		void checkItem(const Map& map, const Tile* tile, const Item* item, MapValidator::Report& report) const
+		{
+			const Teleport* teleport = dynamic_cast<const Teleport*>(item);
+			if (!teleport) {
+				return;
+			}
+
+			const Position destination = teleport->getDestination();
+			if (destination == Position()) {
+				report.problem(tile->getPosition(), "Teleport without a destination");
+				return;
+			}
+
+			const Tile* target = destination.isValid() ? map.getTile(destination) : nullptr;
+			if (!target || !target->hasGround()) {
+				report.problem(tile->getPosition(), "Teleport to " + PositionString(destination) + " leads to a tile without ground");
+			}
+		}
+	};
+
+	class HouseTileRule : public MapValidator::Rule
+	{
+	public:
+		HouseTileRule() : Rule("house-tile", "House tiles without ground or of houses that don't exist") {}
+
+		void checkTile(const Map& map, const Tile* tile, MapValidator::Report& report) const
+		{
+			if (!tile->isHouseTile()) {
+				return;
+			}
+
+			if (!tile->hasGround()) {
+				report.problem(tile->getPosition(), "House tile without ground");
+			}
+			if (!map.houses.getHouse(tile->getHouseID())) {
+				report.problem(tile->getPosition(), "Tile of house " + i2s(tile->getHouseID()) + ", which doesn't exist");
+			}
+		}
+	};
+
+	class HouseDoorRule : public MapValidator::Rule
+	{
+	public:
+		HouseDoorRule() : Rule("house-door", "Doors of houses without a door id, and door ids outside houses") {}
+
+		void checkItem(const Map&, const Tile* tile, const Item* item, MapValidator::Report& report) const
+		{
+			const Door* door = dynamic_cast<const Door*>(item);
+			if (!door) {
+				return;
+			}
+
+			if (tile->isHouseTile() && door->getDoorID() == 0) {
+				report.problem(tile->getPosition(), "Door of house " + i2s(tile->getHouseID()) + " without a door id");
+			} else if (!tile->isHouseTile() && door->getDoorID() != 0) {
+				report.problem(tile->getPosition(), "Door id " + i2s(door->getDoorID()) + " on a tile outside houses");
+			}
+		}
+	};
+}
+
+void MapValidator::Report::problem(const Position& position, const std::string& description)
+{
+	Problem found;
+	found.position = position;
+	found.description = description;
+	problems.push_back(found);
+}
+
+void MapValidator::Report::note(uint64_t key, const Position& position)
+{
+	Note found;
+	found.key = key;
+	found.position = position;
+	notes.push_back(found);
+}
+
+MapValidator::MapValidator()
+{
+	addRule(newd UnknownItemRule());
+	addRule(newd DuplicateUniqueRule());
+	addRule(newd TeleportRule());
+	addRule(newd HouseTileRule());
+	addRule(newd HouseDoorRule());
+}
+
+MapValidator::~MapValidator()
+{
+	for (Rule* rule : rules) {
+		delete rule;
+	}
+}
+
+void MapValidator::addRule(Rule* rule)
+{
+	for (Rule*& existing : rules) {
+		if (existing->getName() == rule->getName()) {
+			delete existing;
+			existing = rule;
+			return;
+		}
+	}
+	rules.push_back(rule);
+}
+
+bool MapValidator::selectRules(const std::vector<std::string>& names)
+{
+	for (const std::string& name : names) {
+		auto it = std::find_if(rules.begin(), rules.end(), [&name](const Rule* rule) {
+			return rule->getName() == name;
+		});
+		if (it == rules.end()) {
+			return false;
+		}
+	}
+
+	std::vector<Rule*> selected;
+	for (Rule* rule : rules) {
+		if (std::find(names.begin(), names.end(), rule->getName()) != names.end()) {
+			selected.push_back(rule);
+		} else {
+			delete rule;
+		}
+	}
+	rules.swap(selected);
+	return true;
+}
+
+void MapValidator::walkItem(const Map& map, const Tile* tile, Item* item, std::vector<Report>& reports) const
+{
+	for (size_t r = 0; r < rules.size(); ++r) {
+		rules[r]->checkItem(map, tile, item, reports[r]);
+	}
+
+	if (Container* container = dynamic_cast<Container*>(item)) {
+		for (Item* content : container->getVector()) {
+			walkItem(map, tile, content, reports);
+		}
+	}
+}
+
+std::vector<MapValidator::Problem> MapValidator::validate(Map& map, size_t threads, bool showdialog) const
+{
+	threads = std::max<size_t>(threads, 1);
+
+	std::vector<QTreeNode*> leaves;
+	map.getLeaves(leaves);
+
+	// One report per rule and thread, nothing is shared during the pass
+	std::vector<std::vector<Report>> reports(threads, std::vector<Report>(rules.size()));
+	StripeProgress progress(leaves.size(), showdialog);
+
+	ParallelStripes(leaves.size(), threads, [&](size_t stripe, size_t begin, size_t end) {
+		std::vector<Report>& stripeReports = reports[stripe];
+		for (size_t i = begin; i < end; ++i) {
+			for (int z = 0; z < MAP_HEIGHT; ++z) {
+				Floor* floor = leaves[i]->getFloor(z);
+				if (!floor) {
+					continue;
+				}
+
+				for (TileLocation& location : floor->locs) {
+					Tile* tile = location.get();
+					if (!tile) {
+						continue;
+					}
+
+					for (size_t r = 0; r < rules.size(); ++r) {
+						rules[r]->checkTile(map, tile, stripeReports[r]);
+					}
+					if (tile->ground) {
+						walkItem(map, tile, tile->ground, stripeReports);
+					}
+					for (Item* item : tile->items) {
+						walkItem(map, tile, item, stripeReports);
+					}
+				}
+			}
+			progress.advance(stripe);
+		}
+	});
+
+	// Stripes are consecutive runs of the leaves, merging them in order keeps the map order
+	std::vector<Problem> problems;
+	for (size_t r = 0; r < rules.size(); ++r) {
+		Report merged;
+		for (std::vector<Report>& stripeReports : reports) {
+			Report& report = stripeReports[r];
+			merged.problems.insert(merged.problems.end(), report.problems.begin(), report.problems.end());
+			merged.notes.insert(merged.notes.end(), report.notes.begin(), report.notes.end());
+			report = Report();
+		}
+		rules[r]->finish(map, merged.notes, merged);
+
+		for (Problem& problem : merged.problems) {
+			problem.rule = rules[r]->getName();
+			problems.push_back(problem);
+		}
+	}
+	return problems;
+}
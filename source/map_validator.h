@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_MAP_VALIDATOR_H_
+#define RME_MAP_VALIDATOR_H_
+
+#include "position.h"
+
+class Map;
+class Tile;
+class Item;
+
+// Checks the map against a set of rules in one pass. The leaves are split
+// between threads and every rule sees every tile and every item, including
+// those inside containers. Rules that need to look across tiles, like
+// duplicate unique ids, note keys during the pass and compare them after.
+class MapValidator
+{
+public:
+	struct Problem
+	{
+		Position position;
+		std::string rule;
+		std::string description;
+	};
+
+	// A key a rule noted on a tile, see Rule::finish
+	struct Note
+	{
+		uint64_t key;
+		Position position;
+	};
+
+	// What one rule found, one per rule and thread during the pass
+	class Report
+	{
+	public:
+		void problem(const Position& position, const std::string& description);
+		void note(uint64_t key, const Position& position);
+
+	protected:
+		std::vector<Problem> problems;
+		std::vector<Note> notes;
+
+		friend class MapValidator;
+	};
+
+	class Rule
+	{
+	public:
+		Rule(const std::string& name, const std::string& description) : name(name), description(description) {}
+		virtual ~Rule() {}
+
+		const std::string& getName() const { return name; }
+		const std::string& getDescription() const { return description; }
+
+		// Called from several threads at once, the map must not change
+		virtual void checkTile(const Map&, const Tile*, Report&) const {}
+		virtual void checkItem(const Map&, const Tile*, const Item*, Report&) const {}
+		// Called once after the pass with the notes of all threads, in map order
+		virtual void finish(const Map&, std::vector<Note>&, Report&) const {}
+
+	protected:
+		std::string name;
+		std::string description;
+	};
+
+	// Starts with the built-in rules
+	MapValidator();
+	~MapValidator();
+
+	// Takes ownership, a rule with the name of an existing one replaces it
+	void addRule(Rule* rule);
+	// Keeps only the named rules, false if a name is unknown
+	bool selectRules(const std::vector<std::string>& names);
+	const std::vector<Rule*>& getRules() const { return rules; }
+
+	// Problems are ordered by rule, then by where they are on the map
+	std::vector<Problem> validate(Map& map, size_t threads, bool showdialog) const;
+
+protected:
+	void walkItem(const Map& map, const Tile* tile, Item* item, std::vector<Report>& reports) const;
+
+	std::vector<Rule*> rules;
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include "creatures.h"
 
 #include "gui.h"
+#include "settings.h"
 #include "materials.h"
 #include "brush.h"
 #include "creature_brush.h"
@@ -99,29 +100,39 @@ bool Materials::loadExtensions(FileName directoryName, wxString& error, wxArrayS
 		return false;
 	}
 
+	wxArrayString filenames;
 	wxString filename;
-	if (!ext_dir.GetFirst(&filename)) {
-		// No extensions found
-		return true;
-	}
-
-	StringVector clientVersions;
-	do {
+	for (bool found = ext_dir.GetFirst(&filename); found; found = ext_dir.GetNext(&filename)) {
 		FileName fn;
 		fn.SetPath(directoryName.GetPath());
 		fn.SetFullName(filename);
-		if (fn.GetExt() != wxT("xml")) {
-			continue;
+		if (fn.GetExt() == wxT("xml")) {
+			filenames.push_back(filename);
 		}
+	}
 
-		pugi::xml_document doc;
-		pugi::xml_parse_result result = doc.load_file(fn.GetFullPath().mb_str());
-		if (!result) {
+	// Parsing is what takes the time and the documents don't depend on each
+	// other, the materials are still added in directory order afterwards
+	std::vector<pugi::xml_document> documents(filenames.size());
+	std::vector<uint8_t> parsed(filenames.size(), 0);
+	ParallelStripes(filenames.size(), std::max(settings.getInteger(Config::WORKER_THREADS), 1), [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			FileName fn;
+			fn.SetPath(directoryName.GetPath());
+			fn.SetFullName(filenames[i]);
+			parsed[i] = documents[i].load_file(fn.GetFullPath().mb_str()) ? 1 : 0;
+		}
+	});
+
+	StringVector clientVersions;
+	for (size_t i = 0; i < filenames.size(); ++i) {
+		filename = filenames[i];
+		if (!parsed[i]) {
 			warnings.push_back(wxT("Could not open ") + filename + wxT(" (file not found or syntax error)"));
 			continue;
 		}
 
-		pugi::xml_node extensionNode = doc.child("materialsextension");
+		pugi::xml_node extensionNode = documents[i].child("materialsextension");
 		if (!extensionNode) {
 			warnings.push_back(filename + wxT(": Invalid rootheader."));
 			continue;
@@ -193,7 +204,7 @@ bool Materials::loadExtensions(FileName directoryName, wxString& error, wxArrayS
 		if (materialExtension->isForVersion(gui.GetCurrentVersionID())) {
 			unserializeMaterials(filename, extensionNode, error, warnings);
 		}
-	} while (ext_dir.GetNext(&filename));
+	}
 
 	return true;
 }
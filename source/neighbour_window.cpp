@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "neighbour_window.h"
+#include "basemap.h"
+
+// 1024x1024 tiles, more than any stroke should ever touch
+static const size_t MAX_WINDOW_TILES = 1 << 20;
+
+NeighbourWindow::NeighbourWindow(BaseMap& map) :
+	map(map),
+	min_x(0), min_y(0), min_z(0),
+	width(0), height(0), depth(0)
+{
+	//
+}
+
+NeighbourWindow::NeighbourWindow(BaseMap& map, const Position& from, const Position& to) :
+	map(map),
+	min_x(0), min_y(0), min_z(0),
+	width(0), height(0), depth(0)
+{
+	fill(from, to);
+}
+
+NeighbourWindow::NeighbourWindow(BaseMap& map, const PositionVector& positions) :
+	map(map),
+	min_x(0), min_y(0), min_z(0),
+	width(0), height(0), depth(0)
+{
+	if(positions.empty())
+		return;
+
+	Position from = positions.front();
+	Position to = positions.front();
+	for(const Position& position : positions)
+	{
+		from.x = std::min(from.x, position.x);
+		from.y = std::min(from.y, position.y);
+		from.z = std::min(from.z, position.z);
+		to.x = std::max(to.x, position.x);
+		to.y = std::max(to.y, position.y);
+		to.z = std::max(to.z, position.z);
+	}
+
+	const size_t size = size_t(to.x - from.x + 3) * size_t(to.y - from.y + 3) * size_t(to.z - from.z + 1);
+	if(size <= MAX_WINDOW_TILES)
+		fill(from, to);
+}
+
+void NeighbourWindow::fill(const Position& from, const Position& to)
+{
+	min_x = from.x - 1;
+	min_y = from.y - 1;
+	min_z = from.z;
+	width = to.x - from.x + 3;
+	height = to.y - from.y + 3;
+	depth = to.z - from.z + 1;
+	tiles.assign(size_t(width) * height * depth, nullptr);
+
+	const int max_x = min_x + width - 1;
+	const int max_y = min_y + height - 1;
+
+	// One tree descent per leaf, then the tiles are read straight off its floors
+	for(int leaf_x = std::max(min_x, 0) & ~3; leaf_x <= max_x; leaf_x += 4)
+	{
+		for(int leaf_y = std::max(min_y, 0) & ~3; leaf_y <= max_y; leaf_y += 4)
+		{
+			QTreeNode* leaf = map.getLeaf(leaf_x, leaf_y);
+			if(!leaf)
+				continue;
+
+			for(int z = 0; z < depth; ++z)
+			{
+				Floor* floor = leaf->getFloor(min_z + z);
+				if(!floor)
+					continue;
+
+				for(int i = 0; i < 16; ++i)
+				{
+					const int x = leaf_x + (i >> 2);
+					const int y = leaf_y + (i & 3);
+					if(x < min_x || x > max_x || y < min_y || y > max_y)
+						continue;
+
+					tiles[(size_t(z) * height + (y - min_y)) * width + (x - min_x)] = floor->locs[i].get();
+				}
+			}
+		}
+	}
+}
+
+Tile* NeighbourWindow::getTile(int x, int y, int z) const
+{
+	if(x < 0 || y < 0)
+		return nullptr;
+
+	if(x < min_x || y < min_y || z < min_z || x >= min_x + width || y >= min_y + height || z >= min_z + depth)
+		return map.getTile(x, y, z);
+
+	return tiles[(size_t(z - min_z) * height + (y - min_y)) * width + (x - min_x)];
+}
+
+void NeighbourWindow::getNeighbours(const Position& position, Tile* neighbours[8]) const
+{
+	const int x = position.x;
+	const int y = position.y;
+	const int z = position.z;
+
+	neighbours[0] = getTile(x - 1, y - 1, z);
+	neighbours[1] = getTile(x,     y - 1, z);
+	neighbours[2] = getTile(x + 1, y - 1, z);
+	neighbours[3] = getTile(x - 1, y,     z);
+	neighbours[4] = getTile(x + 1, y,     z);
+	neighbours[5] = getTile(x - 1, y + 1, z);
+	neighbours[6] = getTile(x,     y + 1, z);
+	neighbours[7] = getTile(x + 1, y + 1, z);
+}
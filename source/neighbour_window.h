@@ -0,0 +1,45 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_NEIGHBOUR_WINDOW_H_
+#define RME_NEIGHBOUR_WINDOW_H_
+
+#include "position.h"
+
+class BaseMap;
+class Tile;
+
+// The tiles of a rectangle and the ring of tiles around it, looked up leaf
+// by leaf in one pass. Brushes read the neighbours of a tile from here
+// instead of descending the map tree once for each of them.
+// It's a snapshot, it must not outlive changes to the tiles it covers.
+class NeighbourWindow
+{
+public:
+	// Covers nothing, every lookup goes to the map. For a single tile that's
+	// cheaper than filling a window for its eight neighbours.
+	explicit NeighbourWindow(BaseMap& map);
+	// Covers from - 1 to to + 1 on the floors from.z to to.z
+	NeighbourWindow(BaseMap& map, const Position& from, const Position& to);
+	// Covers the bounding box of the positions, if that box would be
+	// too large, every lookup goes to the map instead
+	NeighbourWindow(BaseMap& map, const PositionVector& positions);
+
+	// Positions outside the window are looked up in the map
+	Tile* getTile(int x, int y, int z) const;
+
+	// North-west, north, north-east, west, east, south-west, south, south-east,
+	// nullptr for positions left of or above the map
+	void getNeighbours(const Position& position, Tile* neighbours[8]) const;
+
+protected:
+	void fill(const Position& from, const Position& to);
+
+	BaseMap& map;
+	int min_x, min_y, min_z;
+	int width, height, depth;
+	std::vector<Tile*> tiles;
+};
+
+#endif
@@ -59,6 +59,37 @@ template<> void NetworkMessage::write<Position>(const Position& value)
 	write<uint8_t>(value.z);
 }
 
+void NetworkMessage::writeBytes(const uint8_t* data, size_t length)
+{
+	write<uint32_t>(length);
+	if (length == 0) {
+		return;
+	}
+
+	expand(length);
+	memcpy(&buffer[position], data, length);
+	position += length;
+}
+
+const uint8_t* NetworkMessage::readBytes(uint32_t& length)
+{
+	if (position + sizeof(uint32_t) > buffer.size()) {
+		length = 0;
+		return nullptr;
+	}
+
+	length = read<uint32_t>();
+	if (length > buffer.size() - position) {
+		length = 0;
+		position = buffer.size();
+		return nullptr;
+	}
+
+	const uint8_t* data = buffer.data() + position;
+	position += length;
+	return data;
+}
+
 // NetworkConnection
 NetworkConnection::NetworkConnection() :
 	service(nullptr), thread(), stopped(false)
@@ -32,6 +32,11 @@ struct NetworkMessage
 		position += sizeof(T);
 	}
 
+	// Raw data prefixed with a 32 bit length, for payloads that don't fit a string
+	void writeBytes(const uint8_t* data, size_t length);
+	// nullptr if the message holds less than the length it claims
+	const uint8_t* readBytes(uint32_t& length);
+
 	//
 	std::vector<uint8_t> buffer;
 	size_t position;
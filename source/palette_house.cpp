@@ -233,6 +233,13 @@ void HousePalettePanel::SelectHouse(size_t index) {
 		// Select the house
 		house_list->SetSelection(index);
 		SelectHouseBrush();
+
+		House* house = GetCurrentlySelectedHouse();
+		if(house)
+		{
+			gui.SetStatusText(wxString::Format(wxT("%s: %d sqm, %d tiles, %d doors"),
+				wxstr(house->name), int(house->size()), int(house->getTileCount()), int(house->getDoorCount())));
+		}
 	} else {
 		// No houses :(
 		edit_house_button->Enable(false);
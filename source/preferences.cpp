@@ -108,6 +108,11 @@ wxNotebookPage* PreferencesWindow::CreateGeneralPage() {
 	grid_sizer->Add(worker_threads_spin, 0);
 	SetWindowToolTip(tmptext, worker_threads_spin, wxT("How many threads the editor will use for intensive operations. This should be equivalent to the amount of logical processors in your system."));
 
+	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, wxT("Live cursor updates per second: ")), 0);
+	live_cursor_rate_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(settings.getInteger(Config::LIVE_CURSOR_RATE)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, 60);
+	grid_sizer->Add(live_cursor_rate_spin, 0);
+	SetWindowToolTip(tmptext, live_cursor_rate_spin, wxT("How often cursor positions are exchanged in a live session, lower values save bandwidth when many people are connected."));
+
 	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, wxT("Replace count: ")), 0);
 	replace_size_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(settings.getInteger(Config::REPLACE_SIZE)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 100000);
 	grid_sizer->Add(replace_size_spin, 0);
@@ -577,6 +582,7 @@ void PreferencesWindow::Apply()
 	settings.setInteger(Config::UNDO_SIZE, undo_size_spin->GetValue());
 	settings.setInteger(Config::UNDO_MEM_SIZE, undo_mem_size_spin->GetValue());
 	settings.setInteger(Config::WORKER_THREADS, worker_threads_spin->GetValue());
+	settings.setInteger(Config::LIVE_CURSOR_RATE, live_cursor_rate_spin->GetValue());
 	settings.setInteger(Config::REPLACE_SIZE, replace_size_spin->GetValue());
 
 	// Editor
@@ -0,0 +1,371 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "reachability.h"
+#include "map.h"
+#include "complexitem.h"
+#include "gui.h"
+
+static bool HasFlag(const Tile* tile, bool ItemType::*flag)
+{
+	if (tile->ground && item_db[tile->ground->getID()].*flag) {
+		return true;
+	}
+
+	for (const Item* item : tile->items) {
+		if (item_db[item->getID()].*flag) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int LowestBit(uint64_t word)
+{
+	int bit = 0;
+	for (; !(word & 1); word >>= 1) {
+		++bit;
+	}
+	return bit;
+}
+
+static bool IsWalkable(const Tile* tile)
+{
+	return tile && tile->ground && !tile->isBlocking();
+}
+
+int64_t Reachability::Plane::index(int x, int y) const
+{
+	x -= x0;
+	y -= y0;
+	if (x < 0 || y < 0 || x >= width || y >= height) {
+		return -1;
+	}
+	return int64_t(y) * width + x;
+}
+
+Reachability::Reachability() :
+	walkableCount(0),
+	reachableCount(0)
+{
+	//
+}
+
+bool Reachability::isWalkable(const Position& pos) const
+{
+	if (pos.z < 0 || pos.z >= MAP_HEIGHT) {
+		return false;
+	}
+
+	const Plane& plane = planes[pos.z];
+	const int64_t bit = plane.index(pos.x, pos.y);
+	return bit >= 0 && (plane.walkable[bit >> 6] >> (bit & 63)) & 1;
+}
+
+bool Reachability::isReachable(const Position& pos) const
+{
+	if (pos.z < 0 || pos.z >= MAP_HEIGHT) {
+		return false;
+	}
+
+	const Plane& plane = planes[pos.z];
+	const int64_t bit = plane.index(pos.x, pos.y);
+	return bit >= 0 && !plane.reachable.empty() && (plane.reachable[bit >> 6] >> (bit & 63)) & 1;
+}
+
+void Reachability::addLink(Map& map, const Position& from, Tile* tile, std::vector<std::pair<Position, Position>>& planeLinks)
+{
+	// Stairs and holes down land on the tile below, a ramp there pushes
+	// the player one step off it, the way the server does it
+	if (from.z + 1 < MAP_HEIGHT && HasFlag(tile, &ItemType::floorChangeDown)) {
+		Position landing(from.x, from.y, from.z + 1);
+		Tile* below = map.getTile(landing);
+		if (below) {
+			if (HasFlag(below, &ItemType::floorChangeNorth)) {
+				++landing.y;
+			} else if (HasFlag(below, &ItemType::floorChangeSouth)) {
+				--landing.y;
+			} else if (HasFlag(below, &ItemType::floorChangeEast)) {
+				--landing.x;
+			} else if (HasFlag(below, &ItemType::floorChangeWest)) {
+				++landing.x;
+			}
+		}
+		planeLinks.push_back(std::make_pair(from, landing));
+	}
+
+	if (from.z > 0) {
+		if (HasFlag(tile, &ItemType::floorChangeNorth)) {
+			planeLinks.push_back(std::make_pair(from, Position(from.x, from.y - 1, from.z - 1)));
+		}
+		if (HasFlag(tile, &ItemType::floorChangeSouth)) {
+			planeLinks.push_back(std::make_pair(from, Position(from.x, from.y + 1, from.z - 1)));
+		}
+		if (HasFlag(tile, &ItemType::floorChangeEast)) {
+			planeLinks.push_back(std::make_pair(from, Position(from.x + 1, from.y, from.z - 1)));
+		}
+		if (HasFlag(tile, &ItemType::floorChangeWest)) {
+			planeLinks.push_back(std::make_pair(from, Position(from.x - 1, from.y, from.z - 1)));
+		}
+	}
+
+	for (Item* item : tile->items) {
+		Teleport* teleport = dynamic_cast<Teleport*>(item);
+		if (teleport && teleport->getDestination() != Position() && teleport->getDestination().isValid()) {
+			planeLinks.push_back(std::make_pair(from, teleport->getDestination()));
+		}
+	}
+}
+
+void Reachability::buildPlane(const std::vector<QTreeNode*>& leaves, Map& map, int z, std::vector<std::pair<Position, Position>>& planeLinks)
+{
+	Plane& plane = planes[z];
+
+	int minx = 0x10000, miny = 0x10000, maxx = -1, maxy = -1;
+	for (QTreeNode* leaf : leaves) {
+		Floor* floor = leaf->getFloor(z);
+		if (!floor) {
+			continue;
+		}
+
+		for (TileLocation& location : floor->locs) {
+			if (!IsWalkable(location.get())) {
+				continue;
+			}
+
+			Position pos = location.getPosition();
+			minx = std::min<int>(minx, pos.x);
+			miny = std::min<int>(miny, pos.y);
+			maxx = std::max<int>(maxx, pos.x);
+			maxy = std::max<int>(maxy, pos.y);
+		}
+	}
+
+	if (maxx < 0) {
+		return;
+	}
+
+	plane.x0 = minx;
+	plane.y0 = miny;
+	plane.width = maxx - minx + 1;
+	plane.height = maxy - miny + 1;
+
+	const size_t words = (size_t(plane.width) * plane.height + 63) / 64;
+	plane.walkable.assign(words, 0);
+	plane.portal.assign(words, 0);
+	plane.visited = std::vector<std::atomic<uint64_t>>(words);
+
+	for (QTreeNode* leaf : leaves) {
+		Floor* floor = leaf->getFloor(z);
+		if (!floor) {
+			continue;
+		}
+
+		for (TileLocation& location : floor->locs) {
+			Tile* tile = location.get();
+			if (!IsWalkable(tile)) {
+				continue;
+			}
+
+			Position pos = location.getPosition();
+			const int64_t bit = plane.index(pos.x, pos.y);
+			plane.walkable[bit >> 6] |= uint64_t(1) << (bit & 63);
+
+			const size_t linkCount = planeLinks.size();
+			addLink(map, pos, tile, planeLinks);
+			if (planeLinks.size() != linkCount) {
+				plane.portal[bit >> 6] |= uint64_t(1) << (bit & 63);
+			}
+		}
+	}
+}
+
+bool Reachability::visit(const Position& pos, Node& node)
+{
+	if (pos.z < 0 || pos.z >= MAP_HEIGHT) {
+		return false;
+	}
+
+	Plane& plane = planes[pos.z];
+	const int64_t bit = plane.index(pos.x, pos.y);
+	if (bit < 0) {
+		return false;
+	}
+
+	const uint64_t mask = uint64_t(1) << (bit & 63);
+	if (!(plane.walkable[bit >> 6] & mask)) {
+		return false;
+	}
+
+	// Cheap check first, most neighbours are already visited
+	if (plane.visited[bit >> 6].load(std::memory_order_relaxed) & mask) {
+		return false;
+	}
+	if (plane.visited[bit >> 6].fetch_or(mask) & mask) {
+		return false;
+	}
+
+	node = MakeNode(pos.z, bit);
+	return true;
+}
+
+void Reachability::expand(Node node, std::vector<Node>& next)
+{
+	const int z = int(node >> 40);
+	const int64_t bit = int64_t(node & ((uint64_t(1) << 40) - 1));
+	const Plane& plane = planes[z];
+	const Position pos(plane.x0 + int(bit % plane.width), plane.y0 + int(bit / plane.width), z);
+
+	Node neighbour;
+	for (int dy = -1; dy <= 1; ++dy) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			if ((dx != 0 || dy != 0) && visit(Position(pos.x + dx, pos.y + dy, z), neighbour)) {
+				next.push_back(neighbour);
+			}
+		}
+	}
+
+	if ((plane.portal[bit >> 6] >> (bit & 63)) & 1) {
+		auto range = links.equal_range(Key(pos));
+		for (auto it = range.first; it != range.second; ++it) {
+			if (visit(it->second, neighbour)) {
+				next.push_back(neighbour);
+			}
+		}
+	}
+}
+
+size_t Reachability::fill(std::vector<Node>& frontier, size_t threads, bool showdialog)
+{
+	size_t visited = frontier.size();
+	std::vector<std::vector<Node>> next(threads);
+	int32_t shown = -1;
+
+	while (!frontier.empty()) {
+		// Small frontiers aren't worth waking threads for
+		const size_t stripes = std::min(threads, frontier.size() / 1024 + 1);
+		ParallelStripes(frontier.size(), stripes, [&](size_t stripe, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				expand(frontier[i], next[stripe]);
+			}
+		});
+
+		frontier.clear();
+		for (std::vector<Node>& found : next) {
+			frontier.insert(frontier.end(), found.begin(), found.end());
+			found.clear();
+		}
+		visited += frontier.size();
+
+		const int32_t progress = walkableCount > 0 ? static_cast<int32_t>(30 + 60.0 * visited / walkableCount) : 90;
+		if (showdialog && progress != shown) {
+			gui.SetLoadDone(progress);
+			shown = progress;
+		}
+	}
+	return visited;
+}
+
+bool Reachability::analyze(Map& map, size_t threads, bool showdialog)
+{
+	threads = std::max<size_t>(threads, 1);
+	links.clear();
+	regions.clear();
+	walkableCount = 0;
+	reachableCount = 0;
+
+	std::vector<QTreeNode*> leaves;
+	map.getLeaves(leaves);
+
+	// Floors are built independently, each collects its own links
+	std::vector<std::pair<Position, Position>> planeLinks[MAP_HEIGHT];
+	StripeProgress progress(MAP_HEIGHT, showdialog, 0, 30, 1);
+	ParallelStripes(MAP_HEIGHT, threads, [&](size_t stripe, size_t begin, size_t end) {
+		for (size_t z = begin; z < end; ++z) {
+			planes[z] = Plane();
+			buildPlane(leaves, map, int(z), planeLinks[z]);
+			progress.advance(stripe);
+		}
+	});
+
+	for (int z = 0; z < MAP_HEIGHT; ++z) {
+		for (const auto& link : planeLinks[z]) {
+			links.insert(std::make_pair(Key(link.first), link.second));
+		}
+
+		const Plane& plane = planes[z];
+		for (uint64_t word : plane.walkable) {
+			for (; word; word &= word - 1) {
+				++walkableCount;
+			}
+		}
+	}
+
+	std::vector<Node> frontier;
+	for (const auto& town : map.towns) {
+		Node node;
+		if (visit(town.second->getTemplePosition(), node)) {
+			frontier.push_back(node);
+		}
+	}
+
+	if (frontier.empty()) {
+		for (Plane& plane : planes) {
+			plane = Plane();
+		}
+		return false;
+	}
+
+	reachableCount = fill(frontier, threads, showdialog);
+
+	for (Plane& plane : planes) {
+		plane.reachable.resize(plane.visited.size());
+		for (size_t i = 0; i < plane.visited.size(); ++i) {
+			plane.reachable[i] = plane.visited[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	// Whatever walkable is left over falls apart into isolated regions, they
+	// are usually small so each is filled on this thread
+	for (int z = 0; z < MAP_HEIGHT; ++z) {
+		Plane& plane = planes[z];
+		for (size_t i = 0; i < plane.walkable.size(); ++i) {
+			uint64_t left = plane.walkable[i] & ~plane.visited[i].load(std::memory_order_relaxed);
+			for (; left; left &= left - 1) {
+				const int64_t bit = int64_t(i) * 64 + LowestBit(left);
+
+				// Filled by an earlier region of this word
+				if (plane.visited[i].load(std::memory_order_relaxed) & (uint64_t(1) << (bit & 63))) {
+					continue;
+				}
+
+				Region region;
+				region.start = Position(plane.x0 + int(bit % plane.width), plane.y0 + int(bit / plane.width), z);
+
+				Node node;
+				visit(region.start, node);
+				frontier.assign(1, node);
+				region.tiles = fill(frontier, 1, false);
+				regions.push_back(region);
+			}
+		}
+
+		if (showdialog) {
+			gui.SetLoadDone(90 + 10 * (z + 1) / MAP_HEIGHT);
+		}
+	}
+
+	std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) {
+		return a.tiles > b.tiles;
+	});
+
+	for (Plane& plane : planes) {
+		plane.portal.clear();
+		plane.visited = std::vector<std::atomic<uint64_t>>();
+	}
+	links.clear();
+	return true;
+}
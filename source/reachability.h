@@ -0,0 +1,85 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_REACHABILITY_H_
+#define RME_REACHABILITY_H_
+
+#include "position.h"
+
+#include <atomic>
+#include <unordered_map>
+
+class Map;
+class Tile;
+class QTreeNode;
+
+// Which tiles a player can walk to from the temples. Every floor is kept
+// as a bitset of walkable tiles (ground and not blocking) over the bounds
+// of its walkable tiles, floor changes and teleports link the floors.
+// The fill goes one step at a time with each step's frontier split
+// between threads. The result is a snapshot, later edits aren't tracked.
+class Reachability
+{
+public:
+	// Walkable tiles that are connected to each other but not to a temple
+	struct Region
+	{
+		Position start;
+		size_t tiles;
+	};
+
+	Reachability();
+
+	// False if no town has its temple on a walkable tile
+	bool analyze(Map& map, size_t threads, bool showdialog);
+
+	bool isWalkable(const Position& pos) const;
+	bool isReachable(const Position& pos) const;
+
+	size_t getWalkableCount() const { return walkableCount; }
+	size_t getReachableCount() const { return reachableCount; }
+	// Biggest first
+	const std::vector<Region>& getRegions() const { return regions; }
+
+protected:
+	struct Plane
+	{
+		Plane() : x0(0), y0(0), width(0), height(0) {}
+
+		// Bit index of a position, -1 if it's outside the plane
+		int64_t index(int x, int y) const;
+
+		int x0, y0;
+		int width, height;
+		std::vector<uint64_t> walkable;
+		// Tiles that lead somewhere else, their links are in 'links'
+		std::vector<uint64_t> portal;
+		std::vector<uint64_t> reachable;
+		std::vector<std::atomic<uint64_t>> visited;
+	};
+
+	// A tile on a plane, floor in the upper bits, bit index in the lower
+	typedef uint64_t Node;
+	static Node MakeNode(int z, int64_t index) { return (uint64_t(z) << 40) | uint64_t(index); }
+
+	void buildPlane(const std::vector<QTreeNode*>& leaves, Map& map, int z, std::vector<std::pair<Position, Position>>& planeLinks);
+	void addLink(Map& map, const Position& from, Tile* tile, std::vector<std::pair<Position, Position>>& planeLinks);
+
+	// Marks the node visited, true if it wasn't yet
+	bool visit(const Position& pos, Node& node);
+	void expand(Node node, std::vector<Node>& next);
+	// Runs the fill until the frontier is empty, returns the tiles visited
+	size_t fill(std::vector<Node>& frontier, size_t threads, bool showdialog);
+
+	static uint64_t Key(const Position& pos) { return (uint64_t(pos.z) << 32) | (uint64_t(pos.y & 0xFFFF) << 16) | uint64_t(pos.x & 0xFFFF); }
+
+	Plane planes[MAP_HEIGHT];
+	std::unordered_multimap<uint64_t, Position> links;
+
+	size_t walkableCount;
+	size_t reachableCount;
+	std::vector<Region> regions;
+};
+
+#endif
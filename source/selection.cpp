@@ -42,36 +42,130 @@ Selection::~Selection()
 
 Position Selection::minPosition() const
 {
+	refreshBounds();
+
 	Position minPos(0x10000, 0x10000, 0x10);
-	for (TileVector::const_iterator tile = tiles.begin(); tile != tiles.end(); ++tile)
+	for(int z = 0; z < MAP_HEIGHT; ++z)
 	{
-		Position pos((*tile)->getPosition());
-		if (minPos.x > pos.x)
-			minPos.x = pos.x;
-		if (minPos.y > pos.y)
-			minPos.y = pos.y;
-		if (minPos.z > pos.z)
-			minPos.z = pos.z;
+		const FloorBounds& floor = bounds[z];
+		if(floor.count == 0)
+			continue;
+
+		if(minPos.x > floor.min_x)
+			minPos.x = floor.min_x;
+		if(minPos.y > floor.min_y)
+			minPos.y = floor.min_y;
+		if(minPos.z > z)
+			minPos.z = z;
 	}
 	return minPos;
 }
 
 Position Selection::maxPosition() const
 {
+	refreshBounds();
+
 	Position maxPos(0, 0, 0);
-	for (TileVector::const_iterator tile = tiles.begin(); tile != tiles.end(); ++tile)
+	for(int z = 0; z < MAP_HEIGHT; ++z)
 	{
-		Position pos((*tile)->getPosition());
-		if (maxPos.x < pos.x)
-			maxPos.x = pos.x;
-		if (maxPos.y < pos.y)
-			maxPos.y = pos.y;
-		if (maxPos.z < pos.z)
-			maxPos.z = pos.z;
+		const FloorBounds& floor = bounds[z];
+		if(floor.count == 0)
+			continue;
+
+		if(maxPos.x < floor.max_x)
+			maxPos.x = floor.max_x;
+		if(maxPos.y < floor.max_y)
+			maxPos.y = floor.max_y;
+		if(maxPos.z < z)
+			maxPos.z = z;
 	}
 	return maxPos;
 }
 
+bool Selection::getFloorBounds(int z, Position& minPos, Position& maxPos) const
+{
+	if(z < 0 || z >= MAP_HEIGHT || bounds[z].count == 0)
+		return false;
+
+	refreshBounds();
+
+	const FloorBounds& floor = bounds[z];
+	minPos = Position(floor.min_x, floor.min_y, z);
+	maxPos = Position(floor.max_x, floor.max_y, z);
+	return true;
+}
+
+void Selection::expandBounds(const Position& pos)
+{
+	FloorBounds& floor = bounds[pos.z];
+	++floor.count;
+
+	// Stale boxes are rebuilt from scratch anyway
+	if(floor.stale)
+		return;
+
+	if(floor.min_x > pos.x)
+		floor.min_x = pos.x;
+	if(floor.min_y > pos.y)
+		floor.min_y = pos.y;
+	if(floor.max_x < pos.x)
+		floor.max_x = pos.x;
+	if(floor.max_y < pos.y)
+		floor.max_y = pos.y;
+}
+
+void Selection::shrinkBounds(const Position& pos)
+{
+	FloorBounds& floor = bounds[pos.z];
+	ASSERT(floor.count > 0);
+
+	if(--floor.count == 0)
+	{
+		floor.reset();
+		floor.stale = false;
+	}
+	else if(pos.x == floor.min_x || pos.x == floor.max_x || pos.y == floor.min_y || pos.y == floor.max_y)
+	{
+		floor.stale = true;
+	}
+}
+
+void Selection::refreshBounds() const
+{
+	bool stale = false;
+	for(int z = 0; z < MAP_HEIGHT; ++z)
+	{
+		if(bounds[z].stale)
+		{
+			bounds[z].reset();
+			stale = true;
+		}
+	}
+
+	if(!stale)
+		return;
+
+	// One pass over the selection rebuilds every stale floor at once
+	for(const Position& pos : positions)
+	{
+		FloorBounds& floor = bounds[pos.z];
+		if(!floor.stale)
+			continue;
+
+		if(floor.min_x > pos.x)
+			floor.min_x = pos.x;
+		if(floor.min_y > pos.y)
+			floor.min_y = pos.y;
+		if(floor.max_x < pos.x)
+			floor.max_x = pos.x;
+		if(floor.max_y < pos.y)
+			floor.max_y = pos.y;
+	}
+
+	for(int z = 0; z < MAP_HEIGHT; ++z)
+		bounds[z].stale = false;
+}
+
 void Selection::add(Tile* tile, Item* item)
 {
 	ASSERT(subsession);
@@ -80,16 +174,14 @@ void Selection::add(Tile* tile, Item* item)
 
 	if(item->isSelected()) return;
 
-	// Make a copy of the tile with the item selected
-	item->select();
-	Tile* new_tile = tile->deepCopy(editor.map);
-	item->deselect();
+	TileSelection state(tile);
+	state.setItem(tile, item, true);
 
 	if(settings.getInteger(Config::BORDER_IS_GROUND))
 		if(item->isBorder())
-			new_tile->selectGround();
+			state.setGround(tile, true);
 
-	subsession->addChange(newd Change(new_tile));
+	addChange(tile, state);
 }
 
 void Selection::add(Tile* tile, Spawn* spawn)
@@ -100,12 +192,9 @@ void Selection::add(Tile* tile, Spawn* spawn)
 
 	if(spawn->isSelected()) return;
 
-	// Make a copy of the tile with the item selected
-	spawn->select();
-	Tile* new_tile = tile->deepCopy(editor.map);
-	spawn->deselect();
-
-	subsession->addChange(newd Change(new_tile));
+	TileSelection state(tile);
+	state.flags |= TileSelection::SPAWN;
+	addChange(tile, state);
 }
 
 void Selection::add(Tile* tile, Creature* creature)
@@ -116,12 +205,9 @@ void Selection::add(Tile* tile, Creature* creature)
 
 	if(creature->isSelected()) return;
 
-	// Make a copy of the tile with the item selected
-	creature->select();
-	Tile* new_tile = tile->deepCopy(editor.map);
-	creature->deselect();
-
-	subsession->addChange(newd Change(new_tile));
+	TileSelection state(tile);
+	state.flags |= TileSelection::CREATURE;
+	addChange(tile, state);
 }
 
 void Selection::add(Tile* tile)
@@ -129,10 +215,9 @@ void Selection::add(Tile* tile)
 	ASSERT(subsession);
 	ASSERT(tile);
 
-	Tile* new_tile = tile->deepCopy(editor.map);
-	new_tile->select();
-
-	subsession->addChange(newd Change(new_tile));
+	TileSelection state(tile);
+	state.setAll(tile, true);
+	addChange(tile, state);
 }
 
 void Selection::remove(Tile* tile, Item* item)
@@ -141,13 +226,11 @@ void Selection::remove(Tile* tile, Item* item)
 	ASSERT(tile);
 	ASSERT(item);
 
-	bool tmp = item->isSelected();
-	item->deselect();
-	Tile* new_tile = tile->deepCopy(editor.map);
-	if(tmp) item->select();
-	if(item->isBorder() && settings.getInteger(Config::BORDER_IS_GROUND)) new_tile->deselectGround();
+	TileSelection state(tile);
+	state.setItem(tile, item, false);
+	if(item->isBorder() && settings.getInteger(Config::BORDER_IS_GROUND)) state.setGround(tile, false);
 
-	subsession->addChange(newd Change(new_tile));
+	addChange(tile, state);
 }
 
 void Selection::remove(Tile* tile, Spawn* spawn)
@@ -156,12 +239,9 @@ void Selection::remove(Tile* tile, Spawn* spawn)
 	ASSERT(tile);
 	ASSERT(spawn);
 
-	bool tmp = spawn->isSelected();
-	spawn->deselect();
-	Tile* new_tile = tile->deepCopy(editor.map);
-	if(tmp) spawn->select();
-
-	subsession->addChange(newd Change(new_tile));
+	TileSelection state(tile);
+	state.flags &= ~TileSelection::SPAWN;
+	addChange(tile, state);
 }
 
 void Selection::remove(Tile* tile, Creature* creature)
@@ -170,68 +250,66 @@ void Selection::remove(Tile* tile, Creature* creature)
 	ASSERT(tile);
 	ASSERT(creature);
 
-	bool tmp = creature->isSelected();
-	creature->deselect();
-	Tile* new_tile = tile->deepCopy(editor.map);
-	if(tmp) creature->select();
-
-	subsession->addChange(newd Change(new_tile));
+	TileSelection state(tile);
+	state.flags &= ~TileSelection::CREATURE;
+	addChange(tile, state);
 }
 
 void Selection::remove(Tile* tile)
 {
 	ASSERT(subsession);
 
-	Tile* new_tile = tile->deepCopy(editor.map);
-	new_tile->deselect();
+	TileSelection state(tile);
+	state.setAll(tile, false);
+	addChange(tile, state);
+}
+
+void Selection::addChange(Tile* tile, const TileSelection& state)
+{
+	// Nothing to do if the tile already looks like that
+	if(state == TileSelection(tile))
+		return;
 
-	subsession->addChange(newd Change(new_tile));
+	subsession->addChange(Change::Create(state));
 }
 
 void Selection::addInternal(Tile* tile)
 {
 	ASSERT(tile);
 
+	if(!index.insert(std::make_pair(tile, tiles.size())).second)
+		return;
+
+	const Position pos = tile->getPosition();
 	tiles.push_back(tile);
-	erase_iterator = tiles.begin();
+	positions.push_back(pos);
+	expandBounds(pos);
 }
 
 void Selection::removeInternal(Tile* tile)
 {
 	ASSERT(tile);
-#ifdef __DEBUG_MODE__
-	TileVector::iterator erase_begin = erase_iterator;
-#endif
-	if(tiles.size() == 0)
+
+	auto it = index.find(tile);
+	if(it == index.end())
 		return;
 
-	TileVector::iterator end_iter = tiles.end();
-	do {
-		if(erase_iterator == end_iter)
-		{
-			erase_iterator = tiles.begin();
-		}
-		if(*erase_iterator == tile)
-		{
-			// Swap & pop trick
-			if(*erase_iterator == tiles.back())
-			{
-				tiles.pop_back();
-				erase_iterator = tiles.begin();
-			}
-			else
-			{
-				std::swap(*erase_iterator, tiles.back());
-				tiles.pop_back();
-				erase_iterator = tiles.begin() + (erase_iterator - tiles.begin());
-			}
-			return;
-		}
-		++erase_iterator;
-#ifdef __DEBUG_MODE__
-		ASSERT(/* This shouldn't happend*/ erase_iterator != erase_begin);
-#endif
-	} while(true);
+	const size_t i = it->second;
+	const Position pos = positions[i];
+	index.erase(it);
+
+	// Swap & pop trick
+	const size_t last = tiles.size() - 1;
+	if(i != last)
+	{
+		tiles[i] = tiles[last];
+		positions[i] = positions[last];
+		index[tiles[i]] = i;
+	}
+	tiles.pop_back();
+	positions.pop_back();
+
+	shrinkBounds(pos);
 }
 
 void Selection::clear()
@@ -240,9 +318,9 @@ void Selection::clear()
 	{
 		for(TileVector::iterator it = tiles.begin(); it != tiles.end(); it++)
 		{
-			Tile* new_tile = (*it)->deepCopy(editor.map);
-			new_tile->deselect();
-			subsession->addChange(newd Change(new_tile));
+			TileSelection state(*it);
+			state.setAll(*it, false);
+			subsession->addChange(Change::Create(state));
 		}
 	}
 	else
@@ -252,6 +330,11 @@ void Selection::clear()
 			(*it)->deselect();
 		}
 		tiles.clear();
+		positions.clear();
+		index.clear();
+
+		for(int z = 0; z < MAP_HEIGHT; ++z)
+			bounds[z] = FloorBounds();
 	}
 }
 
@@ -269,13 +352,11 @@ void Selection::start(SessionFlags flags)
 		}
 		subsession = editor.actionQueue->createAction(ACTION_SELECT);
 	}
-	erase_iterator = tiles.begin();
 	busy = true;
 }
 
 void Selection::commit()
 {
-	erase_iterator = tiles.begin();
 	if(session)
 	{
 		ASSERT(subsession);
@@ -294,7 +375,6 @@ void Selection::commit()
 
 void Selection::finish(SessionFlags flags)
 {
-	erase_iterator = tiles.begin();
 	if(!(flags & INTERNAL))
 	{
 		if(flags & SUBTHREAD)
@@ -371,21 +451,42 @@ void SelectionThread::Execute()
 
 wxThread::ExitCode SelectionThread::Entry()
 {
+	const bool compensated = settings.getInteger(Config::COMPENSATED_SELECT) != 0;
+
 	selection.start(Selection::SUBTHREAD);
 	for(int z = start.z; z >= end.z; --z)
 	{
-		for(int x = start.x; x <= end.x; ++x)
+		// Walk the leaves covering the rectangle instead of looking up every
+		// tile, a leaf that doesn't exist skips 4x4 tiles at once
+		int min_x = std::max(start.x, 0), max_x = std::min(end.x, 0xFFFF);
+		int min_y = std::max(start.y, 0), max_y = std::min(end.y, 0xFFFF);
+
+		for(int leaf_x = min_x & ~3; leaf_x <= max_x; leaf_x += 4)
 		{
-			for(int y = start.y; y <= end.y; ++y)
+			for(int leaf_y = min_y & ~3; leaf_y <= max_y; leaf_y += 4)
 			{
-				Tile* tile = editor.map.getTile(x, y, z);
-				if(!tile)
+				QTreeNode* leaf = editor.map.getLeaf(leaf_x, leaf_y);
+				if(!leaf)
+					continue;
+
+				Floor* floor = leaf->getFloor(z);
+				if(!floor)
 					continue;
 
-				selection.add(tile);
+				int from_x = std::max(min_x, leaf_x), to_x = std::min(max_x, leaf_x + 3);
+				int from_y = std::max(min_y, leaf_y), to_y = std::min(max_y, leaf_y + 3);
+				for(int x = from_x; x <= to_x; ++x)
+				{
+					for(int y = from_y; y <= to_y; ++y)
+					{
+						Tile* tile = floor->locs[(x & 3) * 4 + (y & 3)].get();
+						if(tile)
+							selection.add(tile);
+					}
+				}
 			}
 		}
-		if(z <= 7 && settings.getInteger(Config::COMPENSATED_SELECT))
+		if(z <= 7 && compensated)
 		{
 			++start.x; ++start.y;
 			++end.x; ++end.y;
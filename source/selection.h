@@ -7,8 +7,11 @@
 
 #include "position.h"
 
+#include <unordered_map>
+
 class Action;
 class Editor;
+class TileSelection;
 class BatchAction;
 
 class SelectionThread;
@@ -40,9 +43,12 @@ public:
 	// Returns true when inside a session
 	bool isBusy() {return busy;}
 
-	//
+	// Bounds of the whole selection, kept up to date as tiles come and go
 	Position minPosition() const;
 	Position maxPosition() const;
+	// Bounds of the selected tiles on one floor, false if there are none
+	bool getFloorBounds(int z, Position& minPos, Position& maxPos) const;
+	bool isSelected(Tile* tile) const {return index.find(tile) != index.end();}
 
 	// This manages a "selection session"
 	// Internal session doesn't store the result (eg. no undo)
@@ -70,13 +76,34 @@ public:
 	Tile* getSelectedTile() {ASSERT(size() == 1); return tiles.front();}
 
 private:
+	struct FloorBounds {
+		FloorBounds() : count(0), stale(false) {reset();}
+		void reset() {min_x = min_y = 0x10000; max_x = max_y = -1;}
+
+		size_t count;
+		int min_x, min_y, max_x, max_y;
+		// A tile on the edge was removed, the box is recomputed when asked for
+		bool stale;
+	};
+
+	// Queues a selection change in the current session, unless it changes nothing
+	void addChange(Tile* tile, const TileSelection& state);
+
+	void expandBounds(const Position& pos);
+	void shrinkBounds(const Position& pos);
+	void refreshBounds() const;
+
 	bool busy;
 	Editor& editor;
 	BatchAction* session;
 	Action* subsession;
 
+	// tiles[i] was selected at positions[i], index maps a tile to i so
+	// removing it is a swap with the last one instead of a search
 	TileVector tiles;
-	TileVector::iterator erase_iterator;
+	std::vector<Position> positions;
+	std::unordered_map<Tile*, size_t> index;
+	mutable FloorBounds bounds[MAP_HEIGHT];
 
 	friend class SelectionThread;
 };
@@ -199,6 +199,8 @@ void Settings::IO(IOMode mode) {
 	Int(SHOW_CREATURES, 1);
 	Int(SHOW_HOUSES, 1);
 	Int(SHOW_BLOCKING, 0);
+	Int(SHOW_REACHABILITY, 0);
+	Int(SHOW_MAP_DIFF, 1);
 	Int(SHOW_ONLY_TILEFLAGS, 0);
 	Int(SHOW_ONLY_MODIFIED_TILES, 0);
 
@@ -213,6 +215,7 @@ void Settings::IO(IOMode mode) {
 	section("Editor");
 	String(RECENT_FILES, "");
 	Int(WORKER_THREADS, 1);
+	Int(LIVE_CURSOR_RATE, 10);
 	Int(MERGE_MOVE, 0);
 	Int(MERGE_PASTE, 0);
 	Int(UNDO_SIZE, 400);
@@ -42,6 +42,8 @@ namespace Config {
 		HIGHLIGHT_ITEMS,
 		SHOW_ITEMS,
 		SHOW_BLOCKING,
+		SHOW_REACHABILITY,
+		SHOW_MAP_DIFF,
 		SHOW_ONLY_TILEFLAGS,
 		SHOW_ONLY_MODIFIED_TILES,
 		HIDE_ITEMS_WHEN_ZOOMED,
@@ -112,6 +114,7 @@ namespace Config {
 		LISTBOX_EATS_ALL_EVENTS,
 		RAW_LIKE_SIMONE,
 		WORKER_THREADS,
+		LIVE_CURSOR_RATE,
 
 		GOTO_WEBSITE_ON_BOOT,
 		INDIRECTORY_INSTALLATION,
@@ -38,22 +38,134 @@ void Spawns::addSpawn(Tile* tile)
 
 	auto it = spawns.insert(tile->getPosition());
 	ASSERT(it.second);
+	addArea(tile->getPosition(), tile->spawn->getSize());
 }
 
 void Spawns::removeSpawn(Tile* tile) {
 	ASSERT(tile->spawn);
 	spawns.erase(tile->getPosition());
-#if 0
-	SpawnPositionList::iterator iter = begin();
-	while(iter != end()) {
-		if(*iter == tile->getPosition()) {
-			spawns.erase(iter);
-			return;
+	removeArea(tile->getPosition());
+}
+
+void Spawns::addArea(const Position& centre, int radius)
+{
+	if(centre.z < 0 || centre.z >= MAP_HEIGHT)
+		return;
+
+	removeArea(centre);
+	radii[centre] = radius;
+
+	Area area;
+	area.centre = centre;
+	area.radius = radius;
+
+	AreaGrid& floor = grid[centre.z];
+	for(int cy = cellOf(centre.y - radius); cy <= cellOf(centre.y + radius); ++cy)
+	{
+		for(int cx = cellOf(centre.x - radius); cx <= cellOf(centre.x + radius); ++cx)
+			floor[cellKey(cx, cy)].push_back(area);
+	}
+}
+
+void Spawns::removeArea(const Position& centre)
+{
+	std::map<Position, int>::iterator found = radii.find(centre);
+	if(found == radii.end())
+		return;
+
+	const int radius = found->second;
+	radii.erase(found);
+
+	AreaGrid& floor = grid[centre.z];
+	for(int cy = cellOf(centre.y - radius); cy <= cellOf(centre.y + radius); ++cy)
+	{
+		for(int cx = cellOf(centre.x - radius); cx <= cellOf(centre.x + radius); ++cx)
+		{
+			AreaGrid::iterator cell = floor.find(cellKey(cx, cy));
+			if(cell == floor.end())
+				continue;
+
+			std::vector<Area>& areas = cell->second;
+			for(size_t i = 0; i < areas.size(); ++i)
+			{
+				if(areas[i].centre == centre)
+				{
+					areas[i] = areas.back();
+					areas.pop_back();
+					break;
+				}
+			}
+
+			if(areas.empty())
+				floor.erase(cell);
+		}
+	}
+}
+
+size_t Spawns::countSpawns(const Position& position) const
+{
+	if(position.z < 0 || position.z >= MAP_HEIGHT)
+		return 0;
+
+	const AreaGrid& floor = grid[position.z];
+	AreaGrid::const_iterator cell = floor.find(cellKey(cellOf(position.x), cellOf(position.y)));
+	if(cell == floor.end())
+		return 0;
+
+	size_t count = 0;
+	for(const Area& area : cell->second)
+	{
+		if(std::abs(position.x - area.centre.x) <= area.radius && std::abs(position.y - area.centre.y) <= area.radius)
+			++count;
+	}
+	return count;
+}
+
+void Spawns::getSpawns(const Position& position, std::vector<Position>& centres) const
+{
+	if(position.z < 0 || position.z >= MAP_HEIGHT)
+		return;
+
+	const AreaGrid& floor = grid[position.z];
+	AreaGrid::const_iterator cell = floor.find(cellKey(cellOf(position.x), cellOf(position.y)));
+	if(cell == floor.end())
+		return;
+
+	for(const Area& area : cell->second)
+	{
+		if(std::abs(position.x - area.centre.x) <= area.radius && std::abs(position.y - area.centre.y) <= area.radius)
+			centres.push_back(area.centre);
+	}
+}
+
+void Spawns::getSpawns(int z, int start_x, int start_y, int end_x, int end_y, std::vector<Area>& areas) const
+{
+	if(z < 0 || z >= MAP_HEIGHT)
+		return;
+
+	const AreaGrid& floor = grid[z];
+	for(int cy = cellOf(start_y); cy <= cellOf(end_y); ++cy)
+	{
+		for(int cx = cellOf(start_x); cx <= cellOf(end_x); ++cx)
+		{
+			AreaGrid::const_iterator cell = floor.find(cellKey(cx, cy));
+			if(cell == floor.end())
+				continue;
+
+			for(const Area& area : cell->second)
+			{
+				const int overlap_x = std::max(start_x, area.centre.x - area.radius);
+				const int overlap_y = std::max(start_y, area.centre.y - area.radius);
+				if(overlap_x > std::min(end_x, area.centre.x + area.radius) || overlap_y > std::min(end_y, area.centre.y + area.radius))
+					continue;
+
+				// An area sits in several cells, it's reported by the cell
+				// holding the corner of its overlap with the rectangle
+				if(cellOf(overlap_x) == cx && cellOf(overlap_y) == cy)
+					areas.push_back(area);
+			}
 		}
-		++iter;
 	}
-	ASSERT(false);
-#endif
 }
 
 std::ostream& operator<<(std::ostream& os, const Spawn& spawn) {
@@ -20,6 +20,8 @@
 #ifndef RME_SPAWN_H_
 #define RME_SPAWN_H_
 
+#include <unordered_map>
+
 class Tile;
 
 class Spawn {
@@ -62,6 +64,16 @@ public:
 	void addSpawn(Tile* tile);
 	void removeSpawn(Tile* tile);
 
+	// Spawns whose area covers the position, counted or as their centres
+	size_t countSpawns(const Position& position) const;
+	void getSpawns(const Position& position, std::vector<Position>& centres) const;
+	// Spawns whose area intersects the rectangle on floor z, each once
+	struct Area {
+		Position centre;
+		int radius;
+	};
+	void getSpawns(int z, int start_x, int start_y, int end_x, int end_y, std::vector<Area>& areas) const;
+
 	SpawnPositionList::iterator begin() {return spawns.begin();}
 	SpawnPositionList::const_iterator begin() const {return spawns.begin();}
 	SpawnPositionList::iterator end() {return spawns.end();}
@@ -69,7 +81,20 @@ public:
 	void erase(SpawnPositionList::iterator iter) {spawns.erase(iter);}
 	SpawnPositionList::iterator find(Position& pos) {return spawns.find(pos);}
 private:
+	// Every spawn area is listed in each grid cell it overlaps, so looking
+	// up a position only has to go through the areas of its own cell
+	enum { CELL_SIZE = 16 };
+	typedef std::unordered_map<uint32_t, std::vector<Area> > AreaGrid;
+
+	static uint32_t cellKey(int cell_x, int cell_y) {return (uint32_t(cell_x) << 16) | uint32_t(cell_y);}
+	static int cellOf(int coordinate) {return std::min(std::max(coordinate, 0), 0xFFFF) / CELL_SIZE;}
+
+	void addArea(const Position& centre, int radius);
+	void removeArea(const Position& centre);
+
 	SpawnPositionList spawns;
+	std::map<Position, int> radii;
+	AreaGrid grid[MAP_HEIGHT];
 };
 
 
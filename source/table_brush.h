@@ -22,6 +22,7 @@ public:
 	virtual void undraw(BaseMap* map, Tile* tile);
 
 	static void doTables(BaseMap* map, Tile* tile);
+	static void doTables(const NeighbourWindow& window, Tile* tile);
 
 	virtual int getLookID() const { return look_id; }
 
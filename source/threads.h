@@ -22,6 +22,9 @@
 
 #include "main.h"
 
+#include <thread>
+#include <atomic>
+
 class Thread : public wxThread {
 public:
 	Thread(wxThreadKind);
@@ -46,4 +49,70 @@ inline void Thread::Execute() {
 	Run();
 }
 
+// Splits [0, count) into consecutive stripes, one per thread, and calls
+// worker(stripe, begin, end) for each of them. The calling thread works the
+// first stripe itself and returns once every stripe is done.
+template<typename Worker>
+void ParallelStripes(size_t count, size_t threads, Worker worker)
+{
+	threads = std::max<size_t>(1, std::min(threads, count));
+	if(threads == 1)
+	{
+		if(count > 0)
+			worker(0, 0, count);
+		return;
+	}
+
+	const size_t stripeSize = (count + threads - 1) / threads;
+
+	std::vector<std::thread> pool;
+	for(size_t stripe = 1; stripe < threads; ++stripe)
+	{
+		size_t begin = stripe * stripeSize;
+		size_t end = std::min(count, begin + stripeSize);
+		if(begin >= end)
+			break;
+
+		pool.emplace_back([&worker, stripe, begin, end]() {
+			worker(stripe, begin, end);
+		});
+	}
+
+	worker(0, 0, std::min(count, stripeSize));
+
+	for(std::thread& thread : pool)
+		thread.join();
+}
+
+// Moves the load bar from one percentage to another as the workers of
+// ParallelStripes finish items. Every stripe counts what it finished, but
+// only stripe 0 reports, it runs on the calling thread and is the only one
+// that may touch the load bar.
+class StripeProgress
+{
+public:
+	// Reports every `every` items stripe 0 finished, never 100%, which would close the bar
+	StripeProgress(size_t total, bool show, int32_t from = 0, int32_t to = 100, size_t every = 256) :
+		total(std::max<size_t>(total, 1)), show(show), from(from), to(to), every(std::max<size_t>(every, 1)), count(0), ownCount(0) {}
+
+	void advance(size_t stripe)
+	{
+		const size_t done = ++count;
+		if(show && stripe == 0 && ++ownCount % every == 0)
+			report(done);
+	}
+
+protected:
+	void report(size_t done);
+
+	const size_t total;
+	const bool show;
+	const int32_t from;
+	const int32_t to;
+	const size_t every;
+	std::atomic<size_t> count;
+	// Only stripe 0 touches it
+	size_t ownCount;
+};
+
 #endif
@@ -114,7 +114,6 @@ int Tile::size() const
 	if(location)
 	{
 		if(location->getHouseExits()) ++sz;
-		if(location->getSpawnCount()) ++sz;
 		if(location->getWaypointCount()) ++ sz;
 	}
 	return sz;
@@ -430,6 +429,10 @@ void Tile::borderize(BaseMap* parent) {
 	GroundBrush::doBorders(parent, this);
 }
 
+void Tile::borderize(const NeighbourWindow& window) {
+	GroundBrush::doBorders(window, this);
+}
+
 void Tile::addBorderItem(Item* item) {
 	if(!item) return;
 	ASSERT(item->isBorder());
@@ -464,6 +467,10 @@ void Tile::wallize(BaseMap* parent) {
 	WallBrush::doWalls(parent, this);
 }
 
+void Tile::wallize(const NeighbourWindow& window) {
+	WallBrush::doWalls(window, this);
+}
+
 Item* Tile::getWall() const {
 	ItemVector::const_iterator it;
 
@@ -553,10 +560,18 @@ void Tile::tableize(BaseMap* parent) {
 	TableBrush::doTables(parent, this);
 }
 
+void Tile::tableize(const NeighbourWindow& window) {
+	TableBrush::doTables(window, this);
+}
+
 void Tile::carpetize(BaseMap* parent) {
 	CarpetBrush::doCarpets(parent, this);
 }
 
+void Tile::carpetize(const NeighbourWindow& window) {
+	CarpetBrush::doCarpets(window, this);
+}
+
 void Tile::selectGround() {
 	bool selected_ = false;
 	if(ground) {
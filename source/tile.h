@@ -24,6 +24,7 @@
 #include "item.h"
 #include "map_region.h"
 
+class NeighbourWindow;
 
 enum {
 	TILESTATE_NONE           = 0x0000,
@@ -145,6 +146,7 @@ public: //Functions
 
 	// Borderize this tile
 	void borderize(BaseMap* parent);
+	void borderize(const NeighbourWindow& window);
 
 	bool hasTable() const { return testFlags(statflags, TILESTATE_HAS_TABLE); }
 	Item* getTable() const;
@@ -172,12 +174,15 @@ public: //Functions
 	void addWallItem(Item* item);
 	// Wallize (name sucks, I know) this tile
 	void wallize(BaseMap* parent);
+	void wallize(const NeighbourWindow& window);
 	// Remove all tables from this tile
 	void cleanTables(bool dontdelete = false);
 	// Tableize (name sucks even worse, I know) this tile
 	void tableize(BaseMap* parent);
+	void tableize(const NeighbourWindow& window);
 	// Carpetize (name sucks even worse than last one, I know) this tile
 	void carpetize(BaseMap* parent);
+	void carpetize(const NeighbourWindow& window);
 
 	// Has to do with houses
 	bool isHouseTile() const;
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "tile_record.h"
+#include "live_socket.h"
+#include "basemap.h"
+#include "creature.h"
+#include "spawn.h"
+
+enum TileRecordFlags
+{
+	TILE_RECORD_SPAWN = 1,
+	TILE_RECORD_CREATURE = 2,
+};
+
+template <typename T>
+static void recordWrite(std::vector<uint8_t>& out, T value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool recordRead(const uint8_t* data, size_t size, size_t& offset, T& value)
+{
+	if (offset + sizeof(T) > size) {
+		return false;
+	}
+	memcpy(&value, data + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+TileRecordWriter::TileRecordWriter() :
+	version(MapVersion(MAP_OTBM_4, CLIENT_VERSION_NONE))
+{
+	//
+}
+
+void TileRecordWriter::write(std::vector<uint8_t>& out, Tile* tile, const Position* position)
+{
+	writer.reset();
+	LiveSocket::serializeTile(writer, tile, position, version);
+	writer.endNode();
+	recordWrite<uint32_t>(out, writer.getSize());
+	out.insert(out.end(), writer.getMemory(), writer.getMemory() + writer.getSize());
+
+	uint8_t flags = 0;
+	if (tile && tile->spawn) {
+		flags |= TILE_RECORD_SPAWN;
+	}
+	if (tile && tile->creature) {
+		flags |= TILE_RECORD_CREATURE;
+	}
+
+	recordWrite<uint8_t>(out, flags);
+	if (testFlags(flags, TILE_RECORD_SPAWN)) {
+		recordWrite<int32_t>(out, tile->spawn->getSize());
+	}
+	if (testFlags(flags, TILE_RECORD_CREATURE)) {
+		const std::string name = tile->creature->getName();
+		recordWrite<uint32_t>(out, name.size());
+		out.insert(out.end(), name.begin(), name.end());
+		recordWrite<int32_t>(out, tile->creature->getSpawnTime());
+		recordWrite<uint8_t>(out, tile->creature->getDirection());
+	}
+}
+
+TileRecordReader::TileRecordReader() :
+	reader(nullptr, 0),
+	version(MapVersion(MAP_OTBM_4, CLIENT_VERSION_NONE))
+{
+	//
+}
+
+BinaryNode* TileRecordReader::readNodes(const uint8_t* data, size_t size)
+{
+	buffer.resize(size + 1);
+	if (size > 0) {
+		memcpy(&buffer[1], data, size);
+	}
+	reader.assign(&buffer[0], size);
+	return reader.getRootNode()->getChild();
+}
+
+bool TileRecordReader::read(const uint8_t* data, size_t size, size_t& offset, BaseMap& map, Houses* houses, const Position* position, Tile*& tile)
+{
+	tile = nullptr;
+
+	uint32_t nodeSize = 0;
+	if (!recordRead(data, size, offset, nodeSize) || nodeSize > size - offset) {
+		return false;
+	}
+
+	BinaryNode* tileNode = readNodes(data + offset, nodeSize);
+	offset += nodeSize;
+	if (tileNode) {
+		tile = LiveSocket::unserializeTile(tileNode, map, houses, position, version);
+	}
+	reader.close();
+
+	uint8_t flags = 0;
+	int32_t spawnSize = 0;
+	std::string creatureName;
+	int32_t spawnTime = 0;
+	uint8_t direction = 0;
+
+	bool ok = recordRead(data, size, offset, flags);
+	if (ok && testFlags(flags, TILE_RECORD_SPAWN)) {
+		ok = recordRead(data, size, offset, spawnSize);
+	}
+	if (ok && testFlags(flags, TILE_RECORD_CREATURE)) {
+		uint32_t length = 0;
+		ok = recordRead(data, size, offset, length) && length <= size - offset;
+		if (ok) {
+			creatureName.assign(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			ok = recordRead(data, size, offset, spawnTime) && recordRead(data, size, offset, direction);
+		}
+	}
+
+	if (!ok) {
+		delete tile;
+		tile = nullptr;
+		return false;
+	}
+	if (!tile) {
+		return true;
+	}
+
+	if (testFlags(flags, TILE_RECORD_SPAWN)) {
+		tile->spawn = newd Spawn(spawnSize);
+	}
+	if (testFlags(flags, TILE_RECORD_CREATURE)) {
+		tile->creature = newd Creature(creatureName);
+		tile->creature->setSpawnTime(spawnTime);
+		tile->creature->setDirection(static_cast<Direction>(direction));
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_TILE_RECORD_H_
+#define RME_TILE_RECORD_H_
+
+#include "iomap.h"
+#include "filehandle.h"
+
+class Tile;
+class BaseMap;
+class Houses;
+
+// A tile stored on its own, outside of a map file: u32 size, the OTBM tile
+// node without a root node around it (as live packets carry tiles), then a
+// flags byte and the spawn and creature on the tile, which OTBM tile nodes
+// don't carry.
+class TileRecordWriter
+{
+public:
+	TileRecordWriter();
+
+	// With a position the node carries it, a missing tile is written as an empty one
+	void write(std::vector<uint8_t>& out, Tile* tile, const Position* position = nullptr);
+
+protected:
+	MemoryNodeFileWriteHandle writer;
+	VirtualIOMap version;
+};
+
+class TileRecordReader
+{
+public:
+	TileRecordReader();
+
+	// Reads the record at offset and moves past it, false if the data ends
+	// inside it. The tile is at position, or where the node says without
+	// one. It's nullptr if the node isn't a tile.
+	bool read(const uint8_t* data, size_t size, size_t& offset, BaseMap& map, Houses* houses, const Position* position, Tile*& tile);
+
+	// The first of several OTBM tile nodes written one after another without
+	// a root node around them, valid until the next call
+	BinaryNode* readNodes(const uint8_t* data, size_t size);
+	const IOMap& getVersion() const { return version; }
+
+protected:
+	// One spare byte in front, the reader skips the root NODE_START that
+	// the writer never wrote
+	std::vector<uint8_t> buffer;
+	MemoryNodeFileReadHandle reader;
+	VirtualIOMap version;
+};
+
+#endif
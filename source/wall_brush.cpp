@@ -7,6 +7,7 @@
 #include "wall_brush.h"
 #include "items.h"
 #include "basemap.h"
+#include "neighbour_window.h"
 #include "pugicast.h"
 
 uint32_t WallBrush::full_border_types[16];
@@ -327,8 +328,7 @@ void WallBrush::draw(BaseMap* map, Tile* tile, void* parameter) {
 	tile->addWallItem(Item::Create(id));
 }
 
-bool hasMatchingWallBrushAtTile(BaseMap* map, WallBrush* wall_brush, uint32_t x, uint32_t y, uint32_t z) {
-	Tile* t = map->getTile(x, y, z);
+bool hasMatchingWallBrushAtTile(Tile* t, WallBrush* wall_brush) {
 	if(!t) return false;
 
 	ItemVector::const_iterator it = t->items.begin();
@@ -349,11 +349,20 @@ bool hasMatchingWallBrushAtTile(BaseMap* map, WallBrush* wall_brush, uint32_t x,
 
 void WallBrush::doWalls(BaseMap* map, Tile* tile) {
 	ASSERT(tile);
+	if(!tile->getWall()) {
+		return;
+	}
+
+	NeighbourWindow window(*map);
+	doWalls(window, tile);
+}
+
+void WallBrush::doWalls(const NeighbourWindow& window, Tile* tile) {
+	ASSERT(tile);
 
-	// For quicker reference
-	unsigned int x = tile->getPosition().x;
-	unsigned int y = tile->getPosition().y;
-	unsigned int z = tile->getPosition().z;
+	// North, west, east and south are all walls care about
+	Tile* tiles[8];
+	window.getNeighbours(tile->getPosition(), tiles);
 
 	// Advance the vector to the beginning of the walls
 	ItemVector::iterator it = tile->items.begin();
@@ -380,30 +389,10 @@ void WallBrush::doWalls(BaseMap* map, Tile* tile) {
 			continue;
 		}
 		bool neighbours[4];
-
-		if(x == 0) {
-			if(y == 0) {
-				neighbours[0] = false;
-				neighbours[1] = false;
-				neighbours[2] = hasMatchingWallBrushAtTile(map, wall_brush, x + 1, y, z);
-				neighbours[3] = hasMatchingWallBrushAtTile(map, wall_brush, x,     y + 1, z);
-			} else {
-				neighbours[0] = hasMatchingWallBrushAtTile(map, wall_brush, x,     y - 1, z);
-				neighbours[1] = false;
-				neighbours[2] = hasMatchingWallBrushAtTile(map, wall_brush, x + 1, y, z);
-				neighbours[3] = hasMatchingWallBrushAtTile(map, wall_brush, x,     y + 1, z);
-			}
-		} else if(y == 0) {
-			neighbours[0] = false;
-			neighbours[1] = hasMatchingWallBrushAtTile(map, wall_brush, x - 1, y, z);
-			neighbours[2] = hasMatchingWallBrushAtTile(map, wall_brush, x + 1, y, z);
-			neighbours[3] = hasMatchingWallBrushAtTile(map, wall_brush, x,     y + 1, z);
-		} else {
-			neighbours[0] = hasMatchingWallBrushAtTile(map, wall_brush, x,     y - 1, z);
-			neighbours[1] = hasMatchingWallBrushAtTile(map, wall_brush, x - 1, y, z);
-			neighbours[2] = hasMatchingWallBrushAtTile(map, wall_brush, x + 1, y, z);
-			neighbours[3] = hasMatchingWallBrushAtTile(map, wall_brush, x,     y + 1, z);
-		}
+		neighbours[0] = hasMatchingWallBrushAtTile(tiles[1], wall_brush);
+		neighbours[1] = hasMatchingWallBrushAtTile(tiles[3], wall_brush);
+		neighbours[2] = hasMatchingWallBrushAtTile(tiles[4], wall_brush);
+		neighbours[3] = hasMatchingWallBrushAtTile(tiles[6], wall_brush);
 
 		uint32_t tiledata = 0;
 		for(int i = 0; i < 4; i++) {
@@ -24,6 +24,7 @@ public:
 	virtual void undraw(BaseMap* map, Tile* tile);
 	// Creates walls on the target tile (does not depend on brush in any way)
 	static void doWalls(BaseMap* map, Tile* tile);
+	static void doWalls(const NeighbourWindow& window, Tile* tile);
 
 	// If the specified wall item is part of this wall
 	bool hasWall(Item* item);